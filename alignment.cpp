@@ -114,42 +114,30 @@ void Alignment::updateSitePatternAfterOptimized(){
     countInformative();
 }
 
-void Alignment::modifyPatternFreq(Alignment & aln, int * new_pattern_freqs, int new_nptn){
-	assert(new_nptn == aln.getNPattern());
-	int nsite = aln.getNSite();
-    seq_names.insert(seq_names.begin(), aln.seq_names.begin(), aln.seq_names.end());
+void Alignment::copyPatterns(Alignment & aln){
+    seq_names = aln.seq_names;
     num_states = aln.num_states;
     seq_type = aln.seq_type;
+    STATE_UNKNOWN = aln.STATE_UNKNOWN;
+    vector<Pattern>::operator=(aln);
+    pattern_index = aln.pattern_index;
+}
+
+void Alignment::setPatternFreq(int * new_pattern_freqs){
+	int nptn = getNPattern();
+	int nsite = 0;
+	for(int p = 0; p < nptn; p++)
+		nsite += new_pattern_freqs[p];
     site_pattern.resize(nsite);
-    clear();
-    pattern_index.clear();
 
     int site = 0;
-    std::vector<Pattern>::iterator it;
-    int p;
-	n_informative_patterns = 0;
-	n_informative_sites = 0;
-
-	int cur_pat = 0;
-    for(it = aln.begin(), p = 0; it != aln.end(); ++it, ++p) {
-    	if((it->ras_pars_score > 0) && (new_pattern_freqs[p] > 0)){
-    		n_informative_patterns++;
-    		n_informative_sites += new_pattern_freqs[p];
-    	}
-
-    	for(int i = 0; i < new_pattern_freqs[p]; i++){
-    		Pattern pat = *it; // Diep: (Nov 16, 2016) Fix error that frequencies all equal to 1 since optimizeBootstrapTree
-    		addPattern(pat, site, 1);
-//    		addPattern(*it, site, 1); // WRONG old code
-    		site++;
-    	}
-
-    	if(new_pattern_freqs[p] > 0){
-    		at(cur_pat).ras_pars_score = it->ras_pars_score;
-    		cur_pat++;
-    	}
+    for(int p = 0; p < nptn; p++){
+    	at(p).frequency = new_pattern_freqs[p];
+    	for(int i = 0; i < new_pattern_freqs[p]; i++)
+    		site_pattern[site++] = p;
     }
     countConstSite();
+    countInformative();
 }
 
 string &Alignment::getSeqName(int i) {
@@ -744,6 +732,196 @@ void Alignment::condenseParsimonyEquivalentSites(Alignment *aln) {
     cout << "Alignment is condensed into " << size() << " patterns" << endl;
 }
 
+/**
+ * The binary alignment cache (.alnbin) is a sequence of little-endian fields,
+ * independent of the host: the magic, uint32 version, int32 seq_type, num_states,
+ * STATE_UNKNOWN, nseq, nsite, npattern, n_informative_patterns, n_informative_sites,
+ * has_seq_states, the bits of frac_const_sites as uint64, the uint64 size and
+ * content hash of the alignment file, the uint64 sizes of names and key;
+ * then frequency[npattern], ras_pars_score[npattern] and site_pattern[nsite] as int32,
+ * is_const[npattern] and the npattern*nseq pattern states as bytes,
+ * the NUL-terminated sequence names and the key.
+ */
+static const char ALNBIN_MAGIC[8] = {'M', 'P', 'B', 'A', 'L', 'N', 'B', 'N'};
+
+/** increase this whenever the layout of the binary alignment cache changes */
+static const uint32_t ALNBIN_VERSION = 2;
+
+/** append the lowest nbytes bytes of value to buf, least significant first */
+static void putLittleEndian(string &buf, uint64_t value, int nbytes) {
+    for (int i = 0; i < nbytes; i++, value >>= 8)
+        buf.push_back((char)(value & 0xff));
+}
+
+/** read nbytes little-endian bytes at pos and advance pos */
+static uint64_t getLittleEndian(const string &buf, size_t &pos, int nbytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < nbytes; i++)
+        value |= (uint64_t)(unsigned char)buf[pos + i] << (8*i);
+    pos += nbytes;
+    return value;
+}
+
+/**
+ * compute the size and a 64-bit FNV-1a hash of the content of a file
+ * @return FALSE if the file cannot be read
+ */
+static bool hashFileContent(const char *file_name, uint64_t &size, uint64_t &hash) {
+    ifstream in(file_name, ios::in | ios::binary);
+    if (!in.is_open())
+        return false;
+    vector<char> chunk(1 << 20);
+    size = 0;
+    hash = 14695981039346656037ULL;
+    while (in) {
+        in.read(&chunk[0], chunk.size());
+        size_t n = in.gcount();
+        for (size_t i = 0; i < n; i++) {
+            hash ^= (unsigned char)chunk[i];
+            hash *= 1099511628211ULL;
+        }
+        size += n;
+    }
+    return !in.bad();
+}
+
+bool Alignment::readBinaryCache(const char *cache_file, const char *aln_file, const string &key) {
+    string data;
+    ifstream in(cache_file, ios::in | ios::binary);
+    if (!in.is_open())
+        return false;
+    in.seekg(0, ios::end);
+    data.resize(in.tellg());
+    in.seekg(0, ios::beg);
+    if (data.empty() || !in.read(&data[0], data.size()))
+        return false;
+    in.close();
+
+    const size_t header_size = sizeof(ALNBIN_MAGIC) + 10*4 + 5*8;
+    if (data.size() < header_size || data.compare(0, sizeof(ALNBIN_MAGIC), ALNBIN_MAGIC, sizeof(ALNBIN_MAGIC)) != 0)
+        return false;
+    size_t pos = sizeof(ALNBIN_MAGIC);
+    if (getLittleEndian(data, pos, 4) != ALNBIN_VERSION)
+        return false;
+    int32_t header_seq_type = getLittleEndian(data, pos, 4);
+    int32_t header_num_states = getLittleEndian(data, pos, 4);
+    int32_t header_state_unknown = getLittleEndian(data, pos, 4);
+    size_t nseq = (uint32_t)getLittleEndian(data, pos, 4);
+    size_t nsite = (uint32_t)getLittleEndian(data, pos, 4);
+    size_t nptn = (uint32_t)getLittleEndian(data, pos, 4);
+    int32_t header_informative_patterns = getLittleEndian(data, pos, 4);
+    int32_t header_informative_sites = getLittleEndian(data, pos, 4);
+    bool has_seq_states = getLittleEndian(data, pos, 4) != 0;
+    uint64_t frac_bits = getLittleEndian(data, pos, 8);
+    uint64_t aln_size = getLittleEndian(data, pos, 8);
+    uint64_t aln_hash = getLittleEndian(data, pos, 8);
+    uint64_t names_size = getLittleEndian(data, pos, 8);
+    uint64_t key_size = getLittleEndian(data, pos, 8);
+    if (key_size != key.size() || names_size == 0 ||
+        data.size() != header_size + (2*nptn + nsite)*4 + nptn*(nseq+1) + names_size + key_size)
+        return false;
+    size_t names_pos = data.size() - names_size - key_size;
+    if (data[names_pos + names_size - 1] != 0 || data.compare(names_pos + names_size, key_size, key) != 0)
+        return false;
+
+    // the cache is out of date if the content of the alignment file changed
+    uint64_t file_size, file_hash;
+    if (!hashFileContent(aln_file, file_size, file_hash) || file_size != aln_size || file_hash != aln_hash)
+        return false;
+
+    seq_names.clear();
+    for (size_t name = names_pos; name < names_pos + names_size; name = data.find((char)0, name) + 1)
+        seq_names.push_back(data.c_str() + name);
+    if (seq_names.size() != nseq)
+        return false;
+
+    seq_type = (SeqType)header_seq_type;
+    num_states = header_num_states;
+    STATE_UNKNOWN = header_state_unknown;
+    n_informative_patterns = header_informative_patterns;
+    n_informative_sites = header_informative_sites;
+    memcpy(&frac_const_sites, &frac_bits, sizeof(frac_const_sites));
+
+    size_t freq_pos = pos, score_pos = freq_pos + nptn*4;
+    site_pattern.resize(nsite);
+    pos = score_pos + nptn*4;
+    for (size_t site = 0; site < nsite; site++)
+        site_pattern[site] = (int32_t)getLittleEndian(data, pos, 4);
+    size_t const_pos = pos, states_pos = const_pos + nptn;
+    clear();
+    pattern_index.clear();
+    resize(nptn);
+    for (size_t ptn = 0; ptn < nptn; ptn++) {
+        Pattern &pat = at(ptn);
+        pat.assign(data, states_pos + ptn*nseq, nseq);
+        pat.frequency = (int32_t)getLittleEndian(data, freq_pos, 4);
+        pat.ras_pars_score = (int32_t)getLittleEndian(data, score_pos, 4);
+        pat.is_const = data[const_pos + ptn];
+        pattern_index[pat] = ptn;
+    }
+    if (has_seq_states)
+        buildSeqStates();
+    return true;
+}
+
+void Alignment::writeBinaryCache(const char *cache_file, const char *aln_file, const string &key) {
+    uint64_t aln_size, aln_hash;
+    if (!hashFileContent(aln_file, aln_size, aln_hash)) {
+        outWarning("Cannot write alignment cache " + string(cache_file));
+        return;
+    }
+    size_t nseq = getNSeq(), nsite = getNSite(), nptn = getNPattern();
+    string names;
+    for (StrVector::iterator it = seq_names.begin(); it != seq_names.end(); it++) {
+        names += *it;
+        names.push_back(0);
+    }
+    uint64_t frac_bits;
+    memcpy(&frac_bits, &frac_const_sites, sizeof(frac_bits));
+
+    string data(ALNBIN_MAGIC, sizeof(ALNBIN_MAGIC));
+    data.reserve(100 + (2*nptn + nsite)*4 + nptn*(nseq+1) + names.size() + key.size());
+    putLittleEndian(data, ALNBIN_VERSION, 4);
+    putLittleEndian(data, (uint32_t)seq_type, 4);
+    putLittleEndian(data, (uint32_t)num_states, 4);
+    putLittleEndian(data, (uint32_t)STATE_UNKNOWN, 4);
+    putLittleEndian(data, nseq, 4);
+    putLittleEndian(data, nsite, 4);
+    putLittleEndian(data, nptn, 4);
+    putLittleEndian(data, (uint32_t)n_informative_patterns, 4);
+    putLittleEndian(data, (uint32_t)n_informative_sites, 4);
+    putLittleEndian(data, !seq_states.empty(), 4);
+    putLittleEndian(data, frac_bits, 8);
+    putLittleEndian(data, aln_size, 8);
+    putLittleEndian(data, aln_hash, 8);
+    putLittleEndian(data, names.size(), 8);
+    putLittleEndian(data, key.size(), 8);
+
+    for (iterator it = begin(); it != end(); it++)
+        putLittleEndian(data, (uint32_t)it->frequency, 4);
+    for (iterator it = begin(); it != end(); it++)
+        putLittleEndian(data, (uint32_t)it->ras_pars_score, 4);
+    for (IntVector::iterator it = site_pattern.begin(); it != site_pattern.end(); it++)
+        putLittleEndian(data, (uint32_t)*it, 4);
+    for (iterator it = begin(); it != end(); it++)
+        data.push_back(it->is_const);
+    for (iterator it = begin(); it != end(); it++)
+        data += *it;
+    data += names;
+    data += key;
+
+    try {
+        ofstream out;
+        out.exceptions(ios::failbit | ios::badbit);
+        out.open(cache_file, ios::out | ios::binary);
+        out.write(data.data(), data.size());
+        out.close();
+        cout << "Alignment cache written to " << cache_file << endl;
+    } catch (ios::failure) {
+        outWarning("Cannot write alignment cache " + string(cache_file));
+    }
+}
+
 /**
 	detect the data type of the input sequences
 	@param sequences vector of strings
@@ -1917,33 +2095,23 @@ void Alignment::createRatchetAlignment(Alignment *aln, int percentage, int weigh
 
 void Alignment::createPerturbAlignment(Alignment *aln, int percentage, int weight, bool sort_aln) {
     if (aln->isSuperAlignment()) outError("Internal error: ", __func__);
-    int site, nsite = aln->getNSite();
-    seq_names.insert(seq_names.begin(), aln->seq_names.begin(), aln->seq_names.end());
-    num_states = aln->num_states;
-    seq_type = aln->seq_type;
-    STATE_UNKNOWN = aln->STATE_UNKNOWN;
-    site_pattern.resize(nsite + (aln->n_informative_sites * percentage / 100) * weight, -1);
-    clear();
-    pattern_index.clear();
-    VerboseMode save_mode = verbose_mode;
-    verbose_mode = min(verbose_mode, VB_MIN); // to avoid printing gappy sites in addPattern
-    
+    // the patterns of aln are copied once, a new perturbation only changes their frequencies
+    if (empty()) {
+        copyPatterns(*aln);
+        buildSeqStates();
+    }
+    assert(getNPattern() == aln->getNPattern());
+
 	int nptn = aln->getNPattern();
-	site = 0;
-	for(int p = 0; p < nptn; p++){
-		Pattern pat = aln->at(p);
-		// keep original frequency
-		for(int i = 0; i < aln->at(p).frequency; i++){
-			addPattern(pat, site);
-			site++;
-		}
-		at(p).ras_pars_score = aln->at(p).ras_pars_score;
-	}
+	IntVector ptn_freq(nptn);
+	for(int p = 0; p < nptn; p++)
+		ptn_freq[p] = aln->at(p).frequency; // keep original frequency
 
 	int ratchet_nsite = aln->n_informative_sites * percentage / 100; // only resample from informative site
 	int orig_nsite = aln->getNSite();
 
 	vector<bool> selected_sites(orig_nsite, false); // Diep add June 19, 2015
+	IntVector upweighted_ptns;
 
 	for(int s = 0; s < ratchet_nsite; s++){
 		// Select informative site
@@ -1957,18 +2125,25 @@ void Alignment::createPerturbAlignment(Alignment *aln, int percentage, int weigh
 		selected_sites[site_id] = true;
 
 		// Upweight
-		for(int w = 0; w < weight; w++){
-			Pattern pat = aln->at(ptn_id);
-			addPattern(pat, site);
-			site++;
-		}
+		upweighted_ptns.push_back(ptn_id);
 	}
 
-    verbose_mode = save_mode;
-    countConstSite();
-    // countInformative();
-    buildSeqStates();
-    if(sort_aln) updateSitePatternAfterOptimized();
+	// the patterns keep the order of aln
+	if (sort_aln) {
+		// the sites grouped by pattern, as updateSitePatternAfterOptimized() lays them out
+		for (IntVector::iterator it = upweighted_ptns.begin(); it != upweighted_ptns.end(); it++)
+			ptn_freq[*it] += weight;
+		setPatternFreq(&ptn_freq[0]);
+	} else {
+		// the original sites grouped by pattern, then the upweighted sites in the order they were drawn
+		setPatternFreq(&ptn_freq[0]);
+		for (IntVector::iterator it = upweighted_ptns.begin(); it != upweighted_ptns.end(); it++) {
+			at(*it).frequency += weight;
+			site_pattern.insert(site_pattern.end(), weight, *it);
+		}
+		countConstSite();
+		countInformative();
+	}
 }
 
 void Alignment::createBootstrapAlignment(IntVector &pattern_freq, const char *spec) {
@@ -67,7 +67,18 @@ public:
 
     void operator=(Alignment & some_aln);
     void updateSitePatternAfterOptimized(); // Diep added mostly for sorting aln
-    void modifyPatternFreq(Alignment & aln, int * new_pattern_freqs, int new_npt); // Diep added
+    /**
+     * copy the sequence names, data type and patterns of aln
+     */
+    void copyPatterns(Alignment & aln);
+
+    /**
+     * reweight the patterns in place, the pattern data is not touched:
+     * site_pattern and the constant and informative site counts follow the new frequencies.
+     * Used to reuse a copy of an alignment for several bootstrap replicates.
+     * @param new_pattern_freqs new frequency of each pattern, may be 0
+     */
+    void setPatternFreq(int * new_pattern_freqs);
 
     /****************************************************************************
             input alignment reader
@@ -135,6 +146,25 @@ public:
      */
     void condenseParsimonyEquivalentSites(Alignment *aln);
 
+    /**
+     * load the alignment from a binary cache written by writeBinaryCache(),
+     * so that neither parsing nor pattern building is needed
+     * @param cache_file binary cache file name
+     * @param aln_file alignment file the cache was built from
+     * @param key description of how the alignment was read (file path, sequence type, condensing)
+     * @return TRUE on success, FALSE if the cache is missing, unreadable or
+     * out of date w.r.t. the content of aln_file and key
+     */
+    bool readBinaryCache(const char *cache_file, const char *aln_file, const string &key);
+
+    /**
+     * write the patterns, frequencies, parsimony scores and sequence names to a binary cache
+     * @param cache_file binary cache file name
+     * @param aln_file alignment file this alignment was read from
+     * @param key description of how the alignment was read (file path, sequence type, condensing)
+     */
+    void writeBinaryCache(const char *cache_file, const char *aln_file, const string &key);
+
     /****************************************************************************
             output alignment 
      ****************************************************************************/
@@ -347,7 +377,11 @@ public:
 	/**
 	 * Create an alignment for ratchet
 	 * by selecting a subset of informative sites (specify by percentage)
-	 * and upweighting them
+	 * and upweighting them.
+	 * The patterns of aln are copied on the first call only: calling it again on
+	 * the same alignment draws a new perturbation by changing the pattern frequencies.
+	 * @param sort_aln TRUE to lay out the sites grouped by pattern, FALSE to append
+	 * the upweighted sites after the original ones
 	 */
 	virtual void createPerturbAlignment(Alignment *aln, int percentage, int weight, bool sort_aln);
 
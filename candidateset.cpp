@@ -7,7 +7,8 @@
 
 #include "phylotree.h"
 #include "candidateset.h"
-extern Params *globalParam;
+#include "treestore.h"
+extern THREAD_LOCAL Params *globalParam;
 
 CandidateSet::CandidateSet(int limit, int max_candidates, Alignment *aln) : CheckpointFactory() {
     assert(max_candidates <= limit);
@@ -105,18 +106,11 @@ bool CandidateSet::replaceTree(string tree, double score) {
     candidate.tree = tree;
     candidate.score = score;
     candidate.topology = getTopology(tree);
-    if (treeTopologyExist(candidate.topology)) {
-        topologies[candidate.topology] = score;
-        for (reverse_iterator i = rbegin(); i != rend(); i++) {
-            if (i->second.topology == candidate.topology) {
-                erase( --(i.base()) );
-                break;
-            }
-            insert(CandidateSet::value_type(score, candidate));
-        }
-    } else {
+    unordered_map<string, iterator>::iterator topo = topologies.find(candidate.topology);
+    if (topo == topologies.end())
         return false;
-    }
+    erase(topo->second);
+    topo->second = insert(CandidateSet::value_type(score, candidate));
     return true;
 }
 
@@ -142,52 +136,67 @@ void CandidateSet::initParentTrees() {
 }
 
 bool CandidateSet::update(string tree, double score) {
+	return updateTopology(tree, score, getTopology(tree));
+}
+
+bool CandidateSet::update(string tree, double score, PhyloTree *tree_topo) {
+	return updateTopology(tree, score, getTopology(tree_topo), tree_topo);
+}
+
+bool CandidateSet::updateTopology(string tree, double score, const string &topology, PhyloTree *tree_src) {
 	bool newTree;
+	unordered_map<string, iterator>::iterator topo = topologies.find(topology);
+	if (tree.empty() && tree_src) {
+		bool kept = (score > bestScore);
+		if (topo != topologies.end())
+			kept = kept || topo->second->first < score;
+		else
+			kept = kept || size() < maxCandidates || getWorstScore() <= score;
+		if (kept)
+			tree = tree_src->getTreeString();
+	}
 	CandidateTree candidate;
 	candidate.tree = tree;
 	candidate.score = score;
-	candidate.topology = getTopology(tree);
+	candidate.topology = topology;
 	if (candidate.score > bestScore) {
         bestTreeString = tree;
         bestScore = candidate.score;
     }
-	if (treeTopologyExist(candidate.topology)) {
+	if (topo != topologies.end()) {
 	    // if tree topology already exist, we replace the old
 	    // by the new one (with new branch lengths) and update the score
-		if (topologies[candidate.topology] < score) {
-			topologies[candidate.topology] = score;
-			for (CandidateSet::iterator i = begin(); i != end(); i++)
-				if (i->second.topology == candidate.topology) {
-					erase(i);
-					break;
-				}
+		if (topo->second->first < score) {
+			erase(topo->second);
 			// insert tree into candidate set
-			insert(CandidateSet::value_type(score, candidate));
+			topo->second = insert(CandidateSet::value_type(score, candidate));
 		}
 		newTree = false;
 	} else {
 		newTree = true;
 		if (size() < maxCandidates) {
 			// insert tree into candidate set
-			insert(CandidateSet::value_type(score, candidate));
-			topologies[candidate.topology] = score;
+			topologies[topology] = insert(CandidateSet::value_type(score, candidate));
+			candidateTreeVecIndex[tree].insert(candidateTreeVec.size());
 			candidateTreeVec.push_back(tree); // Diep added
 		} else if (getWorstScore() <= score){
 			// remove the worst-scoring tree
 			topologies.erase(begin()->second.topology);
 
 			// Diep added
-			int n = candidateTreeVec.size();
-			for(int i = 0; i < n; i++)
-				if(candidateTreeVec[i] == begin()->second.tree){
-					candidateTreeVec[i] = tree;
-					break;
-				}
+			unordered_map<string, set<int> >::iterator worst = candidateTreeVecIndex.find(begin()->second.tree);
+			if (worst != candidateTreeVecIndex.end()) {
+				int i = *worst->second.begin();
+				worst->second.erase(worst->second.begin());
+				if (worst->second.empty())
+					candidateTreeVecIndex.erase(worst);
+				candidateTreeVec[i] = tree;
+				candidateTreeVecIndex[tree].insert(i);
+			}
 
 			erase(begin());
 			// insert tree into candidate set
-			insert(CandidateSet::value_type(score, candidate));
-			topologies[candidate.topology] = score;
+			topologies[topology] = insert(CandidateSet::value_type(score, candidate));
 		}else
 			newTree = false; // Diep added
 	}
@@ -213,10 +222,16 @@ string CandidateSet::getTopology(string tree) {
 	mtree.rooted = false;
 	mtree.aln = aln;
 	mtree.readTreeString(tree);
-    mtree.root = mtree.findNodeName(aln->getSeqName(0));
-	ostringstream ostr;
-	mtree.printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA);
-	return ostr.str();
+	return getTopology(&mtree);
+}
+
+string CandidateSet::getTopology(PhyloTree *tree) {
+	Node *root = tree->root;
+	tree->root = tree->findNodeName(aln->getSeqName(0));
+	string code;
+	TreeStore::encodeTree(tree, code);
+	tree->root = root;
+	return code;
 }
 
 void CandidateSet::clear() {
@@ -246,13 +261,20 @@ bool CandidateSet::treeExist(string tree) {
 	return treeTopologyExist(getTopology(tree));
 }
 
+bool CandidateSet::treeExist(PhyloTree *tree) {
+	return treeTopologyExist(getTopology(tree));
+}
+
 void CandidateSet::copyToCandidateVec(){
 	assert(!empty());
 	if (empty())
 		return;
 	candidateTreeVec.clear();
-	for (reverse_iterator i = rbegin(); i != rend(); i++)
+	candidateTreeVecIndex.clear();
+	for (reverse_iterator i = rbegin(); i != rend(); i++) {
+		candidateTreeVecIndex[i->second.tree].insert(candidateTreeVec.size());
 		candidateTreeVec.push_back(i->second.tree);
+	}
 }
 
 string CandidateSet::getRandCandVecTree(){
@@ -12,9 +12,11 @@
 #include "checkpoint.h"
 #include <stack>
 
+class PhyloTree;
+
 struct CandidateTree {
 	string tree; // with branch length
-	string topology; // tree topology WITHOUT branch lengths and WITH TAXON ID (instead of taxon names) for sorting purpose
+	string topology; // tree topology WITHOUT branch lengths and WITH TAXON ID, encoded by TreeStore::encodeTree(), see getTopology()
 	double score; // log-likelihood under ML or parsimony score
 };
 
@@ -75,6 +77,21 @@ public:
      */
     bool update(string tree, double score);
 
+    /**
+     * update(tree, score) for the tree string of a live tree, taking the topology
+     * from the tree itself instead of parsing the string
+     * @param tree_topo the tree printed as \a tree
+     * @param tree the tree string, or empty to print tree_topo only if it is kept
+     */
+    bool update(string tree, double score, PhyloTree *tree_topo);
+
+    /**
+     * update() for a tree whose topology is known
+     * @param topology getTopology() of tree
+     * @param tree_src if tree is empty, the tree printed only if it is kept
+     */
+    bool updateTopology(string tree, double score, const string &topology, PhyloTree *tree_src = NULL);
+
     /**
      *  print score of max_candidates best trees
      *
@@ -124,10 +141,10 @@ public:
      */
     int popSize;
 
-    /** index of tree topologies in set
+    /** index of tree topologies in set, topology -> its element
      *
      */
-    StringDoubleHashMap topologies;
+    unordered_map<string, iterator> topologies;
 
     /**
      *  Trees used for reproduction
@@ -141,6 +158,7 @@ public:
 
     /**
      * check if tree topology WITHOUT branch length exist in the candidate set?
+     * @param topo a topology from getTopology()
      */
     bool treeTopologyExist(string topo);
 
@@ -150,10 +168,21 @@ public:
     bool treeExist(string tree);
 
     /**
-     * return a unique topology (sorted by taxon names, rooted at taxon with alphabetically smallest name) without branch lengths
+     * treeExist() for a live tree
+     */
+    bool treeExist(PhyloTree *tree);
+
+    /**
+     * return a unique topology (sorted by taxon IDs, rooted at the first taxon) without branch lengths,
+     * in the compact form of TreeStore::encodeTree()
      */
     string getTopology(string tree);
 
+    /**
+     * getTopology() of a live tree, without printing and parsing it again
+     */
+    string getTopology(PhyloTree *tree);
+
     /**
      *  Empty the candidate set
      */
@@ -182,6 +211,9 @@ public:
 private:
 	vector<string> candidateTreeVec; // Diep added to avoid bias in support values for big group
 
+	/** tree string -> its positions in candidateTreeVec */
+	unordered_map<string, set<int> > candidateTreeVecIndex;
+
 };
 
 #endif /* CANDIDATESET_H_ */
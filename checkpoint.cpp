@@ -11,9 +11,48 @@
 #include "tools.h"
 #include <cstdio>
 
-extern Params* globalParam;
+extern THREAD_LOCAL Params* globalParam;
 const char* CKP_HEADER = "--- # MPBoot Checkpoint ver >= 2";
 
+/** magic number and version of the binary checkpoint log */
+const char CKP_BINARY_MAGIC[8] = { 'M', 'P', 'B', 'C', 'K', 'P', 'T', '\n' };
+const uint32_t CKP_BINARY_VERSION = 1;
+
+/** size of a record without key and value: operation, key length, value length */
+const size_t CKP_RECORD_SIZE = 1 + 2 * sizeof(uint32_t);
+
+/** write a uint32 as 4 little-endian bytes, independent of the host */
+static void writeUint32(ostream& out, uint32_t value)
+{
+    char bytes[4];
+    for (int i = 0; i < 4; i++, value >>= 8)
+        bytes[i] = (char)(value & 0xff);
+    out.write(bytes, 4);
+}
+
+/** read a uint32 written by writeUint32() */
+static bool readUint32(istream& in, uint32_t& value)
+{
+    unsigned char bytes[4];
+    if (!in.read((char*)bytes, 4))
+        return false;
+    value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    return true;
+}
+
+/**
+    write a record of the binary checkpoint log
+    @param op 'P' to put (key,value), 'E' to erase key
+*/
+static void writeRecord(ostream& out, char op, const string& key, const string& value)
+{
+    out.put(op);
+    writeUint32(out, key.length());
+    writeUint32(out, value.length());
+    out.write(key.data(), key.length());
+    out.write(value.data(), value.length());
+}
+
 Checkpoint::Checkpoint()
 {
     ignore = false;
@@ -24,6 +63,9 @@ Checkpoint::Checkpoint()
     struct_name = "";
     compression = true;
     header = CKP_HEADER;
+    binary = false;
+    log_size = 0;
+    log_compact = false;
 }
 
 Checkpoint::~Checkpoint()
@@ -84,6 +126,8 @@ bool Checkpoint::load()
     if (!fileExists(filename))
         return false;
     try {
+        if (binary)
+            return loadBinary();
         igzstream in;
         // set the failbit and badbit
         in.exceptions(ios::failbit | ios::badbit);
@@ -119,6 +163,123 @@ void Checkpoint::setCompression(bool compression)
     this->compression = compression;
 }
 
+void Checkpoint::setBinary(bool binary)
+{
+    this->binary = binary;
+}
+
+bool Checkpoint::loadBinary()
+{
+    ifstream in(filename.c_str(), ios::in | ios::binary);
+    char magic[sizeof(CKP_BINARY_MAGIC)];
+    uint32_t version, header_len;
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, CKP_BINARY_MAGIC, sizeof(magic)) != 0)
+        throw("Invalid checkpoint file " + filename);
+    if (!readUint32(in, version) || version != CKP_BINARY_VERSION)
+        throw("Unsupported version of checkpoint file " + filename);
+    if (!readUint32(in, header_len))
+        throw("Invalid checkpoint file " + filename);
+    string file_header(header_len, ' ');
+    if (!in.read(&file_header[0], header_len) || file_header != header)
+        throw("Invalid checkpoint file " + filename);
+    size_t pos = sizeof(magic) + sizeof(version) + sizeof(header_len) + header_len;
+    char op;
+    uint32_t key_len, value_len;
+    string key, value;
+    // replay the log, later records override earlier ones
+    while (in.get(op)) {
+        if (!readUint32(in, key_len) || !readUint32(in, value_len))
+            break;
+        key.resize(key_len);
+        value.resize(value_len);
+        if (!in.read(&key[0], key_len) || !in.read(&value[0], value_len))
+            break;
+        if (op == 'P')
+            (*this)[key] = value;
+        else if (op == 'E')
+            erase(key);
+        else
+            break;
+        pos += CKP_RECORD_SIZE + key_len + value_len;
+    }
+    in.clear();
+    in.seekg(0, ios::end);
+    // a record cut off by a crash while appending is dropped, rewrite the file next time
+    log_compact = ((size_t)in.tellg() != pos);
+    log_size = pos;
+    in.close();
+    dumped.clear();
+    dumped.insert(begin(), end());
+    return true;
+}
+
+void Checkpoint::dumpBinary()
+{
+    // entries changed or erased since the previous dump, found by comparing
+    // with the values stored in the file
+    vector<iterator> changed;
+    StrVector erased;
+    size_t live_size = 0, append_size = 0;
+    for (iterator i = begin(); i != end(); i++) {
+        size_t record_size = CKP_RECORD_SIZE + i->first.length() + i->second.length();
+        live_size += record_size;
+        unordered_map<string, string>::iterator it = dumped.find(i->first);
+        if (it == dumped.end() || it->second != i->second) {
+            changed.push_back(i);
+            append_size += record_size;
+        }
+    }
+    // a key can only be erased if the file has more keys than the unchanged ones
+    if (dumped.size() + changed.size() > size())
+        for (unordered_map<string, string>::iterator it = dumped.begin(); it != dumped.end(); it++)
+            if (find(it->first) == end()) {
+                erased.push_back(it->first);
+                append_size += CKP_RECORD_SIZE + it->first.length();
+            }
+    if (changed.empty() && erased.empty() && !log_compact && log_size > 0)
+        return;
+
+    if (log_compact || log_size == 0 || log_size + append_size > 2 * live_size + header.length()) {
+        // compaction: rewrite the file with the current entries only
+        string filename_tmp = filename + ".tmp";
+        ofstream out;
+        out.exceptions(ios::failbit | ios::badbit);
+        out.open(filename_tmp.c_str(), ios::out | ios::binary);
+        out.write(CKP_BINARY_MAGIC, sizeof(CKP_BINARY_MAGIC));
+        writeUint32(out, CKP_BINARY_VERSION);
+        writeUint32(out, header.length());
+        out.write(header.data(), header.length());
+        for (iterator i = begin(); i != end(); i++)
+            writeRecord(out, 'P', i->first, i->second);
+        out.close();
+        if (fileExists(filename)) {
+            if (std::remove(filename.c_str()) != 0)
+                outError("Cannot remove file ", filename);
+        }
+        if (std::rename(filename_tmp.c_str(), filename.c_str()) != 0)
+            outError("Cannot rename file ", filename_tmp);
+        dumped.clear();
+        dumped.insert(begin(), end());
+        log_size = sizeof(CKP_BINARY_MAGIC) + 2 * sizeof(uint32_t) + header.length() + live_size;
+        log_compact = false;
+        return;
+    }
+
+    ofstream out;
+    out.exceptions(ios::failbit | ios::badbit);
+    out.open(filename.c_str(), ios::out | ios::binary | ios::app);
+    for (vector<iterator>::iterator it = changed.begin(); it != changed.end(); it++) {
+        writeRecord(out, 'P', (*it)->first, (*it)->second);
+        dumped[(*it)->first] = (*it)->second;
+    }
+    for (StrVector::iterator it = erased.begin(); it != erased.end(); it++) {
+        writeRecord(out, 'E', *it, "");
+        dumped.erase(*it);
+    }
+    out.close();
+    log_size += append_size;
+}
+
 /**
     set the header line to overwrite the default header
     @param header header line
@@ -170,27 +331,31 @@ void Checkpoint::dump(bool force)
         outWarning("via -ckptime option to avoid too frequent checkpoint for large datasets");
     }
     try {
-        ostream* out;
-        if (compression)
-            out = new ogzstream(filename_tmp.c_str());
-        else
-            out = new ofstream(filename_tmp.c_str());
-        out->exceptions(ios::failbit | ios::badbit);
-        *out << header << endl;
-        // call dump stream
-        dump(*out);
-        if (compression)
-            ((ogzstream*)out)->close();
-        else
-            ((ofstream*)out)->close();
-        delete out;
-        //        cout << "Checkpoint dumped" << endl;
-        if (fileExists(filename)) {
-            if (std::remove(filename.c_str()) != 0)
-                outError("Cannot remove file ", filename);
+        if (binary) {
+            dumpBinary();
+        } else {
+            ostream* out;
+            if (compression)
+                out = new ogzstream(filename_tmp.c_str());
+            else
+                out = new ofstream(filename_tmp.c_str());
+            out->exceptions(ios::failbit | ios::badbit);
+            *out << header << endl;
+            // call dump stream
+            dump(*out);
+            if (compression)
+                ((ogzstream*)out)->close();
+            else
+                ((ofstream*)out)->close();
+            delete out;
+            //        cout << "Checkpoint dumped" << endl;
+            if (fileExists(filename)) {
+                if (std::remove(filename.c_str()) != 0)
+                    outError("Cannot remove file ", filename);
+            }
+            if (std::rename(filename_tmp.c_str(), filename.c_str()) != 0)
+                outError("Cannot rename file ", filename_tmp);
         }
-        if (std::rename(filename_tmp.c_str(), filename.c_str()) != 0)
-            outError("Cannot rename file ", filename_tmp);
     } catch (ios::failure&) {
         outError(ERR_WRITE_OUTPUT, filename.c_str());
     }
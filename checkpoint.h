@@ -97,6 +97,13 @@ public:
     */
     void setCompression(bool compression);
 
+    /**
+      set the file format
+      @param binary true to keep the checkpoint file as an append-only binary log,
+      false (default): text dump
+     */
+    void setBinary(bool binary);
+
     /**
       set the header line to overwrite the default header
       @param header header line
@@ -505,6 +512,30 @@ protected:
     /** header line of checkpoint file */
     string header;
 
+    /** true to keep the checkpoint file as an append-only binary log */
+    bool binary;
+
+    /** for binary: value of each key as stored in the file */
+    unordered_map<string, string> dumped;
+
+    /** for binary: size of the checkpoint file in bytes */
+    size_t log_size;
+
+    /** for binary: true if the file must be rewritten on the next dump */
+    bool log_compact;
+
+    /**
+      load a binary checkpoint log from file
+      @return TRUE if loaded successfully, otherwise FALSE
+    */
+    bool loadBinary();
+
+    /**
+      append the entries changed since the previous dump to the binary log,
+      rewrite the whole file instead if the log has grown too large
+    */
+    void dumpBinary();
+
 private:
     bool ignore;
     /** name of the current nested key */
@@ -291,9 +291,9 @@ void printTrees(const char *ofile, IQTree &tree, IntVector *weights, bool compre
         else
             ((ofstream*)out)->open(ofile);
         (*out) << "[ scale=" << tree.len_scale << " ]" << endl;
-        for (StringIntMap::iterator it = tree.treels.begin(); it != tree.treels.end(); it++)
-            if (!weights || weights->at(it->second)) {
-                int id = it->second;
+        for (int i = 0; i < tree.treels.size(); i++)
+            if (!weights || weights->at(tree.treels.getIdAt(i))) {
+                int id = tree.treels.getIdAt(i);
                 out->precision(10);
                 (*out) << "[ lh=" << tree.treels_logl[id];
                 if (weights) (*out) << " w=" << weights->at(id);
@@ -331,16 +331,16 @@ void printPatternLh(const char *ofile, IQTree *tree, bool compression) {
             ((ogzstream*)out)->open(ofile/*, ios::out | ios::binary*/);
         else
             ((ofstream*)out)->open(ofile/*, ios::out | ios::binary*/);
-        int idfirst = tree->treels.begin()->second;
+        int idfirst = tree->treels.getIdAt(0);
         (*out) << tree->treels.size() << " " << tree->aln->getNSite() <<
         " " << tree->aln->getNPattern() << " " << scale << endl;
         for (i = 0; i < tree->aln->getNSite(); i++)
             (*out) << " " << tree->aln->getPatternID(i);
         (*out) << endl;
         // DO NOT CHANGE
-        for (StringIntMap::iterator it = tree->treels.begin(); it != tree->treels.end(); it++)
+        for (int j = 0; j < tree->treels.size(); j++)
         {
-            int id = it->second;
+            int id = tree->treels.getIdAt(j);
             assert(id < tree->treels_ptnlh.size());
             //out->write((char*)tree->treels_ptnlh[id], sizeof(double)*tree->aln->size());
             out->precision(10);
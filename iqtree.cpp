@@ -33,15 +33,19 @@
 #include "vectorclass/vectormath_common.h"
 #include <numeric>
 
-Params* globalParam;
+// number of bootstrap replicates scored together in IQTree::computeRepsScores()
+#define REPS_TILE (4 * VCSIZE_INT)
+
+// thread-local so that each worker of refineBootTreesParallel() drives its own PLL instance
+THREAD_LOCAL Params* globalParam;
 Alignment* globalAlignment;
 extern StringIntMap pllTreeCounter;
 
-unsigned int* pllCostMatrix; // Diep: For weighted version
-int pllCostNstates; // Diep: For weighted version
+THREAD_LOCAL unsigned int* pllCostMatrix; // Diep: For weighted version
+THREAD_LOCAL int pllCostNstates; // Diep: For weighted version
 parsimonyNumber* vectorCostMatrix = NULL; // BQM: vectorized cost matrix
-int pllRepsSegments;
-int* pllSegmentUpper;
+THREAD_LOCAL int pllRepsSegments;
+THREAD_LOCAL int* pllSegmentUpper;
 
 IQTree::IQTree()
     : PhyloTree()
@@ -71,29 +75,37 @@ void IQTree::saveUFBoot(Checkpoint* checkpoint)
     CKP_SAVE(logl_cutoff);
     int boot_splits_size = boot_splits.size();
     CKP_SAVE(boot_splits_size);
-    vector<pair<int, int>> vec;
-    for (int id = 0; id < boot_samples_pars.size(); id++) {
-        vec.push_back({ boot_trees[id], id });
-    }
-    sort(vec.begin(), vec.end());
-    vector<string> tree(boot_samples_pars.size());
-    for (auto& it : treels) {
-        int low = lower_bound(vec.begin(), vec.end(), pair<int, int> { it.second, 0 }) - vec.begin();
-        int up = upper_bound(vec.begin(), vec.end(), pair<int, int> { it.second, boot_samples_pars.size() }) - vec.begin();
-        for (int i = low; i < up; ++i) {
-            tree[vec[i].second] = it.first;
-        }
-    }
     checkpoint->startList(boot_samples_pars.size());
     for (int id = 0; id < boot_samples_pars.size(); id++) {
         checkpoint->addListElement();
         stringstream ss;
         ss.precision(10);
-        ss << boot_counts[id] << " " << boot_logl[id] << " " << tree[id];
+        ss << boot_counts[id] << " " << boot_logl[id] << " " << boot_trees[id];
         checkpoint->put("", ss.str());
     }
     checkpoint->endList();
     checkpoint->endStruct();
+
+    // each replicate tree once, keyed by its index in treels
+    checkpoint->eraseKeyPrefix(string("UFBootTree") + CKP_SEP);
+    checkpoint->startStruct("UFBootTree");
+    for (int id = 0; id < boot_samples_pars.size(); id++) {
+        string key = convertIntToString(boot_trees[id]);
+        if (!checkpoint->hasKey(key))
+            checkpoint->put(key, treels.getTree(boot_trees[id]));
+    }
+    checkpoint->endStruct();
+}
+
+/**
+ * @param tree tree field of a UFBoot replicate in the checkpoint
+ * @return the replicate tree, looked up in the UFBootTree table unless
+ * tree is already a tree string (checkpoints written before the table)
+ */
+static string getCheckpointBootTree(Checkpoint* checkpoint, const string& tree)
+{
+    Checkpoint::iterator it = checkpoint->find(string("UFBootTree") + CKP_SEP + tree);
+    return (it == checkpoint->end()) ? tree : it->second;
 }
 
 void IQTree::saveCheckpoint()
@@ -122,6 +134,7 @@ void IQTree::restoreUFBoot(Checkpoint* checkpoint)
     checkpoint->setListElement(0);
     treels.clear();
     treels_logl.clear();
+    boot_split_counter.clear();
     for (id = 0; id < boot_samples_pars.size(); id++) {
         checkpoint->addListElement();
         string str;
@@ -130,11 +143,12 @@ void IQTree::restoreUFBoot(Checkpoint* checkpoint)
         stringstream ss(str);
         string tree;
         ss >> boot_counts[id] >> boot_logl[id] >> tree;
-        if (treels.find(tree) == treels.end()) {
-            treels[tree] = treels.size();
+        tree = getCheckpointBootTree(checkpoint, tree);
+        boot_trees[id] = treels.find(tree);
+        if (boot_trees[id] < 0) {
+            boot_trees[id] = treels.insert(tree);
             treels_logl.push_back(boot_logl[id]);
         }
-        boot_trees[id] = treels[tree];
     }
     checkpoint->endList();
     checkpoint->endStruct();
@@ -162,6 +176,7 @@ void IQTree::restoreCheckpoint()
         boot_counts.resize(params->gbo_replicates);
         treels.clear();
         treels_logl.clear();
+        boot_split_counter.clear();
         for (id = 0; id < boot_samples_pars.size(); id++) {
             checkpoint->addListElement();
             string str;
@@ -170,11 +185,12 @@ void IQTree::restoreCheckpoint()
             stringstream ss(str);
             string tree;
             ss >> boot_counts[id] >> boot_logl[id] >> tree;
-            if (treels.find(tree) == treels.end()) {
-                treels[tree] = treels.size();
+            tree = getCheckpointBootTree(checkpoint, tree);
+            boot_trees[id] = treels.find(tree);
+            if (boot_trees[id] < 0) {
+                boot_trees[id] = treels.insert(tree);
                 treels_logl.push_back(boot_logl[id]);
             }
-            boot_trees[id] = treels[tree];
         }
         checkpoint->endList();
         int boot_splits_size = 0;
@@ -225,6 +241,7 @@ void IQTree::init()
     pllInst = NULL;
     pllAlignment = NULL;
     pllPartitions = NULL;
+    ratchet_aln = NULL;
     // boot_splits = new SplitGraph;
     pll2iqtree_pattern_index = NULL; // Diep
     cost_matrix = NULL; // Diep
@@ -550,43 +567,54 @@ void IQTree::initTopologyByPLLRandomAdition(Params& params)
     tmpAttr.numberOfThreads = 1;
 #endif
 
-    tmpInst = pllCreateInstance(&tmpAttr); /* Create the PLL instance */
-    /* Read in the aln file */
-    stringstream pllAln;
-    if (aln->isSuperAlignment()) {
-        ((SuperAlignment*)aln)->printCombinedAlignment(pllAln);
-    } else {
-        aln->printPhylip(pllAln);
-    }
-    string pllAlnStr = pllAln.str();
-    tmpAlignmentData = pllParsePHYLIPString(pllAlnStr.c_str(), pllAlnStr.length());
+    // the PLL parsers use globals, see runStandardBootstrapParallel()
+#ifdef _OPENMP
+#pragma omp critical(pll_setup)
+#endif
+    {
+        tmpInst = pllCreateInstance(&tmpAttr); /* Create the PLL instance */
+        /* Read in the aln file */
+        bool direct_aln = params.maximum_parsimony && canCreatePLLAlignment();
+        if (direct_aln) {
+            tmpAlignmentData = createPLLAlignment();
+        } else {
+            stringstream pllAln;
+            if (aln->isSuperAlignment()) {
+                ((SuperAlignment*)aln)->printCombinedAlignment(pllAln);
+            } else {
+                aln->printPhylip(pllAln);
+            }
+            string pllAlnStr = pllAln.str();
+            tmpAlignmentData = pllParsePHYLIPString(pllAlnStr.c_str(), pllAlnStr.length());
+        }
 
-    /* Read in the partition information */
-    // BQM: to avoid printing file
-    stringstream pllPartitionFileHandle;
-    createPLLPartition(params, pllPartitionFileHandle);
-    pllQueue* partitionInfo = pllPartitionParseString(pllPartitionFileHandle.str().c_str());
+        /* Read in the partition information */
+        // BQM: to avoid printing file
+        stringstream pllPartitionFileHandle;
+        createPLLPartition(params, pllPartitionFileHandle, tmpAlignmentData->sequenceLength);
+        pllQueue* partitionInfo = pllPartitionParseString(pllPartitionFileHandle.str().c_str());
 
-    /* Validate the partitions */
-    if (!pllPartitionsValidate(partitionInfo, tmpAlignmentData)) {
-        outError("pllPartitionsValidate");
-    }
+        /* Validate the partitions */
+        if (!pllPartitionsValidate(partitionInfo, tmpAlignmentData)) {
+            outError("pllPartitionsValidate");
+        }
 
-    /* Commit the partitions and build a partitions structure */
-    tmpPartitions = pllPartitionsCommit(partitionInfo, tmpAlignmentData);
+        /* Commit the partitions and build a partitions structure */
+        tmpPartitions = pllPartitionsCommit(partitionInfo, tmpAlignmentData);
 
-    /* We don't need the the intermediate partition queue structure anymore */
-    pllQueuePartitionsDestroy(&partitionInfo);
+        /* We don't need the the intermediate partition queue structure anymore */
+        pllQueuePartitionsDestroy(&partitionInfo);
 
-    if (params.maximum_parsimony)
-        pllSortedAlignmentRemoveDups(
-            tmpAlignmentData, tmpPartitions); // to sync IQTree aln and PLL one
+        if (params.maximum_parsimony && !direct_aln)
+            pllSortedAlignmentRemoveDups(
+                tmpAlignmentData, tmpPartitions); // to sync IQTree aln and PLL one
 
-    pllTreeInitTopologyForAlignment(tmpInst, tmpAlignmentData);
+        pllTreeInitTopologyForAlignment(tmpInst, tmpAlignmentData);
 
-    /* Connect the aln and partition structure with the tree structure */
-    if (!pllLoadAlignment(tmpInst, tmpAlignmentData, tmpPartitions)) {
-        outError("Incompatible tree/aln combination");
+        /* Connect the aln and partition structure with the tree structure */
+        if (!pllLoadAlignment(tmpInst, tmpAlignmentData, tmpPartitions)) {
+            outError("Incompatible tree/aln combination");
+        }
     }
 
     pllComputeRandomizedStepwiseAdditionParsimonyTree(tmpInst, tmpPartitions,
@@ -630,12 +658,17 @@ IQTree::~IQTree()
          it2 != boot_splits.rend(); it2++)
         delete (*it2);
     // if (boot_splits) delete boot_splits;
+    // the parsimony vectors are kept between the searches of bootstrap refinement
+    if (pllInst && pllPartitions)
+        _pllFreeParsimonyDataStructures(pllInst, pllPartitions);
     if (pllPartitions)
         myPartitionsDestroy(pllPartitions);
     if (pllAlignment)
         pllAlignmentDataDestroy(pllAlignment);
     if (pllInst)
         pllDestroyInstance(pllInst);
+    if (ratchet_aln)
+        delete ratchet_aln;
 
     if (!boot_samples.empty())
         aligned_free(boot_samples[0]); // free memory
@@ -666,8 +699,66 @@ IQTree::~IQTree()
 #endif
 }
 
+bool IQTree::canCreatePLLAlignment()
+{
+    // PHYLIP prints codons with 3 characters per site
+    return !aln->isSuperAlignment() && aln->seq_type != SEQ_CODON;
+}
+
+/** @return character of a state in the PLL alignment, as parse_phylip() reads it from Alignment::printPhylip() */
+static unsigned char getPLLStateChar(Alignment* aln, char state)
+{
+    char c = aln->convertStateBack(state);
+    // parse_phylip() turns the lower case letters into digits
+    if ('a' <= c && c <= 'z')
+        c = c - 'a' + '0';
+    return (unsigned char)c;
+}
+
+pllAlignmentData* IQTree::createPLLAlignment()
+{
+    int nseq = aln->getNSeq();
+    int nsite = aln->getNSite();
+    int seq;
+
+    // first site of each PLL site: a run of sites with the same pattern, as long
+    // as the printed columns differ from those of the previous run
+    IntVector first_site;
+    for (int site = 0; site < nsite; site++) {
+        if (site > 0) {
+            int ptn = aln->getPatternID(site);
+            int prev = aln->getPatternID(first_site.back());
+            if (ptn == prev)
+                continue;
+            Pattern& pat = aln->at(ptn);
+            Pattern& prev_pat = aln->at(prev);
+            for (seq = 0; seq < nseq; seq++)
+                if (getPLLStateChar(aln, pat[seq]) != getPLLStateChar(aln, prev_pat[seq]))
+                    break;
+            if (seq == nseq)
+                continue;
+        }
+        first_site.push_back(site);
+    }
+
+    int length = first_site.size();
+    pllAlignmentData* alignmentData = pllInitAlignmentData(nseq, length);
+    alignmentData->originalSeqLength = nsite;
+    alignmentData->siteWeights = (int*)rax_malloc(length * sizeof(int));
+    for (seq = 0; seq < nseq; seq++)
+        alignmentData->sequenceLabels[seq + 1] = strdup(aln->getSeqName(seq).c_str());
+    for (int i = 0; i < length; i++) {
+        int end = (i + 1 < length) ? first_site[i + 1] : nsite;
+        alignmentData->siteWeights[i] = end - first_site[i];
+        Pattern& pat = aln->at(aln->getPatternID(first_site[i]));
+        for (seq = 0; seq < nseq; seq++)
+            alignmentData->sequenceData[seq + 1][i] = getPLLStateChar(aln, pat[seq]);
+    }
+    return alignmentData;
+}
+
 void IQTree::createPLLPartition(Params& params,
-    ostream& pllPartitionFileHandle)
+    ostream& pllPartitionFileHandle, int nsite)
 {
     if (isSuperTree()) {
         PhyloSuperTree* siqtree = (PhyloSuperTree*)this;
@@ -717,7 +808,7 @@ void IQTree::createPLLPartition(Params& params,
             // outError("PLL currently only supports DNA/protein alignments");
         }
         pllPartitionFileHandle << model << ", p1 = "
-                               << "1-" << getAlnNSite() << endl;
+                               << "1-" << nsite << endl;
     }
 }
 
@@ -744,19 +835,26 @@ void IQTree::initializePLL(Params& params)
     pllInst = pllCreateInstance(&pllAttr);
 
     /* Read in the alignment file */
-    stringstream pllAln;
-    if (aln->isSuperAlignment()) {
-        ((SuperAlignment*)aln)->printCombinedAlignment(pllAln);
+    // for maximum parsimony the patterns are loaded directly, they are
+    // what pllSortedAlignmentRemoveDups() leaves of the printed alignment
+    bool direct_aln = params.maximum_parsimony && canCreatePLLAlignment();
+    if (direct_aln) {
+        pllAlignment = createPLLAlignment();
     } else {
-        aln->printPhylip(pllAln);
+        stringstream pllAln;
+        if (aln->isSuperAlignment()) {
+            ((SuperAlignment*)aln)->printCombinedAlignment(pllAln);
+        } else {
+            aln->printPhylip(pllAln);
+        }
+        string pllAlnStr = pllAln.str();
+        pllAlignment = pllParsePHYLIPString(pllAlnStr.c_str(), pllAlnStr.length());
     }
-    string pllAlnStr = pllAln.str();
-    pllAlignment = pllParsePHYLIPString(pllAlnStr.c_str(), pllAlnStr.length());
 
     /* Read in the partition information */
     // BQM: to avoid printing file
     stringstream pllPartitionFileHandle;
-    createPLLPartition(params, pllPartitionFileHandle);
+    createPLLPartition(params, pllPartitionFileHandle, pllAlignment->sequenceLength);
     pllQueue* partitionInfo = pllPartitionParseString(pllPartitionFileHandle.str().c_str());
 
     /* Validate the partitions */
@@ -777,11 +875,11 @@ void IQTree::initializePLL(Params& params)
     // 2021-12-29:
     //  For maximum parsimony, SYNCING between two cores (IQ-TREE and PLL) must
     //  always be guaranteed!!!!!!!! Especially necessary if having ratchet on.
-    if (params.maximum_parsimony)
+    if (!params.maximum_parsimony)
+        pllAlignmentRemoveDups(pllAlignment, pllPartitions);
+    else if (!direct_aln)
         pllSortedAlignmentRemoveDups(
             pllAlignment, pllPartitions); // to sync IQTree aln and PLL one
-    else
-        pllAlignmentRemoveDups(pllAlignment, pllPartitions);
 
     pllTreeInitTopologyForAlignment(pllInst, pllAlignment);
 
@@ -1989,17 +2087,19 @@ double IQTree::doTreeSearch()
                 string candidateTree = candidateTrees.getRandCandTree();
                 readTreeString(candidateTree);
 
-                Alignment* perturb_alignment;
-                if (aln->isSuperAlignment())
-                    perturb_alignment = new SuperAlignment;
-                else
-                    perturb_alignment = new Alignment;
-                perturb_alignment->createPerturbAlignment(
+                // the same perturbed alignment is reweighted in every ratchet iteration
+                if (!ratchet_aln) {
+                    if (aln->isSuperAlignment())
+                        ratchet_aln = new SuperAlignment;
+                    else
+                        ratchet_aln = new Alignment;
+                }
+                ratchet_aln->createPerturbAlignment(
                     aln, params->ratchet_percent, params->ratchet_wgt,
                     params->sort_alignment);
                 saved_aln_on_ratchet_iter = aln;
 
-                setAlignment(perturb_alignment);
+                setAlignment(ratchet_aln);
                 setRootNode(params->root);
                 on_ratchet_hclimb1 = true;
 
@@ -2014,6 +2114,10 @@ double IQTree::doTreeSearch()
          * Perturb the tree
          *---------------------------------------*/
         double perturbScore;
+        // with random NNIs on a candidate tree, the parsimony vectors of the subtrees
+        // it shares with the current tree are kept, only the perturbed paths are recomputed
+        bool keep_pars = params->maximum_parsimony && params->spr_parsimony && params->snni && !params->iqp;
+        SubtreeParsMap kept_pars;
         if (!on_ratchet_hclimb1) {
             if (iqp_assess_quartet == IQP_BOOTSTRAP) {
                 // create bootstrap sample
@@ -2037,7 +2141,11 @@ double IQTree::doTreeSearch()
                     // candidateTrees.getRandCandVecTree(); // Diep: to pick
                     // from vector-stored candidates
                     string candidateTree = candidateTrees.getRandCandTree();
+                    if (keep_pars)
+                        getComputedPartialPars(kept_pars);
                     readTreeString(candidateTree);
+                    if (keep_pars)
+                        assignPartialPars(kept_pars);
                     if (params->iqp) {
                         doIQP();
                     } else {
@@ -2069,8 +2177,10 @@ double IQTree::doTreeSearch()
                     // NULL);
                     // pllTreeInitTopologyNewick(pllInst, perturbTree,
                     // PLL_FALSE);
-                    initializeAllPartialPars();
-                    clearAllPartialLH();
+                    if (!keep_pars) {
+                        initializeAllPartialPars();
+                        clearAllPartialLH();
+                    }
                     curScore = perturbScore = -computeParsimony();
                     //                    pllNewickParseDestroy(&perturbTree);
                 } else if (params->pll) {
@@ -2104,7 +2214,8 @@ double IQTree::doTreeSearch()
         int nni_count = 0;
         int nni_steps = 0;
 
-        imd_tree = doNNISearch(nni_count, nni_steps);
+        // the SPR search does not print the tree, it is printed below only if kept
+        imd_tree = doNNISearch(nni_count, nni_steps, false);
 
         if (iqp_assess_quartet == IQP_BOOTSTRAP) {
             // restore alignment
@@ -2124,8 +2235,7 @@ double IQTree::doTreeSearch()
         if (on_ratchet_hclimb1) {
             ratchet_iter_count = 0;
 
-            // restore alignment
-            delete aln;
+            // restore alignment, ratchet_aln is kept for the next ratchet iteration
             setAlignment(saved_aln_on_ratchet_iter);
             on_ratchet_hclimb1 = false;
 
@@ -2139,7 +2249,7 @@ double IQTree::doTreeSearch()
             int nni_count = 0;
             int nni_steps = 0;
             on_ratchet_hclimb2 = true;
-            imd_tree = doNNISearch(nni_count, nni_steps);
+            imd_tree = doNNISearch(nni_count, nni_steps, false);
             // update current score
             initializeAllPartialLh();
             clearAllPartialLH();
@@ -2243,6 +2353,8 @@ endl;
 
         // Diep: This is old code for updating best tree
         if (curScore > bestScore) {
+            if (imd_tree.empty())
+                imd_tree = getTreeString();
             stringstream cur_tree_topo_ss;
             setRootNode(params->root);
             printTree(cur_tree_topo_ss, WT_TAXON_ID | WT_SORT_TAXA);
@@ -2276,7 +2388,7 @@ endl;
 
         // check whether the tree can be put into the reference set
         if (params->snni) {
-            candidateTrees.update(imd_tree, curScore);
+            candidateTrees.update(imd_tree, curScore, this);
             if (verbose_mode >= VB_MED) {
                 printBestScores(candidateTrees.popSize);
             }
@@ -2293,7 +2405,8 @@ endl;
         /*----------------------------------------
          * convergence criterion for ultrafast bootstrap
          *---------------------------------------*/
-        if ((curIt) % (params->step_iterations / 2) == 0 && params->stop_condition == SC_BOOTSTRAP_CORRELATION) {
+        bool check_correlation = params->stop_condition == SC_BOOTSTRAP_CORRELATION || params->boot_correlation_stop;
+        if ((curIt) % (params->step_iterations / 2) == 0 && check_correlation) {
             // compute split support every half step
             SplitGraph* sg = new SplitGraph;
             summarizeBootstrap(*sg);
@@ -2312,7 +2425,7 @@ endl;
 
             // check convergence every full step
             if (curIt % params->step_iterations == 0) {
-                cur_correlation = computeBootstrapCorrelation();
+                cur_correlation = updateBootstrapCorrelation();
                 cout.precision(3);
                 cout << "NOTE: Bootstrap correlation coefficient of split "
                         "occurrence frequencies: "
@@ -2327,6 +2440,10 @@ endl;
                     // iterations" << endl;
                 }
             }
+        } else if (check_correlation && boot_splits.size() >= 2 &&
+                   !(params->maximum_parsimony && params->multiple_hits)) {
+            // boot_split_counter makes the check cheap enough for every iteration
+            cur_correlation = updateBootstrapCorrelation();
         } // end of bootstrap convergence test
         saveCheckpoint();
         checkpoint->dump();
@@ -2394,36 +2511,14 @@ endl;
 /****************************************************************************
  Fast Nearest Neighbor Interchange by maximum likelihood
  ****************************************************************************/
-string IQTree::doNNISearch(int& nniCount, int& nniSteps)
+string IQTree::doNNISearch(int& nniCount, int& nniSteps, bool print_tree)
 {
     string treeString;
     if (params->maximum_parsimony && params->spr_parsimony && (params->snni || params->pll)) { // SPR for mpars
         if (on_opt_btree) {
-            if (pllPartitions) {
-                myPartitionsDestroy(pllPartitions);
-                pllPartitions = NULL;
-            }
-            if (pllAlignment) {
-                pllAlignmentDataDestroy(pllAlignment);
-                pllAlignment = NULL;
-            }
-            if (pllInst) {
-                pllDestroyInstance(pllInst);
-                pllInst = NULL;
-            }
-
-            // Diep: sorting the boot aln is needed for branch and bound
-            // weighted search
-            PatternComp pcomp;
-            sort(aln->begin(), aln->end(), pcomp);
-            aln->updateSitePatternAfterOptimized();
-
-            initializePLL(*params); // because the set of patterns might be a
-                // subset of the orig
-            pllNewickTree* btree = pllNewickParseString(getTreeString().c_str());
-            assert(btree != NULL);
-            pllTreeInitTopologyNewick(pllInst, btree, PLL_FALSE);
-            pllNewickParseDestroy(&btree);
+            // the PLL instance was built from saved_aln_on_opt_btree (see initializeBootTreePLL()),
+            // the bootstrap alignment has the same patterns, the search only reweights them
+            assert(pllInst);
 
             // update segmenting information
             if (params->sankoff_cost_file) {
@@ -2438,57 +2533,40 @@ string IQTree::doNNISearch(int& nniCount, int& nniSteps)
             curScore = optimizeNNI(nniCount, nniSteps);
             treeString = getTreeString();
         } else {
-            string treeString1 = getTreeString();
-            size_t index = 0;
-            while (true) {
-                /* Locate the substring to replace. */
-                index = treeString1.find(":nan", index);
-                if (index == std::string::npos)
-                    break;
-
-                /* Make the replacement. */
-                treeString1.replace(index, 4, ":0");
-
-                /* Advance index forward so the next iteration doesn't pick it
-                 * up as well. */
-                index += 4;
-            }
-
             int max_spr_rad = params->spr_maxtrav;
             if (on_opt_btree && params->opt_btree_nni)
                 params->spr_maxtrav = 1;
 
-            pllNewickTree* sprStartTree = pllNewickParseString(treeString1.c_str());
-            assert(sprStartTree != NULL);
-            pllTreeInitTopologyNewick(pllInst, sprStartTree, PLL_FALSE);
+            copyTopologyToPLL();
+            string start_topology = candidateTrees.getTopology(this);
+            int start_score = -curScore, spr_score;
 
             // ----------------- Key step: ask PLL to run SPR/TBR hill-climbing
             if (params->tbr_pars == true) {
-                pllOptimizeTbrParsimony(pllInst, pllPartitions,
+                spr_score = pllOptimizeTbrParsimony(pllInst, pllPartitions,
                     params->tbr_mintrav,
                     params->tbr_maxtrav, this);
             } else {
-                pllOptimizeSprParsimony(pllInst, pllPartitions,
+                spr_score = pllOptimizeSprParsimony(pllInst, pllPartitions,
                     params->spr_mintrav, max_spr_rad, this);
             }
 
-            pllNewickParseDestroy(&sprStartTree);
-
-            pllTreeToNewick(pllInst->tree_string, pllInst, pllPartitions,
-                pllInst->start->back, params->print_branch_lengths, PLL_TRUE, 0, 0, 0,
-                PLL_SUMMARIZE_LH, 0, 0);
-            treeString = string(pllInst->tree_string);
-            if (treeString == treeString1)
-                outError("Tree string stays the same after SPR.");
-            readTreeString(treeString);
-            initializeAllPartialPars();
-            clearAllPartialLH();
+            // SPR moves change few subtrees, keep the parsimony vectors of the others
+            SubtreeParsMap kept_pars;
+            getComputedPartialPars(kept_pars);
+            copyTopologyFromPLL();
+            if (spr_score < start_score && candidateTrees.getTopology(this) == start_topology)
+                outError("Tree topology stays the same after SPR.");
+            // the tree now reads the same as the NEWICK string of pllInst
+            if (print_tree)
+                treeString = getTreeString();
+            assignPartialPars(kept_pars);
             curScore = -computeParsimony();
 
             // deallocation will occur once at the end of
             // runTreeReconstruction() if not running ratchet oct 23: in
             // non-ratchet iteration, free is not triggered
-            if ((((params->ratchet_iter >= 0 && (!on_ratchet_hclimb2)) || on_opt_btree) && (!params->hclimb1_nni))) {
+            if (((params->ratchet_iter >= 0 && (!on_ratchet_hclimb2)) && (!params->hclimb1_nni))) {
                 //			if(((params->ratchet_iter >= 0) &&
                 //(!params->hclimb1_nni))){
                 _pllFreeParsimonyDataStructures(pllInst, pllPartitions);
@@ -2514,6 +2592,125 @@ string IQTree::doNNISearch(int& nniCount, int& nniSteps)
     return treeString;
 }
 
+bool IQTree::pllTaxaMatchAlignment()
+{
+    if (pllInst == NULL || pllInst->nameHash == NULL || pllInst->mxtips != aln->getNSeq())
+        return false;
+    for (int k = 1; k <= pllInst->mxtips; k++)
+        if (aln->getSeqName(k - 1) != pllInst->nameList[k])
+            return false;
+    return true;
+}
+
+void IQTree::linkPLLSubtree(Node* node, Node* dad, nodeptr slot, int& inner)
+{
+    nodeptr p = node->isLeaf() ? pllInst->nodep[node->id + 1] : pllInst->nodep[inner++];
+    // branch length as printed by getTreeString() and read back by linkTaxa()
+    double len = node->findNeighbor(dad)->length;
+    if (std::isnan(len))
+        len = 0.0;
+    double z = exp(-len / pllInst->fracchange);
+    if (z < PLL_ZMIN)
+        z = PLL_ZMIN;
+    if (z > PLL_ZMAX)
+        z = PLL_ZMAX;
+    slot->back = p;
+    p->back = slot;
+    for (int j = 0; j < PLL_NUM_BRANCHES; j++)
+        slot->z[j] = p->z[j] = z;
+    if (node->isLeaf())
+        return;
+    // linkTaxa() fills the slots from the last child to the first one
+    Node* child[2];
+    int nchild = 0;
+    FOR_NEIGHBOR_IT(node, dad, it)
+        child[nchild++] = (*it)->node;
+    linkPLLSubtree(child[1], node, p->next->next, inner);
+    linkPLLSubtree(child[0], node, p->next, inner);
+}
+
+void IQTree::copyTopologyToPLL()
+{
+    Node* top = root->isLeaf() ? root->neighbors[0]->node : root;
+    if (isSuperTree() || rooted || top->isLeaf() || leafNum != aln->getNSeq()
+        || !isBifurcating() || !pllTaxaMatchAlignment()) {
+        string tree_str = getTreeString();
+        size_t index = 0;
+        while ((index = tree_str.find(":nan", index)) != string::npos) {
+            tree_str.replace(index, 4, ":0");
+            index += 2;
+        }
+        pllNewickTree* newick;
+#ifdef _OPENMP
+#pragma omp critical(pll_setup)
+#endif
+        newick = pllNewickParseString(tree_str.c_str());
+        assert(newick != NULL);
+        pllTreeInitTopologyNewick(pllInst, newick, PLL_FALSE);
+        pllNewickParseDestroy(&newick);
+        return;
+    }
+
+    int inner = pllInst->mxtips + 1;
+    nodeptr r = pllInst->nodep[inner++];
+    nodeptr slot[3] = { r, r->next, r->next->next };
+    Node* child[3];
+    int nchild = 0;
+    FOR_NEIGHBOR_IT(top, NULL, it)
+        child[nchild++] = (*it)->node;
+    for (int i = 2; i >= 0; i--)
+        linkPLLSubtree(child[i], top, slot[i], inner);
+    pllInst->start = pllInst->nodep[1];
+}
+
+Node* IQTree::newSubtreeFromPLL(nodeptr p, bool top, Node*& first_leaf)
+{
+    Node* node = newNode();
+    if (isTip(p->number, pllInst->mxtips)) {
+        node->name = aln->getSeqName(p->number - 1);
+        node->id = p->number - 1;
+        if (!first_leaf)
+            first_leaf = node;
+        leafNum++;
+        return node;
+    }
+    nodeptr child[3] = { p->next->back, p->next->next->back, p->back };
+    for (int i = 0; i < (top ? 3 : 2); i++) {
+        Node* child_node = newSubtreeFromPLL(child[i], false, first_leaf);
+        node->addNeighbor(child_node, -1.0);
+        child_node->addNeighbor(node, -1.0);
+    }
+    return node;
+}
+
+void IQTree::copyTopologyFromPLL()
+{
+    nodeptr top = pllInst->start->back;
+    if (isSuperTree() || rooted || params->print_branch_lengths
+        || isTip(top->number, pllInst->mxtips) || !pllTaxaMatchAlignment()) {
+        pllTreeToNewick(pllInst->tree_string, pllInst, pllPartitions,
+            top, params->print_branch_lengths, PLL_TRUE, 0, 0, 0,
+            PLL_SUMMARIZE_LH, 0, 0);
+        readTreeString(string(pllInst->tree_string));
+        return;
+    }
+
+    // same nodes as readTree() creates for the PLL NEWICK string
+    freeNode();
+    leafNum = 0;
+    Node* first_leaf = NULL;
+    Node* top_node = newSubtreeFromPLL(top, true, first_leaf);
+    root = first_leaf;
+    FOR_NEIGHBOR_IT(top_node, NULL, it)
+        if ((*it)->node->isLeaf()) {
+            root = (*it)->node;
+            break;
+        }
+    nodeNum = leafNum;
+    initializeTree();
+    clearAllPartialLH();
+}
+
 double IQTree::optimizeNNI(int& nni_count, int& nni_steps)
 {
     bool rollBack = false;
@@ -2862,8 +3059,8 @@ void IQTree::optimizeBootTrees()
         params->maximum_parsimony = true;
         params->spr_maxtrav = params->opt_btree_spr;
     }
+    initializeBootTreePLL();
 
-    int nptn = getAlnNPattern();
     string tree;
     int tree_index;
     Alignment* bootstrap_aln;
@@ -2883,18 +3080,26 @@ void IQTree::optimizeBootTrees()
 
     int nmultifurcate = 0;
     int sample_last = cur_boot_sample + 1;
+#ifdef _OPENMP
+    // the consensus of the top trees goes through btree_file, keep it serial
+    if (params->num_threads > 1 && !(params->distinct_iter_top_boot >= 1 && !params->multiple_hits && params->top_boot_concensus)) {
+        refineBootTreesParallel(sample_last, num_boot_rep, saved_tree);
+        sample_last = num_boot_rep;
+    }
+#endif
+    // one copy of the patterns, reweighted for each replicate
+    bootstrap_aln = new Alignment;
+    bootstrap_aln->copyPatterns(*saved_aln_on_opt_btree);
+    bootstrap_aln->computeUnknownState();
     for (int sample = sample_last; sample < num_boot_rep; sample++) {
         if ((sample + 1) % 100 == 0)
             cout << sample + 1 << " replicates done" << endl;
         //		out << sample << "\t" << boot_update_iter[sample] <<
         //"\t"
         //<< boot_trees[sample] << endl;
-        bootstrap_aln = new Alignment;
-        bootstrap_aln->modifyPatternFreq(*saved_aln_on_opt_btree,
-            boot_samples_pars[sample], nptn);
+        bootstrap_aln->setPatternFreq(boot_samples_pars[sample]);
 
         setAlignment(bootstrap_aln);
-        bootstrap_aln->computeUnknownState();
         if (params->multiple_hits) { // process a few trees in
             // boot_trees_parsimony[sample]
             IntegerSet result;
@@ -2902,57 +3107,12 @@ void IQTree::optimizeBootTrees()
 
             for (IntegerSet::iterator it = boot_trees_parsimony[sample].begin();
                  it != boot_trees_parsimony[sample].end(); ++it) {
-                StringIntMap::iterator mit;
-                for (mit = treels.begin(); mit != treels.end(); ++mit) {
-                    if (mit->second == *it) {
-                        tree = mit->first;
-                        break;
-                    }
-                }
+                tree = treels.getTree(*it);
 
                 // Read the bootstrap tree
-                stringstream str(tree);
-                freeNode();
-                readTree(str, rooted);
-                NodeVector taxai;
-                getTaxa(taxai);
-                for (NodeVector::iterator taxit = taxai.begin();
-                     taxit != taxai.end(); taxit++) {
-                    (*taxit)->id = atoi((*taxit)->name.c_str());
-                }
-
-                NodeVector taxa;
-                // change the taxa name from ID to real name
-                getOrderedTaxa(taxa);
-                for (int j = 0; j < taxa.size(); j++)
-                    taxa[j]->name = saved_aln_on_opt_btree->getSeqName(taxa[j]->id);
-
-                initializeAllPartialLh();
-                clearAllPartialLH();
-
-                curScore = -computeParsimony();
-                //				cout << "before: " << curScore
-                //<< ",
-                //";
-
-                int count, step;
-                doNNISearch(count, step);
-
-                curScore = -computeParsimony();
-                //				cout << "after: " << curScore <<
-                // endl;
-
-                stringstream ostr;
-                printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA);
-                tree = ostr.str();
-                mit = treels.find(tree);
-                if (mit != treels.end()) {
-                    tree_index = mit->second;
-                } else {
-                    treels_logl.push_back(curScore); // TEMPORARILY
-                    tree_index = treels_logl.size() - 1;
-                    treels[tree] = tree_index;
-                }
+                readBootTree(tree);
+                tree = refineBootTree();
+                tree_index = addBootTree(tree, curScore);
 
                 if (result.empty() || curScore == best_boot_score) {
                     result.insert(tree_index);
@@ -3005,13 +3165,7 @@ void IQTree::optimizeBootTrees()
                 ofstream btout(btree_file.c_str());
                 for (IntPairVector::iterator it = boot_trees_parsimony_top[sample].begin();
                      it != boot_trees_parsimony_top[sample].end(); ++it, ++id) {
-                    StringIntMap::iterator mit;
-                    for (mit = treels.begin(); mit != treels.end(); ++mit) {
-                        if (mit->second == it->first) {
-                            tree = mit->first;
-                            break;
-                        }
-                    }
+                    tree = treels.getTree(it->first);
                     sample_treels[tree] = id;
                     //					out << tree << endl;
                     btout << tree << endl;
@@ -3040,54 +3194,13 @@ void IQTree::optimizeBootTrees()
                 //				out << "concensus: " <<
                 // sample_cons << endl;
                 // Read the concensus tree
-                stringstream str(sample_cons);
-                freeNode();
-                readTree(str, rooted);
-                NodeVector taxai;
-                getTaxa(taxai);
-                for (NodeVector::iterator taxit = taxai.begin();
-                     taxit != taxai.end(); taxit++) {
-                    (*taxit)->id = atoi((*taxit)->name.c_str());
-                }
-
-                NodeVector taxa;
-                // change the taxa name from ID to real name
-                getOrderedTaxa(taxa);
-                for (int j = 0; j < taxa.size(); j++)
-                    taxa[j]->name = saved_aln_on_opt_btree->getSeqName(taxa[j]->id);
-
-                initializeAllPartialLh();
-                clearAllPartialLH();
+                readBootTree(sample_cons);
 
                 bool is_bifurcating = isBifurcating();
 
                 if (is_bifurcating) {
-                    curScore = -computeParsimony();
-                    //					cout << "before: " <<
-                    // curScore << ",
-                    //"; 					out << curScore
-                    //<< "\t";
-
-                    int count, step;
-                    doNNISearch(count, step);
-
-                    curScore = -computeParsimony();
-                    //					cout << "after: " <<
-                    // curScore << endl;
-
-                    //					out << curScore << endl;
-
-                    stringstream ostr;
-                    printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA);
-                    tree = ostr.str();
-                    StringIntMap::iterator mit = treels.find(tree);
-                    if (mit != treels.end()) {
-                        tree_index = mit->second;
-                    } else {
-                        treels_logl.push_back(curScore); // TEMPORARILY
-                        tree_index = treels_logl.size() - 1;
-                        treels[tree] = tree_index;
-                    }
+                    tree = refineBootTree();
+                    tree_index = addBootTree(tree, curScore);
 
                     boot_logl[sample] = curScore;
                     boot_trees[sample] = tree_index;
@@ -3102,13 +3215,7 @@ void IQTree::optimizeBootTrees()
                 id = 0;
                 for (IntPairVector::iterator it = boot_trees_parsimony_top[sample].begin();
                      it != boot_trees_parsimony_top[sample].end(); ++it, ++id) {
-                    StringIntMap::iterator mit;
-                    for (mit = treels.begin(); mit != treels.end(); ++mit) {
-                        if (mit->second == it->first) {
-                            tree = mit->first;
-                            break;
-                        }
-                    }
+                    tree = treels.getTree(it->first);
 
                     //					out << it->first << "\t"
                     //<< boot_trees_parsimony_top_iter[sample][id]
@@ -3116,53 +3223,10 @@ void IQTree::optimizeBootTrees()
                     // it->second <<
                     //"\t";
                     // Read the bootstrap tree
-                    stringstream str(tree);
-                    freeNode();
-                    readTree(str, rooted);
-                    NodeVector taxai;
-                    getTaxa(taxai);
-                    for (NodeVector::iterator taxit = taxai.begin();
-                         taxit != taxai.end(); taxit++) {
-                        (*taxit)->id = atoi((*taxit)->name.c_str());
-                    }
-
-                    NodeVector taxa;
-                    // change the taxa name from ID to real name
-                    getOrderedTaxa(taxa);
-                    for (int j = 0; j < taxa.size(); j++)
-                        taxa[j]->name = saved_aln_on_opt_btree->getSeqName(taxa[j]->id);
-
-                    initializeAllPartialLh();
-                    clearAllPartialLH();
-
-                    curScore = -computeParsimony();
-                    ////				cout << "before: " <<
-                    /// curScore << ",
-                    ///";
-                    //					out << curScore << "\t";
-
-                    int count, step;
-                    doNNISearch(count, step);
-
-                    curScore = -computeParsimony();
-                    //				cout << "after: " << curScore <<
-                    // endl;
-
-                    //					out << curScore << endl;
-
-                    stringstream ostr;
-                    printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA);
-                    tree = ostr.str();
+                    readBootTree(tree);
+                    tree = refineBootTree();
                     all_btree_str += tree + "\n"; // tmp, for debug
-
-                    mit = treels.find(tree);
-                    if (mit != treels.end()) {
-                        tree_index = mit->second;
-                    } else {
-                        treels_logl.push_back(curScore); // TEMPORARILY
-                        tree_index = treels_logl.size() - 1;
-                        treels[tree] = tree_index;
-                    }
+                    tree_index = addBootTree(tree, curScore);
 
                     if (curScore >= best_boot_score) {
                         best_boot_score = curScore;
@@ -3189,70 +3253,14 @@ void IQTree::optimizeBootTrees()
         }
 
         if ((!params->multiple_hits) && (params->distinct_iter_top_boot < 1)) { // process one tree in boot_trees[sample]
-            StringIntMap::iterator mit;
-            for (mit = treels.begin(); mit != treels.end(); ++mit) {
-                if (mit->second == boot_trees[sample]) {
-                    tree = mit->first;
-                    break;
-                }
-            }
+            tree = treels.getTree(boot_trees[sample]);
             //			out << "sample#" << sample << ", boot_count = "
             //<< boot_counts[sample] << endl; 			out <<
             // mit->second << "\t" << boot_logl[sample] << "\t";
             // Read the bootstrap tree
-            stringstream str(tree);
-            freeNode();
-            readTree(str, rooted);
-            NodeVector taxai;
-            getTaxa(taxai);
-            for (NodeVector::iterator taxit = taxai.begin();
-                 taxit != taxai.end(); taxit++) {
-                (*taxit)->id = atoi((*taxit)->name.c_str());
-            }
-
-            NodeVector taxa;
-            // change the taxa name from ID to real name
-            getOrderedTaxa(taxa);
-            for (int j = 0; j < taxa.size(); j++)
-                taxa[j]->name = saved_aln_on_opt_btree->getSeqName(taxa[j]->id);
-
-            initializeAllPartialLh();
-            clearAllPartialLH();
-
-            //			// tmp, to-be-removed
-            // #############################################
-            // stringstream ostr1; 			printTree(ostr1,
-            // WT_SORT_TAXA); 			tree
-            // =
-            // ostr1.str(); 			outb << tree << endl;
-
-            curScore = -computeParsimony();
-            //			out << curScore << "\t";
-
-            int count, step;
-            doNNISearch(count, step);
-
-            curScore = -computeParsimony();
-            //			out << curScore << endl;
-
-            //			// tmp, to-be-removed
-            // #############################################
-            // ostr1.str(""); 			printTree(ostr1, WT_SORT_TAXA);
-            // tree
-            // =
-            // ostr1.str(); 			outa << tree << endl;
-
-            stringstream ostr;
-            printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA);
-            tree = ostr.str();
-            mit = treels.find(tree);
-            if (mit != treels.end()) {
-                tree_index = mit->second;
-            } else {
-                treels_logl.push_back(curScore); // TEMPORARILY
-                tree_index = treels_logl.size() - 1;
-                treels[tree] = tree_index;
-            }
+            readBootTree(tree);
+            tree = refineBootTree();
+            tree_index = addBootTree(tree, curScore);
 
             boot_trees[sample] = tree_index;
             boot_logl[sample] = curScore;
@@ -3262,11 +3270,11 @@ void IQTree::optimizeBootTrees()
                 checkpoint->dump();
             }
         }
-        delete aln;
 
         //		out << -boot_logl[sample] << endl; // to examine score
         // after refinement
     }
+    delete bootstrap_aln;
 
     //	cout << "# of multifurcating = " << nmultifurcate << endl;
     //	outb.close();
@@ -3324,8 +3332,8 @@ void IQTree::optimizeBootTreesPure()
     save_all_trees = 0;
     string saved_tree = getTreeString();
     saved_aln_on_opt_btree = aln;
+    initializeBootTreePLL();
 
-    int nptn = getAlnNPattern();
     string tree;
     int tree_index;
     Alignment* bootstrap_aln;
@@ -3335,11 +3343,19 @@ void IQTree::optimizeBootTreesPure()
     //	ofstream out(boot_score_file.c_str());
     //	out << "sample\tunrefined\trefined" << endl;
 
-    for (int sample = 0; sample < num_boot_rep; sample++) {
+    int sample_first = 0;
+#ifdef _OPENMP
+    if (params->num_threads > 1) {
+        refineBootTreesParallel(0, num_boot_rep, saved_tree);
+        sample_first = num_boot_rep;
+    }
+#endif
+    // one copy of the patterns, reweighted for each replicate
+    bootstrap_aln = new Alignment;
+    bootstrap_aln->copyPatterns(*saved_aln_on_opt_btree);
+    for (int sample = sample_first; sample < num_boot_rep; sample++) {
         //		out << sample << "\t" << boot_logl[sample] << "\t";
-        bootstrap_aln = new Alignment;
-        bootstrap_aln->modifyPatternFreq(*saved_aln_on_opt_btree,
-            boot_samples_pars[sample], nptn);
+        bootstrap_aln->setPatternFreq(boot_samples_pars[sample]);
 
         setAlignment(bootstrap_aln);
 
@@ -3347,37 +3363,15 @@ void IQTree::optimizeBootTreesPure()
         string tree = candidateTrees.getRandCandTree();
         readTreeString(tree);
 
-        initializeAllPartialLh();
-        clearAllPartialLH();
-
-        //			curScore = -computeParsimony();
-        //			cout << "before: " << curScore << ", ";
-
-        int count, step;
-        doNNISearch(count, step);
-
-        curScore = -computeParsimony();
-        //			cout << "after: " << curScore << endl;
-
-        stringstream ostr;
-        printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA);
-        tree = ostr.str();
-        StringIntMap::iterator mit;
-        mit = treels.find(tree);
-        if (mit != treels.end()) {
-            tree_index = mit->second;
-        } else {
-            treels_logl.push_back(curScore); // TEMPORARILY
-            tree_index = treels_logl.size() - 1;
-            treels[tree] = tree_index;
-        }
+        tree = refineBootTree();
+        tree_index = addBootTree(tree, curScore);
 
         boot_trees[sample] = tree_index;
         boot_logl[sample] = curScore;
 
-        delete aln;
         //		out << boot_logl[sample] << endl;
     }
+    delete bootstrap_aln;
 
     //	out.close();
 
@@ -3404,6 +3398,316 @@ void IQTree::optimizeBootTreesPure()
     on_opt_btree = false;
 }
 
+void IQTree::initializeBootTreePLL()
+{
+    if (pllInst || !(params->maximum_parsimony && params->spr_parsimony && (params->snni || params->pll)))
+        return;
+    assert(aln == saved_aln_on_opt_btree);
+    // the PLL parsers use globals, see refineBootTreesParallel()
+#ifdef _OPENMP
+#pragma omp critical(pll_setup)
+#endif
+    initializePLL(*params);
+}
+
+void IQTree::readBootTree(const string& tree)
+{
+    stringstream str(tree);
+    freeNode();
+    readTree(str, rooted);
+    NodeVector taxai;
+    getTaxa(taxai);
+    for (NodeVector::iterator taxit = taxai.begin(); taxit != taxai.end(); taxit++) {
+        (*taxit)->id = atoi((*taxit)->name.c_str());
+    }
+
+    NodeVector taxa;
+    // change the taxa name from ID to real name
+    getOrderedTaxa(taxa);
+    for (int j = 0; j < taxa.size(); j++)
+        taxa[j]->name = saved_aln_on_opt_btree->getSeqName(taxa[j]->id);
+}
+
+string IQTree::refineBootTree()
+{
+    initializeAllPartialLh();
+    clearAllPartialLH();
+
+    curScore = -computeParsimony();
+
+    int count, step;
+    doNNISearch(count, step, false);
+
+    curScore = -computeParsimony();
+
+    stringstream ostr;
+    printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA);
+    return ostr.str();
+}
+
+int IQTree::addBootTree(const string& tree, double score)
+{
+    int tree_index = treels.find(tree);
+    if (tree_index >= 0)
+        return tree_index;
+    treels_logl.push_back(score); // TEMPORARILY
+    tree_index = treels_logl.size() - 1;
+    treels.insert(tree, tree_index);
+    return tree_index;
+}
+
+IQTree* IQTree::newWorkerTree(Params* worker_params, Alignment* worker_aln)
+{
+    IQTree* worker;
+    if (cost_matrix) {
+        worker = new ParsTree(worker_aln);
+        worker->cost_nstates = cost_nstates;
+        worker->cost_matrix = aligned_alloc<unsigned int>(cost_nstates * cost_nstates);
+        memcpy(worker->cost_matrix, cost_matrix, sizeof(unsigned int) * cost_nstates * cost_nstates);
+    } else {
+        worker = new IQTree(worker_aln);
+    }
+    worker->params = worker_params;
+    // doNNISearch() compares the topologies before and after SPR
+    worker->candidateTrees.aln = worker_aln;
+    // the PLL parsimony vectors are refilled for the pattern weights of every search
+    worker->on_opt_btree = true;
+    worker->on_ratchet_hclimb1 = false;
+    worker->on_ratchet_hclimb2 = false;
+    worker->save_all_trees = 0;
+    worker->rooted = rooted;
+    return worker;
+}
+
+/**
+ * delete a tree created by IQTree::newWorkerTree() after the parallel searches,
+ * keeping the vectorized cost matrix shared by all trees
+ */
+static void deleteWorkerTree(IQTree* worker)
+{
+#ifdef _OPENMP
+#pragma omp critical(pll_setup)
+#endif
+    {
+        parsimonyNumber* saved_cost_matrix = vectorCostMatrix;
+        vectorCostMatrix = NULL;
+        delete worker;
+        vectorCostMatrix = saved_cost_matrix;
+    }
+}
+
+IQTree* IQTree::newBootTreeWorker(Params* worker_params, const string& start_tree)
+{
+    IQTree* worker = newWorkerTree(worker_params, saved_aln_on_opt_btree);
+    worker->saved_aln_on_opt_btree = saved_aln_on_opt_btree;
+    worker->initializeBootTreePLL();
+
+    // bootstrap alignments have the patterns of the original one
+    worker->readTreeString(start_tree);
+    worker->initializeAllPartialLh();
+    worker->computeParsimony();
+    return worker;
+}
+
+void IQTree::refineBootTreesParallel(int sample_begin, int sample_end, const string& start_tree)
+{
+#ifdef _OPENMP
+    bool pure = params->save_trees_off;
+    bool find_best = !params->multiple_hits && params->distinct_iter_top_boot >= 1;
+
+    // the vectorized cost matrix is shared by the workers, build it before they start
+    if (cost_matrix)
+        initializeVectorCostMatrix(cost_matrix, cost_nstates, params->sankoff_short_int);
+
+    // batches end at multiples of 50 replicates, where the serial version writes the checkpoint
+    for (int batch_begin = sample_begin; batch_begin < sample_end;) {
+        int batch_end = min(sample_end, (batch_begin / 50 + 1) * 50);
+        int nbatch = batch_end - batch_begin;
+
+        // the starting trees of each replicate, replaced by the refined trees
+        vector<StrVector> trees(nbatch);
+        vector<DoubleVector> scores(nbatch);
+        for (int i = 0; i < nbatch; i++) {
+            int sample = batch_begin + i;
+            if (pure) {
+                trees[i].push_back(candidateTrees.getRandCandTree());
+            } else if (params->multiple_hits) {
+                for (IntegerSet::iterator it = boot_trees_parsimony[sample].begin();
+                     it != boot_trees_parsimony[sample].end(); ++it)
+                    trees[i].push_back(treels.getTree(*it));
+            } else if (find_best) {
+                for (IntPairVector::iterator it = boot_trees_parsimony_top[sample].begin();
+                     it != boot_trees_parsimony_top[sample].end(); ++it)
+                    trees[i].push_back(treels.getTree(it->first));
+            } else {
+                trees[i].push_back(treels.getTree(boot_trees[sample]));
+            }
+            scores[i].resize(trees[i].size());
+        }
+
+        // the PLL search state is thread-local, the master thread gets its own back afterwards
+        PllSearchState saved_state;
+        saved_state.capture();
+
+#pragma omp parallel
+        {
+            Params worker_params = *params;
+            worker_params.num_threads = 1;
+            IQTree* worker = newBootTreeWorker(&worker_params, start_tree);
+            Alignment* bootstrap_aln = new Alignment;
+            bootstrap_aln->copyPatterns(*saved_aln_on_opt_btree);
+            bootstrap_aln->computeUnknownState();
+
+#pragma omp for schedule(dynamic)
+            for (int i = 0; i < nbatch; i++) {
+                int sample = batch_begin + i;
+                int* saved_stream = init_random_stream(sample, sample_end, params->ran_seed);
+                bootstrap_aln->setPatternFreq(boot_samples_pars[sample]);
+                worker->aln = bootstrap_aln;
+                for (int j = 0; j < trees[i].size(); j++) {
+                    // doNNISearch() may change it with -opt_btree_nni
+                    worker_params.spr_maxtrav = params->spr_maxtrav;
+                    if (pure)
+                        worker->readTreeString(trees[i][j]);
+                    else
+                        worker->readBootTree(trees[i][j]);
+                    trees[i][j] = worker->refineBootTree();
+                    scores[i][j] = worker->curScore;
+                }
+                worker->aln = NULL;
+                finish_random_stream(saved_stream);
+            }
+            delete bootstrap_aln;
+            deleteWorkerTree(worker);
+        }
+
+        saved_state.apply();
+
+        // merge in replicate order, as the serial version does
+        for (int i = 0; i < nbatch; i++) {
+            int sample = batch_begin + i;
+            if (!pure && (sample + 1) % 100 == 0)
+                cout << sample + 1 << " replicates done" << endl;
+            if (params->multiple_hits && !pure) {
+                IntegerSet result;
+                int best_boot_score = -INT_MAX;
+                for (int j = 0; j < trees[i].size(); j++) {
+                    int tree_index = addBootTree(trees[i][j], scores[i][j]);
+                    if (result.empty() || scores[i][j] == best_boot_score) {
+                        result.insert(tree_index);
+                        best_boot_score = scores[i][j];
+                    } else if (scores[i][j] > best_boot_score) {
+                        result.clear();
+                        result.insert(tree_index);
+                        best_boot_score = scores[i][j];
+                    }
+                }
+                boot_trees_parsimony[sample] = result;
+                boot_logl[sample] = best_boot_score;
+            } else if (find_best && !pure) {
+                int best_boot_score = -INT_MAX;
+                for (int j = 0; j < trees[i].size(); j++) {
+                    int tree_index = addBootTree(trees[i][j], scores[i][j]);
+                    if (scores[i][j] >= best_boot_score) {
+                        best_boot_score = scores[i][j];
+                        boot_logl[sample] = scores[i][j];
+                        boot_trees[sample] = tree_index;
+                    }
+                }
+            } else {
+                boot_trees[sample] = addBootTree(trees[i][0], scores[i][0]);
+                boot_logl[sample] = scores[i][0];
+                if (!pure) {
+                    cur_boot_sample = sample;
+                    if ((sample + 1) % 50 == 0) {
+                        saveUFBoot(checkpoint);
+                        checkpoint->dump();
+                    }
+                }
+            }
+        }
+        batch_begin = batch_end;
+    }
+#endif
+}
+
+string IQTree::doParsimonyStart(int seed, bool hill_climb)
+{
+    pllInst->randomNumberSeed = seed;
+    _pllComputeRandomizedStepwiseAdditionParsimonyTree(pllInst, pllPartitions, params->sprDist, this);
+    if (hill_climb) {
+        copyTopologyFromPLL();
+        initializeAllPartialPars();
+        clearAllPartialLH();
+        curScore = -computeParsimony();
+
+        // hill-climb as doNNISearch() does
+        copyTopologyToPLL();
+        if (params->tbr_pars) {
+            pllOptimizeTbrParsimony(pllInst, pllPartitions, params->tbr_mintrav,
+                params->tbr_maxtrav, this);
+        } else {
+            pllOptimizeSprParsimony(pllInst, pllPartitions, params->spr_mintrav,
+                params->spr_maxtrav, this);
+        }
+        _pllFreeParsimonyDataStructures(pllInst, pllPartitions);
+    }
+
+    pllTreeToNewick(pllInst->tree_string, pllInst, pllPartitions, pllInst->start->back,
+        params->print_branch_lengths, PLL_TRUE, PLL_FALSE, PLL_FALSE, PLL_FALSE,
+        PLL_SUMMARIZE_LH, PLL_FALSE, PLL_FALSE);
+    string tree = string(pllInst->tree_string);
+    copyTopologyFromPLL();
+    initializeAllPartialPars();
+    clearAllPartialLH();
+    curScore = -computeParsimony();
+    return tree;
+}
+
+void IQTree::runMultiStartSearches(int nstarts, int seed_no, StrVector& trees, DoubleVector& scores,
+        StrVector& topologies, bool hill_climb)
+{
+    trees.resize(nstarts);
+    scores.resize(nstarts);
+    topologies.resize(nstarts);
+
+    // the PLL search state is thread-local, the master thread gets its own back afterwards
+    PllSearchState saved_state;
+    saved_state.capture();
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+    {
+        Params worker_params = *params;
+#ifdef _OPENMP
+        worker_params.num_threads = 1;
+#endif
+        // the UFBoot candidate trees are only collected by the main search
+        worker_params.gbo_replicates = 0;
+        IQTree* worker = newWorkerTree(&worker_params, aln);
+        worker->doSegmenting();
+#ifdef _OPENMP
+#pragma omp critical(pll_setup)
+#endif
+        worker->initializePLL(worker_params);
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+        for (int i = 0; i < nstarts; i++) {
+            int* saved_stream = init_random_stream(i, nstarts, params->ran_seed);
+            trees[i] = worker->doParsimonyStart(params->ran_seed + (seed_no + i) * 12345, hill_climb);
+            scores[i] = worker->curScore;
+            topologies[i] = candidateTrees.getTopology(worker);
+            finish_random_stream(saved_stream);
+        }
+        deleteWorkerTree(worker);
+    }
+
+    saved_state.apply();
+}
+
 void IQTree::doNNIs(int nni2apply, bool changeBran)
 {
     for (int i = 0; i < nni2apply; i++) {
@@ -3710,48 +4014,43 @@ void IQTree::saveCurrentTree(double cur_logl)
      * Diep: Main old saveCurrentTree
      * -------------------------------------*/
     ostringstream ostr;
-    string tree_str;
-    StringIntMap::iterator it = treels.end();
+    string tree_code; // compact topology, see TreeStore::encodeTree()
+    int found_index = -1;
     if (params->store_candidate_trees) {
         if (params->spr_parsimony && !(params->ratchet_iter >= 0 && on_ratchet_hclimb1 && params->hclimb1_nni)) {
-            pllTreeToNewick(pllInst->tree_string, pllInst, pllPartitions,
-                pllInst->start->back, params->print_branch_lengths, PLL_TRUE, 0, 0, 0,
-                PLL_SUMMARIZE_LH, 0, 0);
-            string imd_tree = string(pllInst->tree_string);
-            readTreeString(imd_tree);
+            copyTopologyFromPLL();
         }
 
-        printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA);
-        tree_str = ostr.str();
-        it = treels.find(tree_str);
+        TreeStore::encodeTree(this, tree_code);
+        found_index = treels.findCode(tree_code);
     }
     int tree_index = -1;
-    if (it != treels.end()) { // already in treels
+    if (found_index >= 0) { // already in treels
         duplication_counter++;
-        tree_index = it->second;
-        if (cur_logl <= treels_logl[it->second] + 1e-4) {
-            if (cur_logl < treels_logl[it->second] - 5.0)
+        tree_index = found_index;
+        if (cur_logl <= treels_logl[found_index] + 1e-4) {
+            if (cur_logl < treels_logl[found_index] - 5.0)
                 if (verbose_mode >= VB_MED)
                     cout << "Current lh " << cur_logl
                          << " is much worse than expected "
-                         << treels_logl[it->second] << endl;
+                         << treels_logl[found_index] << endl;
             return;
         }
         if (verbose_mode >= VB_MAX)
-            cout << "Updated logl " << treels_logl[it->second] << " to "
+            cout << "Updated logl " << treels_logl[found_index] << " to "
                  << cur_logl << endl;
-        treels_logl[it->second] = cur_logl;
+        treels_logl[found_index] = cur_logl;
         if (save_all_br_lens) {
             ostr.seekp(ios::beg);
             printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA | WT_BR_LEN | WT_BR_SCALE | WT_BR_LEN_ROUNDING);
-            treels_newick[it->second] = ostr.str();
+            treels_newick[found_index] = ostr.str();
         }
         if ((!params->maximum_parsimony) && boot_samples.empty()) {
-            computePatternLikelihood(treels_ptnlh[it->second], &cur_logl);
+            computePatternLikelihood(treels_ptnlh[found_index], &cur_logl);
             return;
         }
         if (params->maximum_parsimony && boot_samples_pars.empty()) {
-            computePatternLikelihood(treels_ptnlh[it->second], &cur_logl);
+            computePatternLikelihood(treels_ptnlh[found_index], &cur_logl);
             return;
         }
         if (verbose_mode >= VB_MAX)
@@ -3763,7 +4062,7 @@ void IQTree::saveCurrentTree(double cur_logl)
             return;
         tree_index = treels_logl.size();
         if (params->store_candidate_trees)
-            treels[tree_str] = tree_index;
+            treels.insertCode(tree_code, tree_index);
         treels_logl.push_back(cur_logl);
         if (verbose_mode >= VB_MAX)
             cout << "Add    treels_logl[" << tree_index << "] := " << cur_logl
@@ -3833,6 +4132,10 @@ void IQTree::saveCurrentTree(double cur_logl)
         int nsamples = (params->maximum_parsimony) ? boot_samples_pars.size()
                                                    : boot_samples.size();
 
+        IntVector reps_score, reps_skipped;
+        if (params->maximum_parsimony && !params->auto_vectorize)
+            computeRepsScores(nptn, reps_score, reps_skipped);
+
         for (int sample = 0; sample < nsamples; sample++) {
             double rell = 0.0;
             bool skipped = false;
@@ -3846,46 +4149,9 @@ void IQTree::saveCurrentTree(double cur_logl)
                         res += _pattern_pars[ptn] * boot_sample[ptn];
                     rell = -(double)res;
                 } else {
-                    int ptn = 0, segment_id = 0, res = 0;
-                    VectorClassInt vc_rell = 0;
-                    int max_nptn = nptn / 2;
-                    for (; segment_id < reps_segments; segment_id++) {
-                        for (; ptn < segment_upper[segment_id];
-                             ptn += VCSIZE_INT) {
-                            if (params->do_first_rell && ptn >= max_nptn)
-                                break;
-                            vc_rell = VectorClassInt().load_a(
-                                          &_pattern_pars[ptn])
-                                    * VectorClassInt().load_a(
-                                        &boot_sample[ptn])
-                                + vc_rell;
-                        }
-                        res += horizontal_add(vc_rell);
-                        vc_rell = 0;
-
-                        if ((!skipped) && (reps_segments > 1) && (segment_id > reps_segments / 4) && (segment_id < reps_segments - 1)) {
-                            int reps_total = res + boot_samples_pars_remain_bounds[sample][segment_id];
-                            if ((double)(-reps_total) < boot_logl[sample] - params->ufboot_epsilon) {
-                                //								cout
-                                //<< "Current best of sample " << sample << " =
-                                //" << int(-boot_logl[sample]) << endl;
-                                // cout << "REPS at segment " << segment_id << "
-                                //= " << res +
-                                // boot_samples_pars_remain_bounds[sample][segment_id]
-                                //<< endl;
-                                // cout << "NOTE: estimated value for boot
-                                // sample
-                                // parsimony exceeds its current best."
-                                //										<<
-                                //"Skip on sample " << sample << " at site " <<
-                                // segment_upper[segment_id] << endl;
-                                skipped = true;
-                                break;
-                            }
-                        }
-                    }
-
-                    rell = -(double)res;
+                    // computed for all samples at once, see computeRepsScores()
+                    skipped = reps_skipped[sample];
+                    rell = -(double)reps_score[sample];
                 }
             } else {
                 // TODO: The following parallel is not very efficient, should
@@ -3944,23 +4210,17 @@ void IQTree::saveCurrentTree(double cur_logl)
             if (params->multiple_hits) {
                 // Implementing -mulhits option (without -top10boot) BEGIN
                 if (rell >= boot_logl[sample] && !params->store_top_boot_trees) {
-                    if (tree_str == "") {
+                    if (tree_code.empty()) {
                         if (params->spr_parsimony && !(params->ratchet_iter >= 0 && on_ratchet_hclimb1 && params->hclimb1_nni)) {
-                            pllTreeToNewick(pllInst->tree_string, pllInst,
-                                pllPartitions, pllInst->start->back,
-                                params->print_branch_lengths, PLL_TRUE, 0, 0, 0,
-                                PLL_SUMMARIZE_LH, 0, 0);
-                            string imd_tree = string(pllInst->tree_string);
-                            readTreeString(imd_tree);
+                            copyTopologyFromPLL();
                         }
-                        printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA);
-                        tree_str = ostr.str();
-                        it = treels.find(tree_str);
-                        if (it != treels.end()) {
-                            tree_index = it->second;
+                        TreeStore::encodeTree(this, tree_code);
+                        found_index = treels.findCode(tree_code);
+                        if (found_index >= 0) {
+                            tree_index = found_index;
                         } else {
                             tree_index = treels_logl.size() - 1; // old statement is wrong: treels.size();
-                            treels[tree_str] = tree_index;
+                            treels.insertCode(tree_code, tree_index);
                         }
                     }
 
@@ -3988,24 +4248,17 @@ void IQTree::saveCurrentTree(double cur_logl)
                 // Implementing -mulhits -topboot 10 option BEGIN
                 if (params->store_top_boot_trees) {
                     if (boot_trees_parsimony_top[sample].size() < params->store_top_boot_trees || rell > boot_threshold[sample]) {
-                        if (tree_str == "") {
+                        if (tree_code.empty()) {
                             if (params->spr_parsimony && !(params->ratchet_iter >= 0 && on_ratchet_hclimb1 && params->hclimb1_nni)) {
-                                pllTreeToNewick(pllInst->tree_string, pllInst,
-                                    pllPartitions,
-                                    pllInst->start->back, params->print_branch_lengths,
-                                    PLL_TRUE, 0, 0, 0,
-                                    PLL_SUMMARIZE_LH, 0, 0);
-                                string imd_tree = string(pllInst->tree_string);
-                                readTreeString(imd_tree);
+                                copyTopologyFromPLL();
                             }
-                            printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA);
-                            tree_str = ostr.str();
-                            it = treels.find(tree_str);
-                            if (it != treels.end()) {
-                                tree_index = it->second;
+                            TreeStore::encodeTree(this, tree_code);
+                            found_index = treels.findCode(tree_code);
+                            if (found_index >= 0) {
+                                tree_index = found_index;
                             } else {
                                 tree_index = treels_logl.size() - 1; // old statement is wrong: treels.size();
-                                treels[tree_str] = tree_index;
+                                treels.insertCode(tree_code, tree_index);
                             }
                         }
 
@@ -4063,24 +4316,18 @@ void IQTree::saveCurrentTree(double cur_logl)
                     if (rell > boot_logl[sample]) {
                         boot_counts[sample] = 1;
                     }
-                    if (tree_str == "") {
+                    if (tree_code.empty()) {
                         if (params->spr_parsimony && !(params->ratchet_iter >= 0 && on_ratchet_hclimb1 && params->hclimb1_nni)) {
-                            pllTreeToNewick(pllInst->tree_string, pllInst,
-                                pllPartitions, pllInst->start->back,
-                                params->print_branch_lengths, PLL_TRUE, 0, 0, 0,
-                                PLL_SUMMARIZE_LH, 0, 0);
-                            string imd_tree = string(pllInst->tree_string);
-                            readTreeString(imd_tree);
+                            copyTopologyFromPLL();
                         }
-                        printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA);
-                        tree_str = ostr.str();
+                        TreeStore::encodeTree(this, tree_code);
 
-                        it = treels.find(tree_str);
-                        if (it != treels.end()) {
-                            tree_index = it->second;
+                        found_index = treels.findCode(tree_code);
+                        if (found_index >= 0) {
+                            tree_index = found_index;
                         } else {
                             tree_index = treels_logl.size() - 1; // old statement is wrong: treels.size();
-                            treels[tree_str] = tree_index;
+                            treels.insertCode(tree_code, tree_index);
                         }
                     }
                     // Diep: for new logl_cutoff computation
@@ -4163,24 +4410,18 @@ void IQTree::saveCurrentTree(double cur_logl)
             // DEFAULT
             if ((params->distinct_iter_top_boot < 1) && (!params->multiple_hits)) {
                 if (rell > boot_logl[sample] + params->ufboot_epsilon || (rell > boot_logl[sample] - params->ufboot_epsilon && random_double() <= 1.0 / (boot_counts[sample] + 1))) {
-                    if (tree_str == "") {
+                    if (tree_code.empty()) {
                         if (params->spr_parsimony && !(params->ratchet_iter >= 0 && on_ratchet_hclimb1 && params->hclimb1_nni)) {
-                            pllTreeToNewick(pllInst->tree_string, pllInst,
-                                pllPartitions, pllInst->start->back,
-                                params->print_branch_lengths, PLL_TRUE, 0, 0, 0,
-                                PLL_SUMMARIZE_LH, 0, 0);
-                            string imd_tree = string(pllInst->tree_string);
-                            readTreeString(imd_tree);
+                            copyTopologyFromPLL();
                         }
-                        printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA);
-                        tree_str = ostr.str();
+                        TreeStore::encodeTree(this, tree_code);
 
-                        it = treels.find(tree_str);
-                        if (it != treels.end()) {
-                            tree_index = it->second;
+                        found_index = treels.findCode(tree_code);
+                        if (found_index >= 0) {
+                            tree_index = found_index;
                         } else {
                             tree_index = treels_logl.size() - 1; // old statement is wrong: treels.size();
-                            treels[tree_str] = tree_index;
+                            treels.insertCode(tree_code, tree_index);
                         }
                     }
 
@@ -4339,6 +4580,73 @@ void IQTree::pllComputeRellRemainBound(int nunit)
     delete[] min_unit_pars;
 }
 
+void IQTree::computeRepsScores(int nptn, IntVector &reps_score, IntVector &reps_skipped)
+{
+    int nsamples = boot_samples_pars.size();
+    int ntiles = (nsamples + REPS_TILE - 1) / REPS_TILE;
+    reps_score.resize(nsamples);
+    reps_skipped.resize(nsamples);
+
+    // patterns are summed by blocks of VCSIZE_INT as in the per-replicate version
+    int max_nptn = nptn / 2;
+    if (params->do_first_rell)
+        max_nptn = ((max_nptn + VCSIZE_INT - 1) / VCSIZE_INT) * VCSIZE_INT;
+    else
+        max_nptn = getAlnNPattern() + VCSIZE_INT; // size of each of boot_samples_pars
+
+    // each tile scores REPS_TILE replicates in one pass over _pattern_pars, segment by segment,
+    // a block of _pattern_pars being multiplied with the same block of all replicates of the tile
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int t = 0; t < ntiles; t++) {
+        int first = t * REPS_TILE;
+        int last = min(first + REPS_TILE, nsamples);
+        // the replicates of the tile not skipped yet
+        int active[REPS_TILE];
+        VectorClassInt vc_rell[REPS_TILE];
+        int i, j, segment_id, ptn = 0, nactive = last - first;
+
+        for (i = 0; i < nactive; i++) {
+            active[i] = first + i;
+            vc_rell[i] = 0;
+            reps_skipped[first + i] = 0;
+        }
+
+        for (segment_id = 0; segment_id < reps_segments; segment_id++) {
+            int upper = ((segment_upper[segment_id] + VCSIZE_INT - 1) / VCSIZE_INT) * VCSIZE_INT;
+            if (upper > max_nptn)
+                upper = max_nptn;
+            for (; ptn < upper; ptn += VCSIZE_INT) {
+                VectorClassInt vc_pars = VectorClassInt().load_a(&_pattern_pars[ptn]);
+                for (i = 0; i < nactive; i++)
+                    vc_rell[i] = vc_pars * VectorClassInt().load_a(&boot_samples_pars[active[i]][ptn]) + vc_rell[i];
+            }
+
+            if ((reps_segments > 1) && (segment_id > reps_segments / 4) && (segment_id < reps_segments - 1)) {
+                for (i = 0, j = 0; i < nactive; i++) {
+                    int sample = active[i];
+                    int reps_total = horizontal_add(vc_rell[i]) + boot_samples_pars_remain_bounds[sample][segment_id];
+                    if ((double)(-reps_total) < boot_logl[sample] - params->ufboot_epsilon) {
+                        // estimated value for boot sample parsimony exceeds its current best
+                        reps_skipped[sample] = 1;
+                        reps_score[sample] = reps_total;
+                        continue;
+                    }
+                    active[j] = sample;
+                    vc_rell[j++] = vc_rell[i];
+                }
+                nactive = j;
+                if (nactive == 0)
+                    break;
+            }
+        }
+
+        for (i = 0; i < nactive; i++)
+            reps_score[active[i]] = horizontal_add(vc_rell[i]);
+    }
+}
+
 void IQTree::saveNNITrees(PhyloNode* node, PhyloNode* dad)
 {
     if (!node) {
@@ -4380,12 +4688,7 @@ void IQTree::summarizeBootstrap(Params& params, MTreeSet& trees)
     SplitIntMap hash_ss;
     // make the taxa name
     vector<string> taxname;
-    taxname.resize(leafNum);
-    if (boot_splits.empty()) {
-        getTaxaName(taxname);
-    } else {
-        boot_splits.back()->getTaxaName(taxname);
-    }
+    getBootTaxaName(taxname);
     /*if (!tree.save_all_trees)
      trees.convertSplits(taxname, sg, hash_ss, SW_COUNT, -1);
      else
@@ -4393,7 +4696,22 @@ void IQTree::summarizeBootstrap(Params& params, MTreeSet& trees)
      */
     trees.convertSplits(taxname, sg, hash_ss, SW_COUNT, -1,
         false); // do not sort taxa
+    printBootstrapSupport(params, trees, taxname, sg, hash_ss, sum_weights);
+}
+
+void IQTree::getBootTaxaName(vector<string>& taxname)
+{
+    taxname.resize(leafNum);
+    if (boot_splits.empty()) {
+        getTaxaName(taxname);
+    } else {
+        boot_splits.back()->getTaxaName(taxname);
+    }
+}
 
+void IQTree::printBootstrapSupport(Params& params, MTreeSet& trees, vector<string>& taxname,
+    SplitGraph& sg, SplitIntMap& hash_ss, int sum_weights)
+{
     if (verbose_mode >= VB_MED)
         cout << sg.size() << " splits found" << endl;
 
@@ -4405,7 +4723,7 @@ void IQTree::summarizeBootstrap(Params& params, MTreeSet& trees)
                  << endl;
     }
 
-    sg.scaleWeight(1.0 / trees.sumTreeWeights(), false, 4);
+    sg.scaleWeight(1.0 / sum_weights, false, 4);
     string out_file;
     out_file = params.out_prefix;
     out_file += ".splits";
@@ -4529,14 +4847,15 @@ void IQTree::summarizeBootstrap(Params& params)
     if (verbose_mode >= VB_MED)
         cout << "Summarizing from " << treels.size() << " candidate trees..."
              << endl;
+    // the splits of the replicate trees are counted without building the trees
+    SplitGraph sg;
+    SplitIntMap hash_ss;
+    vector<string> taxname;
+    getBootTaxaName(taxname);
+    boot_split_counter.update(treels, boot_trees, taxname, rooted);
+    int sum_weights = boot_split_counter.convertSplits(treels, taxname, sg, hash_ss);
     MTreeSet trees;
-    IntVector tree_weights;
-    int sample;
-    tree_weights.resize(treels_logl.size(), 0);
-    for (sample = 0; sample < boot_trees.size(); sample++)
-        tree_weights[boot_trees[sample]]++;
-    trees.init(treels, rooted, tree_weights);
-    summarizeBootstrap(params, trees);
+    printBootstrapSupport(params, trees, taxname, sg, hash_ss, sum_weights);
 }
 
 /*
@@ -4654,12 +4973,6 @@ void IQTree::summarizeBootstrap(SplitGraph& sg)
         return;
     }
 
-    MTreeSet trees;
-    IntVector tree_weights;
-    tree_weights.resize(treels_logl.size(), 0);
-    for (int sample = 0; sample < boot_trees.size(); sample++)
-        tree_weights[boot_trees[sample]]++;
-    trees.init(treels, rooted, tree_weights);
     // SplitGraph sg;
     SplitIntMap hash_ss;
     // make the taxa name
@@ -4667,13 +4980,8 @@ void IQTree::summarizeBootstrap(SplitGraph& sg)
     taxname.resize(leafNum);
     getTaxaName(taxname);
 
-    /*if (!tree.save_all_trees)
-     trees.convertSplits(taxname, sg, hash_ss, SW_COUNT, -1);
-     else
-     trees.convertSplits(taxname, sg, hash_ss, SW_COUNT, -1, false);
-     */
-    trees.convertSplits(taxname, sg, hash_ss, SW_COUNT, -1,
-        false); // do not sort taxa
+    boot_split_counter.update(treels, boot_trees, taxname, rooted);
+    boot_split_counter.convertSplits(treels, taxname, sg, hash_ss);
 }
 
 /*
@@ -4782,6 +5090,7 @@ void IQTree::pllConvertUFBootData2IQTree()
 
     // treels
     treels.clear();
+    boot_split_counter.clear();
     if (pllUFBootDataPtr->candidate_trees_count > 0) {
         struct pllHashItem* hItem;
         struct pllHashTable* hTable = pllUFBootDataPtr->treels;
@@ -4789,7 +5098,7 @@ void IQTree::pllConvertUFBootData2IQTree()
             hItem = hTable->Items[i];
             while (hItem) {
                 string k(hItem->str);
-                treels[k] = *((int*)hItem->data);
+                treels.insert(k, *((int*)hItem->data));
                 hItem = hItem->next;
             }
         }
@@ -4831,6 +5140,22 @@ double computeCorrelation(IntVector& ix, IntVector& iy)
     return f1 / (sqrt(f2) * sqrt(f3));
 }
 
+double IQTree::updateBootstrapCorrelation()
+{
+    if (boot_splits.size() < 2)
+        return 0.0;
+    if (params->maximum_parsimony && params->multiple_hits)
+        return computeBootstrapCorrelation(); // boot_split_counter not used
+    vector<string> taxname;
+    taxname.resize(leafNum);
+    getTaxaName(taxname);
+    boot_split_counter.update(treels, boot_trees, taxname, rooted);
+    int half = (boot_splits.size() - 1) / 2;
+    if (boot_split_counter.getReferenceId() != half)
+        boot_split_counter.setReference(*boot_splits[half], half);
+    return boot_split_counter.getCorrelation();
+}
+
 double IQTree::computeBootstrapCorrelation()
 {
     if (boot_splits.size() < 2)
@@ -4972,21 +5297,21 @@ void IQTree::printIntermediateTree(int brtype)
     if (params->avoid_duplicated_trees) {
         // estimate logl_cutoff
         stringstream ostr;
-        printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA);
-        string tree_str = ostr.str();
-        StringIntMap::iterator it = treels.find(tree_str);
-        if (it != treels.end()) { // already in treels
+        string tree_code;
+        TreeStore::encodeTree(this, tree_code);
+        int tree_index = treels.findCode(tree_code);
+        if (tree_index >= 0) { // already in treels
             duplicated_tree = true;
-            if (curScore > treels_logl[it->second] + 1e-4) {
+            if (curScore > treels_logl[tree_index] + 1e-4) {
                 if (verbose_mode >= VB_MAX)
-                    cout << "Updated logl " << treels_logl[it->second] << " to "
+                    cout << "Updated logl " << treels_logl[tree_index] << " to "
                          << curScore << endl;
-                treels_logl[it->second] = curScore;
-                computeLikelihood(treels_ptnlh[it->second]);
+                treels_logl[tree_index] = curScore;
+                computeLikelihood(treels_ptnlh[tree_index]);
                 if (save_all_br_lens) {
                     ostr.seekp(ios::beg);
                     printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA | WT_BR_LEN | WT_BR_SCALE | WT_BR_LEN_ROUNDING);
-                    treels_newick[it->second] = ostr.str();
+                    treels_newick[tree_index] = ostr.str();
                 }
             }
             // pattern_lh = treels_ptnlh[treels[tree_str]];
@@ -4995,7 +5320,7 @@ void IQTree::printIntermediateTree(int brtype)
             if (logl_cutoff != 0.0 && curScore <= logl_cutoff + 1e-4)
                 duplicated_tree = true;
             else {
-                treels[tree_str] = treels_ptnlh.size();
+                treels.insertCode(tree_code, treels_ptnlh.size());
                 pattern_lh = new double[aln->getNPattern()];
                 computePatternLikelihood(pattern_lh, &logl);
                 treels_ptnlh.push_back(pattern_lh);
@@ -34,6 +34,8 @@
 #include "pllrepo/src/pll.h"
 #include "nnisearch.h"
 #include "candidateset.h"
+#include "treestore.h"
+#include "splitcounter.h"
 
 #define BOOT_VAL_FLOAT
 #define BootValType float
@@ -127,7 +129,22 @@ public:
      */
     virtual void setParams(Params& params);
 
-    void createPLLPartition(Params &params, ostream &pllPartitionFileHandle);
+    /**
+     * print the PLL partition scheme
+     * @param nsite number of sites of the PLL alignment, used without partitions
+     */
+    void createPLLPartition(Params &params, ostream &pllPartitionFileHandle, int nsite);
+
+    /** @return true if createPLLAlignment() supports aln */
+    bool canCreatePLLAlignment();
+
+    /**
+     * build the PLL alignment from the patterns of aln without printing it:
+     * the same as pllParsePHYLIPString() on aln->printPhylip() followed by
+     * pllSortedAlignmentRemoveDups(), i.e. the sites in order of aln where
+     * a run of equal sites is one site weighted by its length
+     */
+    pllAlignmentData *createPLLAlignment();
 
     void initializePLL(Params &params);
 
@@ -325,9 +342,26 @@ public:
      *
      * 		@param nniCount (OUT) number of NNIs applied
      * 		@param nniSteps (OUT) number of NNI steps done
-     * 		@return the new NEWICK string
+     * 		@param print_tree FALSE to skip printing the tree after SPR/TBR for parsimony
+     * 		@return the new NEWICK string, empty if not printed
      */
-    string doNNISearch(int &nniCount, int &nniSteps);
+    string doNNISearch(int &nniCount, int &nniSteps, bool print_tree = true);
+
+    /**
+     *      copy the topology of the current tree into pllInst without going through a NEWICK string.
+     *      The PLL nodes are linked as pllTreeInitTopologyNewick() links them for the printed tree,
+     *      so the PLL search afterwards is the same. Falls back to the NEWICK string for
+     *      trees the direct copy does not handle (rooted, multifurcating, taxa not matching pllInst)
+     */
+    void copyTopologyToPLL();
+
+    /**
+     *      replace the current tree by the topology of pllInst without going through a NEWICK string.
+     *      The nodes and their ids are created as readTreeString() creates them for the PLL NEWICK
+     *      string, the partial parsimony vectors are not allocated.
+     *      Falls back to the NEWICK string for rooted trees, super trees and -bl
+     */
+    void copyTopologyFromPLL();
 
     /**
             @brief evaluate all NNIs and store them in possilbleNNIMoves list
@@ -591,6 +625,81 @@ public:
     */
    void optimizeBootTreesPure();
 
+   /**
+    * refine the bootstrap trees of replicates sample_begin ... sample_end-1 for
+    * optimizeBootTrees() or optimizeBootTreesPure() with params->num_threads threads.
+    * Each thread refines on its own tree and PLL instance with a random stream per replicate,
+    * the results are merged in replicate order, so they do not depend on the number of threads
+    * @param start_tree the current tree, used to set up the thread's trees
+    */
+   void refineBootTreesParallel(int sample_begin, int sample_end, const string &start_tree);
+
+   /**
+    * @return a new tree on worker_aln for a thread of a parallel region,
+    * with a copy of the cost matrix, to be deleted with deleteWorkerTree() in iqtree.cpp
+    * @param worker_params parameters of the new tree
+    * @param worker_aln alignment of the new tree
+    */
+   IQTree *newWorkerTree(Params *worker_params, Alignment *worker_aln);
+
+   /**
+    * @return a new tree for refineBootTreesParallel(), with parsimony vectors
+    * allocated for saved_aln_on_opt_btree
+    * @param worker_params parameters of the new tree
+    * @param start_tree tree to start with
+    */
+   IQTree *newBootTreeWorker(Params *worker_params, const string &start_tree);
+
+   /**
+    * run nstarts independent parsimony searches, in parallel with -omp.
+    * Each thread searches on its own tree and PLL instance, each search with its own
+    * random stream, so the trees do not depend on the number of threads
+    * @param seed_no number of the first search, the PLL seed of search i is
+    * ran_seed + (seed_no + i) * 12345 as in initCandidateTreeSet()
+    * @param trees (OUT) the resulting trees in search order
+    * @param scores (OUT) their scores (negative parsimony scores)
+    * @param topologies (OUT) their CandidateSet::getTopology(), computed by the threads
+    * @param hill_climb false to return the stepwise addition trees themselves
+    */
+   void runMultiStartSearches(int nstarts, int seed_no, StrVector &trees, DoubleVector &scores,
+           StrVector &topologies, bool hill_climb = true);
+
+   /**
+    * build a random stepwise addition tree with the PLL instance and hill-climb it
+    * by SPR or TBR, set curScore
+    * @param seed PLL random seed of the stepwise addition
+    * @param hill_climb false to skip the hill-climbing
+    * @return the resulting tree
+    */
+   string doParsimonyStart(int seed, bool hill_climb = true);
+
+   /**
+    * build the PLL instance used to refine the bootstrap trees from saved_aln_on_opt_btree
+    * if there is none yet. The bootstrap alignments keep all its patterns (see
+    * Alignment::setPatternFreq()), so each search only reweights the PLL patterns.
+    */
+   void initializeBootTreePLL();
+
+   /**
+    * read a bootstrap tree printed with WT_TAXON_ID,
+    * taxa are named after saved_aln_on_opt_btree
+    * @param tree the tree string
+    */
+   void readBootTree(const string &tree);
+
+   /**
+    * hill-climb the current tree on the current (bootstrap) alignment, set curScore
+    * @return the refined tree printed with WT_TAXON_ID | WT_SORT_TAXA
+    */
+   string refineBootTree();
+
+   /**
+    * @param tree a tree printed with WT_TAXON_ID | WT_SORT_TAXA
+    * @param score its score, stored in treels_logl if the tree is new
+    * @return index of the tree in treels
+    */
+   int addBootTree(const string &tree, double score);
+
    /**
     * Diep:
     * Sankoff cost matrix, to be inherited and used in ParsTree
@@ -601,6 +710,25 @@ public:
     StrVector removedTaxons;
 protected:
 
+    /**
+     * @return true if tip k of pllInst is taxon k-1 of the alignment for all k
+     */
+    bool pllTaxaMatchAlignment();
+
+    /**
+     * link the subtree below node to the PLL node pointer slot, see copyTopologyToPLL()
+     * @param inner (IN/OUT) next free inner PLL node
+     */
+    void linkPLLSubtree(Node *node, Node *dad, nodeptr slot, int &inner);
+
+    /**
+     * create the subtree printed by pllTreeToNewick() at p, see copyTopologyFromPLL()
+     * @param top true for pllInst->start->back, the top of the printed tree
+     * @param first_leaf (IN/OUT) first leaf created
+     * @return the new node for p
+     */
+    Node *newSubtreeFromPLL(nodeptr p, bool top, Node *&first_leaf);
+
     /**
      *  Current IQPNNI iteration number
      */
@@ -718,7 +846,7 @@ public:
         this keeps the list of intermediate trees.
         it will be activated if params.avoid_duplicated_trees is TRUE.
      */
-    StringIntMap treels;
+    TreeStore treels;
 
     /** pattern log-likelihood vector for each treels */
     vector<double* > treels_ptnlh;
@@ -753,6 +881,14 @@ public:
 
     void pllComputeRellRemainBound(int nunit);
 
+    /**
+     * compute REPS of all bootstrap replicates in one pass over _pattern_pars
+     * @param nptn number of patterns to take into account
+     * @param reps_score (OUT) the REPS of each replicate
+     * @param reps_skipped (OUT) 1 if the replicate cannot improve boot_logl (segment early exit)
+     */
+    void computeRepsScores(int nptn, IntVector &reps_score, IntVector &reps_skipped);
+
     void initTopologyByPLLRandomAdition(Params &params); // Diep: this is for reorder columns in aln (UFBoot-MP)
     BootValTypePars * getPatternPars();
 
@@ -778,6 +914,7 @@ public:
 	bool on_ratchet_hclimb1; // is on the 1st hill-climbing in a ratchet iteration (i.e. on perturbed aln)
 	bool on_ratchet_hclimb2; // is on the 2nd hill-climbing in a ratchet iteration (i.e. on original aln)
 	Alignment * saved_aln_on_ratchet_iter;
+	Alignment * ratchet_aln; // perturbed alignment, reweighted in each ratchet iteration
 	Alignment * saved_aln_on_opt_btree;
 	BootValTypePars * original_sample;
 	bool on_opt_btree;
@@ -794,9 +931,27 @@ public:
     /** Corresponding map for set of splits occuring in bootstrap trees */
     //SplitIntMap boot_splits_map;
 
+    /** split frequencies of the trees in boot_trees, see summarizeBootstrap() */
+    SplitCounter boot_split_counter;
+
     /** summarize all bootstrap trees */
     void summarizeBootstrap(Params &params, MTreeSet &trees);
 
+    /**
+     * assign the bootstrap supports of sg to the current tree and print the split files
+     * @param trees the bootstrap trees, only used to report the trees disagreeing with
+     *        a split labelled INFO, may be empty
+     * @param taxname taxon names ordered by ID
+     * @param sg splits weighted by their number of bootstrap trees
+     * @param hash_ss split -> number of bootstrap trees
+     * @param sum_weights number of bootstrap trees
+     */
+    void printBootstrapSupport(Params &params, MTreeSet &trees, vector<string> &taxname,
+        SplitGraph &sg, SplitIntMap &hash_ss, int sum_weights);
+
+    /** @param taxname (OUT) taxon names ordered by ID, of boot_splits if any */
+    void getBootTaxaName(vector<string> &taxname);
+
     void summarizeBootstrap(Params &params);
 	void summarizeBootstrapParsimony(Params &params);
 	void summarizeBootstrapParsimonyWeight(Params &params);
@@ -813,6 +968,13 @@ public:
     /** @return bootstrap correlation coefficient for assessing convergence */
     double computeBootstrapCorrelation();
 
+    /**
+     * computeBootstrapCorrelation() between the half step summary of boot_splits and
+     * the current bootstrap trees, without comparing the two split systems:
+     * boot_split_counter keeps the sums up to date as the bootstrap trees change
+     */
+    double updateBootstrapCorrelation();
+
 	int getDelete() const;
 	void setDelete(int _delete);
 
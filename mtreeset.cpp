@@ -134,6 +134,27 @@ void MTreeSet::init(StringIntMap &treels, bool &is_rooted, IntVector &weights) {
 	//tree_weights.resize(size(), 1);
 }
 
+void MTreeSet::init(TreeStore &treels, bool &is_rooted, IntVector &weights) {
+	int count = 0;
+	for (int i = 0; i < treels.size(); i++) {
+		int id = treels.getIdAt(i);
+		if (!weights[id]) continue;
+		count++;
+		MTree *tree = newTree();
+		stringstream ss(treels.getTreeAt(i));
+		bool myrooted = is_rooted;
+		tree->readTree(ss, myrooted);
+		NodeVector taxa;
+		tree->getTaxa(taxa);
+		for (NodeVector::iterator taxit = taxa.begin(); taxit != taxa.end(); taxit++)
+			(*taxit)->id = atoi((*taxit)->name.c_str());
+		push_back(tree);
+		tree_weights.push_back(weights[id]);
+	}
+	if (verbose_mode >= VB_MED)
+		cout << count << " tree(s) converted" << endl;
+}
+
 void MTreeSet::readTrees(const char *infile, bool &is_rooted, int burnin, int max_count,
 	IntVector *weights, bool compressed) 
 {
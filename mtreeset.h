@@ -23,6 +23,7 @@
 #include "mtree.h"
 #include "splitgraph.h"
 #include "alignment.h"
+#include "treestore.h"
 
 void readIntVector(const char *file_name, int burnin, int max_count, IntVector &vec);
 
@@ -58,6 +59,14 @@ public:
 
 	void init(StringIntMap &treels, bool &is_rooted, IntVector &weights);
 
+	/**
+		initialize the trees with non-zero weight from a tree store, in insertion order
+		@param treels trees with taxon IDs as names
+		@param is_rooted (IN/OUT) true if tree is rooted
+		@param weights weight of each tree index
+	*/
+	void init(TreeStore &treels, bool &is_rooted, IntVector &weights);
+
 
 	/**
 		read the tree from the input file in newick format
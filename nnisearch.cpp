@@ -21,7 +21,7 @@ extern VerboseMode verbose_mode;
 int NNI_MAX_NR_STEP = 10;
 
 /* program options */
-extern Params *globalParam;
+extern THREAD_LOCAL Params *globalParam;
 extern Alignment *globalAlignment;
 
 /**
@@ -0,0 +1,53 @@
+/*
+ * parsimonykernel.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "parsimonykernel.h"
+#include "vectorclass/instrset.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
+/* cpuid with sub-leaf, instrset_detect() only reads sub-leaf 0 of the basic leaves */
+static void cpuidCount(int output[4], int leaf, int subleaf) {
+#if defined(_MSC_VER)
+    __cpuidex(output, leaf, subleaf);
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    unsigned int a, b, c, d;
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+    output[0] = a;
+    output[1] = b;
+    output[2] = c;
+    output[3] = d;
+#else
+    output[0] = output[1] = output[2] = output[3] = 0;
+#endif
+}
+
+static const ParsimonyKernel *detectParsimonyKernel() {
+    int iset = instrset_detect();
+    if (iset >= 9) {
+        // AVX512F and ZMM state enabled by the OS
+        int abcd[4];
+        cpuidCount(abcd, 7, 0);
+        bool has_avx512bw = (abcd[1] & (1 << 30)) != 0;
+        bool has_vpopcntdq = (abcd[2] & (1 << 14)) != 0;
+        if (has_avx512bw && has_vpopcntdq && getParsimonyKernelAVX512Popcnt())
+            return getParsimonyKernelAVX512Popcnt();
+        if (has_avx512bw && getParsimonyKernelAVX512())
+            return getParsimonyKernelAVX512();
+    }
+    if (iset >= 8 && getParsimonyKernelAVX2())
+        return getParsimonyKernelAVX2();
+    return NULL;
+}
+
+const ParsimonyKernel *getParsimonyKernel() {
+    static const ParsimonyKernel *kernel = detectParsimonyKernel();
+    return kernel;
+}
@@ -0,0 +1,59 @@
+/*
+ * parsimonykernel.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef PARSIMONYKERNEL_H_
+#define PARSIMONYKERNEL_H_
+
+#include <stddef.h>
+
+/*
+ * Fitch kernels working on the bit-sliced parsimony vectors of PLL
+ * (see compressDNA() in sprparsimony.cpp): a vector stores for each of the
+ * 'states' character states 'width' consecutive 32-bit words, bit j of
+ * word w being set if pattern 32*w+j may take this state.
+ *
+ * The kernels are compiled in separate translation units with their own
+ * instruction set flags (parsimonykernelavx2.cpp, parsimonykernelavx512.cpp)
+ * and picked at run time from CPUID, so that a single binary uses the
+ * widest integer SIMD the host supports. These units therefore must NOT
+ * include headers with inline functions shared with the rest of the program.
+ */
+
+/**
+ * cur = Fitch(left, right)
+ * @return number of patterns where left and right have no state in common
+ */
+typedef unsigned int (*ParsNewviewKernel)(const unsigned int *left, const unsigned int *right,
+        unsigned int *cur, size_t states, size_t width);
+
+/**
+ * @param bound the counting may stop once more than bound patterns are counted,
+ * UINT_MAX for the exact number
+ * @return number of patterns where left and right have no state in common,
+ * or a number larger than bound but possibly smaller than this number
+ */
+typedef unsigned int (*ParsEvaluateKernel)(const unsigned int *left, const unsigned int *right,
+        size_t states, size_t width, unsigned int bound);
+
+struct ParsimonyKernel {
+    /** instruction set name, for printing */
+    const char *name;
+    ParsNewviewKernel newview;
+    ParsEvaluateKernel evaluate;
+};
+
+/**
+ * @return the best Fitch kernel supported by the CPU, or NULL if the CPU
+ * has no AVX2 and the kernels compiled into sprparsimony.cpp should be used
+ */
+const ParsimonyKernel *getParsimonyKernel();
+
+/** kernels of the single instruction sets, NULL if not compiled in */
+const ParsimonyKernel *getParsimonyKernelAVX2();
+const ParsimonyKernel *getParsimonyKernelAVX512();
+const ParsimonyKernel *getParsimonyKernelAVX512Popcnt();
+
+#endif /* PARSIMONYKERNEL_H_ */
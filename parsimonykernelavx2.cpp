@@ -0,0 +1,140 @@
+/*
+ * parsimonykernelavx2.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *
+ * Fitch kernels using 256-bit integer AVX2 instructions.
+ * This file is compiled with -mavx2, see CMakeLists.txt.
+ */
+
+#include "parsimonykernel.h"
+
+#ifdef __AVX2__
+
+#include <immintrin.h>
+
+namespace {
+
+/* per 64-bit lane popcount of v using the nibble lookup table (vpshufb) */
+inline __m256i popcountAVX2(__m256i v) {
+    const __m256i lookup = _mm256_setr_epi8(
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_and_si256(v, low_mask);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+    __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+    return _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+}
+
+inline unsigned int horizontalSum(__m256i v) {
+    __m128i s = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    s = _mm_add_epi64(s, _mm_unpackhi_epi64(s, s));
+    return (unsigned int)_mm_cvtsi128_si64(s);
+}
+
+/* STATES == 0: number of states only known at run time */
+template <int STATES>
+unsigned int fitchNewviewAVX2(const unsigned int *left, const unsigned int *right,
+        unsigned int *cur, size_t nstates, size_t width) {
+    const size_t states = STATES ? STATES : nstates;
+    __m256i l_A[STATES ? STATES : 32], v_A[STATES ? STATES : 32];
+    __m256i counts = _mm256_setzero_si256();
+    size_t i, k;
+
+    for (i = 0; i + 8 <= width; i += 8) {
+        __m256i v_N = _mm256_setzero_si256();
+        for (k = 0; k < states; k++) {
+            __m256i s_l = _mm256_loadu_si256((const __m256i*)(left + width * k + i));
+            __m256i s_r = _mm256_loadu_si256((const __m256i*)(right + width * k + i));
+            l_A[k] = _mm256_and_si256(s_l, s_r);
+            v_A[k] = _mm256_or_si256(s_l, s_r);
+            v_N = _mm256_or_si256(v_N, l_A[k]);
+        }
+        for (k = 0; k < states; k++)
+            _mm256_storeu_si256((__m256i*)(cur + width * k + i),
+                    _mm256_or_si256(l_A[k], _mm256_andnot_si256(v_N, v_A[k])));
+        counts = _mm256_add_epi64(counts, popcountAVX2(v_N));
+    }
+
+    // the vectors are padded to a multiple of 8 words only for AVX builds
+    unsigned int score = (unsigned int)(i * 32) - horizontalSum(counts);
+    for (; i < width; i++) {
+        unsigned int t_N = 0;
+        for (k = 0; k < states; k++)
+            t_N |= left[width * k + i] & right[width * k + i];
+        for (k = 0; k < states; k++)
+            cur[width * k + i] = (left[width * k + i] & right[width * k + i]) |
+                (~t_N & (left[width * k + i] | right[width * k + i]));
+        score += (unsigned int)__builtin_popcount(~t_N);
+    }
+    return score;
+}
+
+template <int STATES>
+unsigned int fitchEvaluateAVX2(const unsigned int *left, const unsigned int *right,
+        size_t nstates, size_t width, unsigned int bound) {
+    const size_t states = STATES ? STATES : nstates;
+    __m256i counts = _mm256_setzero_si256();
+    size_t i, k;
+
+    for (i = 0; i + 8 <= width; i += 8) {
+        __m256i v_N = _mm256_setzero_si256();
+        for (k = 0; k < states; k++)
+            v_N = _mm256_or_si256(v_N, _mm256_and_si256(
+                    _mm256_loadu_si256((const __m256i*)(left + width * k + i)),
+                    _mm256_loadu_si256((const __m256i*)(right + width * k + i))));
+        counts = _mm256_add_epi64(counts, popcountAVX2(v_N));
+        // every 32 words, stop once the patterns counted so far exceed the bound
+        if ((i & 24) == 24) {
+            unsigned int score = (unsigned int)((i + 8) * 32) - horizontalSum(counts);
+            if (score > bound)
+                return score;
+        }
+    }
+
+    unsigned int score = (unsigned int)(i * 32) - horizontalSum(counts);
+    for (; i < width; i++) {
+        unsigned int t_N = 0;
+        for (k = 0; k < states; k++)
+            t_N |= left[width * k + i] & right[width * k + i];
+        score += (unsigned int)__builtin_popcount(~t_N);
+    }
+    return score;
+}
+
+unsigned int newviewAVX2(const unsigned int *left, const unsigned int *right,
+        unsigned int *cur, size_t states, size_t width) {
+    switch (states) {
+    case 2: return fitchNewviewAVX2<2>(left, right, cur, states, width);
+    case 4: return fitchNewviewAVX2<4>(left, right, cur, states, width);
+    case 20: return fitchNewviewAVX2<20>(left, right, cur, states, width);
+    default: return fitchNewviewAVX2<0>(left, right, cur, states, width);
+    }
+}
+
+unsigned int evaluateAVX2(const unsigned int *left, const unsigned int *right,
+        size_t states, size_t width, unsigned int bound) {
+    switch (states) {
+    case 2: return fitchEvaluateAVX2<2>(left, right, states, width, bound);
+    case 4: return fitchEvaluateAVX2<4>(left, right, states, width, bound);
+    case 20: return fitchEvaluateAVX2<20>(left, right, states, width, bound);
+    default: return fitchEvaluateAVX2<0>(left, right, states, width, bound);
+    }
+}
+
+const ParsimonyKernel kernelAVX2 = {"AVX2", newviewAVX2, evaluateAVX2};
+
+}
+
+const ParsimonyKernel *getParsimonyKernelAVX2() {
+    return &kernelAVX2;
+}
+
+#else
+
+const ParsimonyKernel *getParsimonyKernelAVX2() {
+    return NULL;
+}
+
+#endif
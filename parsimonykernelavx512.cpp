@@ -0,0 +1,45 @@
+/*
+ * parsimonykernelavx512.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *
+ * AVX-512 Fitch kernels for CPUs with AVX512BW but without AVX512_VPOPCNTDQ.
+ * This file is compiled with -mavx512f -mavx512bw, see CMakeLists.txt.
+ */
+
+#include "parsimonykernel.h"
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+
+#include "parsimonykernelavx512.h"
+
+namespace {
+
+/* per 64-bit lane popcount using the nibble lookup table (vpshufb) */
+struct PopcountShuffle {
+    static inline __m512i count(__m512i v) {
+        const __m512i lookup = _mm512_set4_epi32(0x04030302, 0x03020201, 0x03020201, 0x02010100);
+        const __m512i low_mask = _mm512_set1_epi8(0x0f);
+        __m512i lo = _mm512_and_si512(v, low_mask);
+        __m512i hi = _mm512_and_si512(_mm512_srli_epi16(v, 4), low_mask);
+        __m512i cnt = _mm512_add_epi8(_mm512_shuffle_epi8(lookup, lo), _mm512_shuffle_epi8(lookup, hi));
+        return _mm512_sad_epu8(cnt, _mm512_setzero_si512());
+    }
+};
+
+const ParsimonyKernel kernelAVX512 = {"AVX512",
+        newviewAVX512<PopcountShuffle>, evaluateAVX512<PopcountShuffle>};
+
+}
+
+const ParsimonyKernel *getParsimonyKernelAVX512() {
+    return &kernelAVX512;
+}
+
+#else
+
+const ParsimonyKernel *getParsimonyKernelAVX512() {
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * parsimonykernelavx512.h
+ *
+ *  Created on: Oct 17, 2026
+ *
+ * Fitch kernels using 512-bit integer AVX-512 instructions, shared by
+ * parsimonykernelavx512.cpp (AVX512BW popcount via vpshufb) and
+ * parsimonykernelavx512popcnt.cpp (AVX512_VPOPCNTDQ vpopcntq).
+ * Only include this from translation units compiled with AVX-512 flags.
+ */
+
+#ifndef PARSIMONYKERNELAVX512_H_
+#define PARSIMONYKERNELAVX512_H_
+
+#include "parsimonykernel.h"
+#include <immintrin.h>
+
+namespace {
+
+/* STATES == 0: number of states only known at run time */
+template <class Popcount, int STATES>
+unsigned int fitchNewviewAVX512(const unsigned int *left, const unsigned int *right,
+        unsigned int *cur, size_t nstates, size_t width) {
+    const size_t states = STATES ? STATES : nstates;
+    __m512i l_A[STATES ? STATES : 32], v_A[STATES ? STATES : 32];
+    __m512i counts = _mm512_setzero_si512();
+    size_t i, k;
+
+    for (i = 0; i + 16 <= width; i += 16) {
+        __m512i v_N = _mm512_setzero_si512();
+        for (k = 0; k < states; k++) {
+            __m512i s_l = _mm512_loadu_si512((const void*)(left + width * k + i));
+            __m512i s_r = _mm512_loadu_si512((const void*)(right + width * k + i));
+            l_A[k] = _mm512_and_si512(s_l, s_r);
+            v_A[k] = _mm512_or_si512(s_l, s_r);
+            v_N = _mm512_or_si512(v_N, l_A[k]);
+        }
+        for (k = 0; k < states; k++)
+            _mm512_storeu_si512((void*)(cur + width * k + i),
+                    _mm512_or_si512(l_A[k], _mm512_andnot_si512(v_N, v_A[k])));
+        counts = _mm512_add_epi64(counts, Popcount::count(v_N));
+    }
+
+    // the vectors are padded to a multiple of 4 or 8 words only
+    unsigned int score = (unsigned int)(i * 32) - (unsigned int)_mm512_reduce_add_epi64(counts);
+    for (; i < width; i++) {
+        unsigned int t_N = 0;
+        for (k = 0; k < states; k++)
+            t_N |= left[width * k + i] & right[width * k + i];
+        for (k = 0; k < states; k++)
+            cur[width * k + i] = (left[width * k + i] & right[width * k + i]) |
+                (~t_N & (left[width * k + i] | right[width * k + i]));
+        score += (unsigned int)__builtin_popcount(~t_N);
+    }
+    return score;
+}
+
+template <class Popcount, int STATES>
+unsigned int fitchEvaluateAVX512(const unsigned int *left, const unsigned int *right,
+        size_t nstates, size_t width, unsigned int bound) {
+    const size_t states = STATES ? STATES : nstates;
+    __m512i counts = _mm512_setzero_si512();
+    size_t i, k;
+
+    for (i = 0; i + 16 <= width; i += 16) {
+        __m512i v_N = _mm512_setzero_si512();
+        for (k = 0; k < states; k++)
+            v_N = _mm512_or_si512(v_N, _mm512_and_si512(
+                    _mm512_loadu_si512((const void*)(left + width * k + i)),
+                    _mm512_loadu_si512((const void*)(right + width * k + i))));
+        counts = _mm512_add_epi64(counts, Popcount::count(v_N));
+        // every 32 words, stop once the patterns counted so far exceed the bound
+        if ((i & 16) == 16) {
+            unsigned int score = (unsigned int)((i + 16) * 32) - (unsigned int)_mm512_reduce_add_epi64(counts);
+            if (score > bound)
+                return score;
+        }
+    }
+
+    unsigned int score = (unsigned int)(i * 32) - (unsigned int)_mm512_reduce_add_epi64(counts);
+    for (; i < width; i++) {
+        unsigned int t_N = 0;
+        for (k = 0; k < states; k++)
+            t_N |= left[width * k + i] & right[width * k + i];
+        score += (unsigned int)__builtin_popcount(~t_N);
+    }
+    return score;
+}
+
+template <class Popcount>
+unsigned int newviewAVX512(const unsigned int *left, const unsigned int *right,
+        unsigned int *cur, size_t states, size_t width) {
+    switch (states) {
+    case 2: return fitchNewviewAVX512<Popcount, 2>(left, right, cur, states, width);
+    case 4: return fitchNewviewAVX512<Popcount, 4>(left, right, cur, states, width);
+    case 20: return fitchNewviewAVX512<Popcount, 20>(left, right, cur, states, width);
+    default: return fitchNewviewAVX512<Popcount, 0>(left, right, cur, states, width);
+    }
+}
+
+template <class Popcount>
+unsigned int evaluateAVX512(const unsigned int *left, const unsigned int *right,
+        size_t states, size_t width, unsigned int bound) {
+    switch (states) {
+    case 2: return fitchEvaluateAVX512<Popcount, 2>(left, right, states, width, bound);
+    case 4: return fitchEvaluateAVX512<Popcount, 4>(left, right, states, width, bound);
+    case 20: return fitchEvaluateAVX512<Popcount, 20>(left, right, states, width, bound);
+    default: return fitchEvaluateAVX512<Popcount, 0>(left, right, states, width, bound);
+    }
+}
+
+}
+
+#endif /* PARSIMONYKERNELAVX512_H_ */
@@ -0,0 +1,40 @@
+/*
+ * parsimonykernelavx512popcnt.cpp
+ *
+ *  Created on: Oct 17, 2026
+ *
+ * AVX-512 Fitch kernels counting bits with vpopcntq (AVX512_VPOPCNTDQ).
+ * This file is compiled with -mavx512f -mavx512bw -mavx512vpopcntdq,
+ * see CMakeLists.txt.
+ */
+
+#include "parsimonykernel.h"
+
+#if defined(__AVX512F__) && defined(__AVX512BW__) && defined(__AVX512VPOPCNTDQ__)
+
+#include "parsimonykernelavx512.h"
+
+namespace {
+
+struct PopcountVpopcntq {
+    static inline __m512i count(__m512i v) {
+        return _mm512_popcnt_epi64(v);
+    }
+};
+
+const ParsimonyKernel kernelAVX512Popcnt = {"AVX512-VPOPCNTDQ",
+        newviewAVX512<PopcountVpopcntq>, evaluateAVX512<PopcountVpopcntq>};
+
+}
+
+const ParsimonyKernel *getParsimonyKernelAVX512Popcnt() {
+    return &kernelAVX512Popcnt;
+}
+
+#else
+
+const ParsimonyKernel *getParsimonyKernelAVX512Popcnt() {
+    return NULL;
+}
+
+#endif
@@ -8,13 +8,24 @@
 #include <cstring>
 #include "parstree.h"
 #include "tools.h"
+#include "vectorclass/vectorclass.h"
+
+#ifdef __AVX
+#define VectorClassUInt Vec8ui
+#else
+#define VectorClassUInt Vec4ui
+#endif
 
 ParsTree::ParsTree(): IQTree(){
     cost_matrix = NULL;
+    var_ptn_stride = 0;
+    var_ptn_aln = NULL;
 }
 
 ParsTree::ParsTree(Alignment *alignment): IQTree(alignment){
     cost_matrix = NULL;
+    var_ptn_stride = 0;
+    var_ptn_aln = NULL;
 }
 
 ParsTree::~ParsTree() {
@@ -119,6 +130,85 @@ int ParsTree::computeParsimony(){
 //    return (child_cost + transition_cost);
 //}
 
+/*
+    Sankoff kernels on blocks of VectorClass::size() patterns.
+    Memory of one partial_pars vector, assuming VectorClass::size()=4 and 4 states (A,C,G,T):
+
+    Index  0  1  2  3  4  5  6  7  8 ...
+    Site   0  1  2  3  0  1  2  3  0 ...
+    State  A  A  A  A  C  C  C  C  G ...
+
+    NSTATES = 0 means the number of states is only known at run time.
+*/
+
+// cur = min_j(left_j + cost_ij) + min_j(right_j + cost_ij)
+template <class VectorClass, int NSTATES>
+static void computeSankoffBifurcatingSIMD(UINT *left, UINT *right, UINT *cur,
+		UINT *cost_matrix, size_t nblocks, int nstates) {
+	const int states = NSTATES ? NSTATES : nstates;
+	const size_t block_size = VectorClass::size() * states;
+	for (size_t b = 0; b < nblocks; b++) {
+		UINT *left_ptr = left + b * block_size;
+		UINT *right_ptr = right + b * block_size;
+		UINT *cur_ptr = cur + b * block_size;
+		UINT *cost_matrix_ptr = cost_matrix;
+		for (int i = 0; i < states; i++) {
+			// min(j->i) from child_branch
+			VectorClass left_contrib = VectorClass().load(left_ptr) + cost_matrix_ptr[0];
+			VectorClass right_contrib = VectorClass().load(right_ptr) + cost_matrix_ptr[0];
+			for (int j = 1; j < states; j++) {
+				left_contrib = min(left_contrib, VectorClass().load(left_ptr + j * VectorClass::size()) + cost_matrix_ptr[j]);
+				right_contrib = min(right_contrib, VectorClass().load(right_ptr + j * VectorClass::size()) + cost_matrix_ptr[j]);
+			}
+			(left_contrib + right_contrib).store(cur_ptr + i * VectorClass::size());
+			cost_matrix_ptr += states;
+		}
+	}
+}
+
+// cur += min_j(child_j + cost_ij), for multifurcating nodes
+template <class VectorClass, int NSTATES>
+static void addSankoffChildSIMD(UINT *child, UINT *cur,
+		UINT *cost_matrix, size_t nblocks, int nstates) {
+	const int states = NSTATES ? NSTATES : nstates;
+	const size_t block_size = VectorClass::size() * states;
+	for (size_t b = 0; b < nblocks; b++) {
+		UINT *child_ptr = child + b * block_size;
+		UINT *cur_ptr = cur + b * block_size;
+		UINT *cost_matrix_ptr = cost_matrix;
+		for (int i = 0; i < states; i++) {
+			VectorClass contrib = VectorClass().load(child_ptr) + cost_matrix_ptr[0];
+			for (int j = 1; j < states; j++)
+				contrib = min(contrib, VectorClass().load(child_ptr + j * VectorClass::size()) + cost_matrix_ptr[j]);
+			(VectorClass().load(cur_ptr + i * VectorClass::size()) + contrib).store(cur_ptr + i * VectorClass::size());
+			cost_matrix_ptr += states;
+		}
+	}
+}
+
+// ptn_pars[ptn] = min_i(dad_i + min_j(node_j + cost_ij)), one entry per pattern of the blocks
+template <class VectorClass, int NSTATES>
+static void computeSankoffBranchSIMD(UINT *node_pars, UINT *dad_pars, UINT *ptn_pars,
+		UINT *cost_matrix, size_t nblocks, int nstates) {
+	const int states = NSTATES ? NSTATES : nstates;
+	const size_t block_size = VectorClass::size() * states;
+	for (size_t b = 0; b < nblocks; b++) {
+		UINT *node_ptr = node_pars + b * block_size;
+		UINT *dad_ptr = dad_pars + b * block_size;
+		UINT *cost_matrix_ptr = cost_matrix;
+		VectorClass min_ptn_pars = UINT_MAX;
+		for (int i = 0; i < states; i++) {
+			// min(j->i) from node_branch
+			VectorClass min_score = VectorClass().load(node_ptr) + cost_matrix_ptr[0];
+			for (int j = 1; j < states; j++)
+				min_score = min(min_score, VectorClass().load(node_ptr + j * VectorClass::size()) + cost_matrix_ptr[j]);
+			min_ptn_pars = min(min_ptn_pars, min_score + VectorClass().load(dad_ptr + i * VectorClass::size()));
+			cost_matrix_ptr += states;
+		}
+		min_ptn_pars.store(ptn_pars + b * VectorClass::size());
+	}
+}
+
 /**
 compute partial parsimony score of the subtree rooted at dad
 @param dad_branch the branch leading to the subtree
@@ -131,7 +221,6 @@ void ParsTree::computePartialParsimony(PhyloNeighbor *dad_branch, PhyloNode *dad
 
     Node *node = dad_branch->node;
     //assert(node->degree() <= 3);
-    int ptn;
     if(aln->num_states != cost_nstates){
         cout << "Your cost matrix is not compatible with the alignment"
             << " in terms of number of states. Please check!" << endl;
@@ -141,42 +230,44 @@ void ParsTree::computePartialParsimony(PhyloNeighbor *dad_branch, PhyloNode *dad
     assert(dad_branch->partial_pars);
 
     int pars_block_size = getParsBlockSize();
+    size_t nblocks = var_ptn_stride / VCSIZE_INT;
 
     if (node->isLeaf() && dad) {
 //        cout << "############# leaf!" << endl;
         // external node
-        for(int i = 0; i < pars_block_size - 1; i++)
-            dad_branch->partial_pars[i] = UINT_MAX / 3;
-        dad_branch->partial_pars[pars_block_size - 1] = 0; // reserved for corresponding subtree pars
-        for (ptn = 0; ptn < aln->size(); ptn++){
-            // ignore const ptn because it does not affect pars score
-            if (!aln->at(ptn).is_const) {
-                int ptn_start_index = ptn * nstates;
-                char state;
-                if (node->name == ROOT_NAME) {
-                    state = aln->STATE_UNKNOWN;
-                } else {
-                    assert(node->id < aln->getNSeq());
-                    state = (aln->at(ptn))[node->id];
-                }
+        // padding patterns of the last block stay 0 and are never summed up
+        memset(dad_branch->partial_pars, 0, sizeof(UINT) * pars_block_size);
+        UINT *site_partial_pars = new UINT[nstates];
+        // constant patterns are not stored because they do not affect pars score
+        for (size_t i = 0; i < var_ptns.size(); i++) {
+            int ptn = var_ptns[i];
+            char state;
+            if (node->name == ROOT_NAME) {
+                state = aln->STATE_UNKNOWN;
+            } else {
+                assert(node->id < aln->getNSeq());
+                state = (aln->at(ptn))[node->id];
+            }
 
-                if (state < nstates) {
-                    dad_branch->partial_pars[ptn_start_index + state] = 0;
-                } else {
-                    // unknown, ambiguous character
-//                    cout << "####### ambigous state = " << int(state) << endl;
-                    initLeafSiteParsForAmbiguousState(state, dad_branch->partial_pars + ptn_start_index);
-                }
+            for (int s = 0; s < nstates; s++)
+                site_partial_pars[s] = UINT_MAX / 3;
+            if (state < nstates) {
+                site_partial_pars[state] = 0;
+            } else {
+                // unknown, ambiguous character
+//                cout << "####### ambigous state = " << int(state) << endl;
+                initLeafSiteParsForAmbiguousState(state, site_partial_pars);
             }
+            UINT *ptn_ptr = dad_branch->partial_pars + (i / VCSIZE_INT) * VCSIZE_INT * nstates + (i % VCSIZE_INT);
+            for (int s = 0; s < nstates; s++)
+                ptn_ptr[s * VCSIZE_INT] = site_partial_pars[s];
         }
+        delete [] site_partial_pars;
+        dad_branch->partial_pars[pars_block_size - 1] = 0; // reserved for corresponding subtree pars
     } else {
 //        cout << "############# internal!" << endl;
         // internal node
-        UINT i, j, ptn, min_child_ptn_pars;
-
         UINT * partial_pars = dad_branch->partial_pars;
-        for(int i = 0; i < pars_block_size; i++)
-            partial_pars[i] = 0;
         UINT *left = NULL, *right = NULL;
 
         FOR_NEIGHBOR_IT(node, dad, it)if ((*it)->node->name != ROOT_NAME) {
@@ -187,29 +278,20 @@ void ParsTree::computePartialParsimony(PhyloNeighbor *dad_branch, PhyloNode *dad
                 right = ((PhyloNeighbor*)*it)->partial_pars;
         }
 
-
         if (node->degree() > 3) {
+            memset(partial_pars, 0, sizeof(UINT) * pars_block_size);
             FOR_NEIGHBOR_IT(node, dad, it) if ((*it)->node->name != ROOT_NAME) {
                 UINT *partial_pars_child = ((PhyloNeighbor*) (*it))->partial_pars;
-                for (ptn = 0; ptn < aln->size(); ptn++){
-                    // ignore const ptn because it does not affect pars score
-                    if (aln->at(ptn).is_const) continue;
-                    int ptn_start_index = ptn*nstates;
-
-                    UINT *partial_pars_child_ptr = &partial_pars_child[ptn_start_index];
-                    UINT *partial_pars_ptr = &partial_pars[ptn_start_index];
-                    UINT *cost_matrix_ptr = cost_matrix;
-
-                    for(i = 0; i < nstates; i++){
-                        // min(j->i) from child_branch
-                        min_child_ptn_pars = partial_pars_child_ptr[0] + cost_matrix_ptr[0];
-                        for(j = 1; j < nstates; j++) {
-                            UINT value = partial_pars_child_ptr[j] + cost_matrix_ptr[j];
-                            min_child_ptn_pars = min(value, min_child_ptn_pars);
-                        }
-                        partial_pars_ptr[i] += min_child_ptn_pars;
-                        cost_matrix_ptr += nstates;
-                    }
+                switch (nstates) {
+                case 4:
+                    addSankoffChildSIMD<VectorClassUInt, 4>(partial_pars_child, partial_pars, cost_matrix, nblocks, nstates);
+                    break;
+                case 20:
+                    addSankoffChildSIMD<VectorClassUInt, 20>(partial_pars_child, partial_pars, cost_matrix, nblocks, nstates);
+                    break;
+                default:
+                    addSankoffChildSIMD<VectorClassUInt, 0>(partial_pars_child, partial_pars, cost_matrix, nblocks, nstates);
+                    break;
                 }
             }
         } else {
@@ -218,104 +300,17 @@ void ParsTree::computePartialParsimony(PhyloNeighbor *dad_branch, PhyloNode *dad
 
             switch (nstates) {
             case 4:
-                for (ptn = 0; ptn < aln->size(); ptn++){
-                    // ignore const ptn because it does not affect pars score
-                    if (aln->at(ptn).is_const) continue;
-                    int ptn_start_index = ptn*4;
-
-                    UINT *left_ptr = &left[ptn_start_index];
-                    UINT *right_ptr = &right[ptn_start_index];
-                    UINT *partial_pars_ptr = &partial_pars[ptn_start_index];
-                    UINT *cost_matrix_ptr = cost_matrix;
-                    UINT left_contrib, right_contrib;
-
-                    for(i = 0; i < 4; i++){
-                        // min(j->i) from child_branch
-                        left_contrib = left_ptr[0] + cost_matrix_ptr[0];
-                        right_contrib = right_ptr[0] + cost_matrix_ptr[0];
-                        for(j = 1; j < 4; j++) {
-                            UINT value = left_ptr[j] + cost_matrix_ptr[j];
-                            left_contrib = min(value, left_contrib);
-                            value = right_ptr[j] + cost_matrix_ptr[j];
-                            right_contrib = min(value, right_contrib);
-                        }
-                        partial_pars_ptr[i] = left_contrib+right_contrib;
-                        cost_matrix_ptr += 4;
-                    }
-                }
+                computeSankoffBifurcatingSIMD<VectorClassUInt, 4>(left, right, partial_pars, cost_matrix, nblocks, nstates);
                 break;
             case 20:
-                for (ptn = 0; ptn < aln->size(); ptn++){
-                    // ignore const ptn because it does not affect pars score
-                    if (aln->at(ptn).is_const) continue;
-                    int ptn_start_index = ptn*20;
-
-                    UINT *left_ptr = &left[ptn_start_index];
-                    UINT *right_ptr = &right[ptn_start_index];
-                    UINT *partial_pars_ptr = &partial_pars[ptn_start_index];
-                    UINT *cost_matrix_ptr = cost_matrix;
-                    UINT left_contrib, right_contrib;
-
-                    for(i = 0; i < 20; i++){
-                        // min(j->i) from child_branch
-                        left_contrib = left_ptr[0] + cost_matrix_ptr[0];
-                        right_contrib = right_ptr[0] + cost_matrix_ptr[0];
-                        for(j = 1; j < 20; j++) {
-                            UINT value = left_ptr[j] + cost_matrix_ptr[j];
-                            left_contrib = min(value, left_contrib);
-                            value = right_ptr[j] + cost_matrix_ptr[j];
-                            right_contrib = min(value, right_contrib);
-                        }
-                        partial_pars_ptr[i] = left_contrib+right_contrib;
-                        cost_matrix_ptr += 20;
-                    }
-                }
+                computeSankoffBifurcatingSIMD<VectorClassUInt, 20>(left, right, partial_pars, cost_matrix, nblocks, nstates);
                 break;
             default:
-                for (ptn = 0; ptn < aln->size(); ptn++){
-                    // ignore const ptn because it does not affect pars score
-                    if (aln->at(ptn).is_const) continue;
-                    int ptn_start_index = ptn*nstates;
-
-                    UINT *left_ptr = &left[ptn_start_index];
-                    UINT *right_ptr = &right[ptn_start_index];
-                    UINT *partial_pars_ptr = &partial_pars[ptn_start_index];
-                    UINT *cost_matrix_ptr = cost_matrix;
-                    UINT left_contrib, right_contrib;
-
-                    for(i = 0; i < nstates; i++){
-                        // min(j->i) from child_branch
-                        left_contrib = left_ptr[0] + cost_matrix_ptr[0];
-                        right_contrib = right_ptr[0] + cost_matrix_ptr[0];
-                        for(j = 1; j < nstates; j++) {
-                            UINT value = left_ptr[j] + cost_matrix_ptr[j];
-                            left_contrib = min(value, left_contrib);
-                            value = right_ptr[j] + cost_matrix_ptr[j];
-                            right_contrib = min(value, right_contrib);
-                        }
-                        partial_pars_ptr[i] = left_contrib+right_contrib;
-                        cost_matrix_ptr += nstates;
-                    }
-                }
+                computeSankoffBifurcatingSIMD<VectorClassUInt, 0>(left, right, partial_pars, cost_matrix, nblocks, nstates);
                 break;
             }
-
-        }
-        /*
-
-        // calc subtree pars
-        for (ptn = 0; ptn < aln->size(); ptn++){
-            // ignore const ptn because it does not affect pars score
-            if (aln->at(ptn).is_const) continue;
-            int ptn_start_index = ptn * nstates;
-            UINT min_ptn_pars = partial_pars[ptn_start_index];
-            for(i = 1; i < nstates; i++){
-                if(partial_pars[ptn_start_index + i] < min_ptn_pars)
-                    min_ptn_pars = partial_pars[ptn_start_index + i];
-            }
-            partial_pars[pars_block_size - 1] += min_ptn_pars * aln->at(ptn).frequency;
+            partial_pars[pars_block_size - 1] = 0;
         }
-        */
     }
 
     dad_branch->partial_lh_computed |= 2;
@@ -441,6 +436,12 @@ int ParsTree::computeParsimonyBranch(PhyloNeighbor *dad_branch, PhyloNode *dad,
     PhyloNeighbor *node_branch = (PhyloNeighbor*) node->findNeighbor(dad);
     assert(node_branch);
 
+    if (var_ptn_aln != aln && central_partial_pars) {
+        // the vectors were laid out for the variant patterns of another alignment
+        delete [] central_partial_pars;
+        central_partial_pars = NULL;
+        clearAllPartialLH();
+    }
     if (!central_partial_pars)
         initializeAllPartialPars();
 
@@ -458,6 +459,7 @@ int ParsTree::computeParsimonyBranch(PhyloNeighbor *dad_branch, PhyloNode *dad,
 
     int nptn = aln->size();
     if(!_pattern_pars) _pattern_pars = aligned_alloc<BootValTypePars>(nptn+VCSIZE_INT);
+    // constant patterns have score 0
     memset(_pattern_pars, 0, sizeof(BootValTypePars) * (nptn+VCSIZE_INT));
 
     if ((dad_branch->partial_lh_computed & 2) == 0)
@@ -468,79 +470,46 @@ int ParsTree::computeParsimonyBranch(PhyloNeighbor *dad_branch, PhyloNode *dad,
     // now combine likelihood at the branch
     tree_pars = 0;
     int nstates = aln->num_states;
-    UINT i, j, ptn;
+    size_t nblocks = var_ptn_stride / VCSIZE_INT;
 
-    UINT *ptn_partial_pars = new UINT[nstates];
-    if(!ptn_partial_pars){
-        outError("Could not allocate for ptn_partial_pars\n");
+    UINT *ptn_pars = aligned_alloc<UINT>(var_ptn_stride + VCSIZE_INT);
+    if(!ptn_pars){
+        outError("Could not allocate for ptn_pars\n");
         exit(1);
     }
 
     switch (nstates) {
     case 4:
-        for (ptn = 0; ptn < aln->size(); ptn++){
-            _pattern_pars[ptn] = 0;
-            if (aln->at(ptn).is_const) continue;
-            
-            int ptn_start_index = ptn * 4;
-            UINT *node_branch_ptr = &node_branch->partial_pars[ptn_start_index];
-            UINT *dad_branch_ptr = &dad_branch->partial_pars[ptn_start_index];
-            UINT *cost_matrix_ptr = cost_matrix;
-            UINT min_ptn_pars = UINT_MAX;
-            for(i = 0; i < 4; i++){
-                // min(j->i) from node_branch
-                UINT min_score = node_branch_ptr[0] + cost_matrix_ptr[0];
-                for(j = 1; j < 4; j++) {
-                    UINT value = node_branch_ptr[j] + cost_matrix_ptr[j];
-                    min_score = min(value, min_score);
-
-                }
-                ptn_partial_pars[i] = min_score + dad_branch_ptr[i];
-                min_ptn_pars = min(min_ptn_pars, ptn_partial_pars[i]);
-                cost_matrix_ptr += 4;
-            }
-            _pattern_pars[ptn] = min_ptn_pars;
-            tree_pars += min_ptn_pars * aln->at(ptn).frequency;
-        }
+        computeSankoffBranchSIMD<VectorClassUInt, 4>(node_branch->partial_pars, dad_branch->partial_pars, ptn_pars, cost_matrix, nblocks, nstates);
+        break;
+    case 20:
+        computeSankoffBranchSIMD<VectorClassUInt, 20>(node_branch->partial_pars, dad_branch->partial_pars, ptn_pars, cost_matrix, nblocks, nstates);
         break;
-
     default:
-        for (ptn = 0; ptn < aln->size(); ptn++){
-            _pattern_pars[ptn] = 0;
-            if (aln->at(ptn).is_const) continue;
-            
-            int ptn_start_index = ptn * nstates;
-            UINT *node_branch_ptr = &node_branch->partial_pars[ptn_start_index];
-            UINT *dad_branch_ptr = &dad_branch->partial_pars[ptn_start_index];
-            UINT *cost_matrix_ptr = cost_matrix;
-            UINT min_ptn_pars = UINT_MAX;
-            for(i = 0; i < nstates; i++){
-                // min(j->i) from node_branch
-                UINT min_score = node_branch_ptr[0] + cost_matrix_ptr[0];
-                for(j = 1; j < nstates; j++) {
-                    UINT value = node_branch_ptr[j] + cost_matrix_ptr[j];
-                    min_score = min(value, min_score);
-
-                }
-                ptn_partial_pars[i] = min_score + dad_branch_ptr[i];
-                min_ptn_pars = min(min_ptn_pars, ptn_partial_pars[i]);
-                cost_matrix_ptr += nstates;
-            }
-            _pattern_pars[ptn] = min_ptn_pars;
-            tree_pars += min_ptn_pars * aln->at(ptn).frequency;
-        }
+        computeSankoffBranchSIMD<VectorClassUInt, 0>(node_branch->partial_pars, dad_branch->partial_pars, ptn_pars, cost_matrix, nblocks, nstates);
         break;
     }
+
+    for (size_t i = 0; i < var_ptns.size(); i++) {
+        int ptn = var_ptns[i];
+        _pattern_pars[ptn] = ptn_pars[i];
+        tree_pars += ptn_pars[i] * aln->at(ptn).frequency;
+    }
+    aligned_free(ptn_pars);
+
     if (branch_subst)
         *branch_subst = tree_pars;
-    if(ptn_partial_pars){
-        delete [] ptn_partial_pars;
-        ptn_partial_pars = NULL;
-    }
     return tree_pars;
 }
 
 void ParsTree::initializeAllPartialPars() {
+	// patterns might have been reordered or reweighted in place
+	size_t old_stride = var_ptn_stride;
+	initVariantPatterns();
+	if (central_partial_pars && var_ptn_stride != old_stride) {
+		delete [] central_partial_pars;
+		central_partial_pars = NULL;
+	}
 	PhyloTree::initializeAllPartialPars();
 //    if(params->maximum_parsimony && (!_pattern_pars))
 //    	_pattern_pars = new UINT[aln->size()];
@@ -549,9 +518,19 @@ void ParsTree::initializeAllPartialPars() {
 }
 
 size_t ParsTree::getParsBlockSize(){
+    if (var_ptn_aln != aln)
+        initVariantPatterns();
     // the extra one is reserved for subtree pars score
-    // TODO minus const ptn
-    return aln->size() * aln->num_states + 1;
+    return var_ptn_stride * aln->num_states + 1;
+}
+
+void ParsTree::initVariantPatterns() {
+    var_ptns.clear();
+    for (int ptn = 0; ptn < aln->size(); ptn++)
+        if (!aln->at(ptn).is_const)
+            var_ptns.push_back(ptn);
+    var_ptn_stride = ((var_ptns.size() + VCSIZE_INT - 1) / VCSIZE_INT) * VCSIZE_INT;
+    var_ptn_aln = aln;
 }
 
 UINT* ParsTree::newBitsBlock(){
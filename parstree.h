@@ -89,6 +89,13 @@ public:
      */
     size_t getParsBlockSize();
 
+    /**
+     * collect the non-constant patterns of the alignment into var_ptns.
+     * partial_pars only store these patterns, VCSIZE_INT patterns per block,
+     * the scores of one state of the block being contiguous
+     */
+    void initVariantPatterns();
+
 	/**
 	 * to overwrite the one in PhyloTree
 	 */
@@ -119,6 +126,10 @@ public:
 //    int * cost_matrix; // Sep 2016: store cost matrix in 1D array
 //    int cost_nstates; // Sep 2016: # of states provided by cost matrix
     UINT tree_pars;
+
+    vector<int> var_ptns; // non-constant patterns of aln
+    size_t var_ptn_stride; // var_ptns.size() rounded up to a multiple of VCSIZE_INT
+    Alignment *var_ptn_aln; // alignment that var_ptns was collected from
 };
 
 #endif /* PARSTREE_H_ */
@@ -66,6 +66,7 @@
 //#include <unistd.h>
 #include <stdlib.h>
 #include "sprparsimony.h"
+#include "parsimonykernel.h"
 #include "vectorclass/vectorclass.h"
 
 #ifdef _OPENMP
@@ -2189,8 +2190,9 @@ int main(int argc, char *argv[])
     Checkpoint *checkpoint = new Checkpoint;
     checkpoint->setIgnore(params.ignore_checkpoint);
 
-    string filename = (string)params.out_prefix +".ckp.gz";
+    string filename = (string)params.out_prefix + (params.ckp_binary ? ".ckp.bin" : ".ckp.gz");
     checkpoint->setFileName(filename);
+    checkpoint->setBinary(params.ckp_binary);
     
     bool append_log = false;
     
@@ -2327,6 +2329,8 @@ int main(int argc, char *argv[])
 			break;
 		}
 	}
+	if (getParsimonyKernel())
+		cout << ", Fitch " << getParsimonyKernel()->name;
 
 
 
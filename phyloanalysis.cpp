@@ -1025,7 +1025,10 @@ void printAnalysisInfo(int model_df, IQTree& iqtree, Params& params) {
 	    if (params.stop_condition == SC_REAL_TIME) {
 	        cout << "after " << params.maxtime << " minutes" << endl;
 	    } else if (params.stop_condition == SC_UNSUCCESS_ITERATION) {
-	        cout << "after " << params.unsuccess_iteration << " unsuccessful iterations" << endl;
+	        cout << "after " << params.unsuccess_iteration << " unsuccessful iterations";
+	        if (params.boot_correlation_stop)
+	        	cout << " or min " << params.min_correlation << " correlation coefficient";
+	        cout << endl;
 	    } else if (params.stop_condition == SC_FIXED_ITERATION) {
 	            cout << params.min_iterations << " iterations" << endl;
 	    } else if(params.stop_condition == SC_WEIBULL) {
@@ -1267,7 +1270,27 @@ int initCandidateTreeSet(Params &params, IQTree &iqtree, int numInitTrees) {
     double startTime = getCPUTime();
     int numDupPars = 0;
 //    if(params.maximum_parsimony) iqtree.candidateTrees.clear(); // Diep: added this to fix the bug of sorted aln <> orig aln
-    for (int treeNr = 1; treeNr < numInitTrees; treeNr++) {
+    int treeNr = 1;
+    if (numInitTrees > 1 && params.maximum_parsimony && params.start_tree == STT_PLL_PARSIMONY &&
+            !iqtree.isSuperTree() && !params.count_trees) {
+        // the stepwise additions with the PLL seeds of the loop below, each one on its own
+        // random stream instead of the main one, merged in tree order, so that the trees
+        // are the same with any number of threads
+        StrVector parsTrees, parsTopologies;
+        DoubleVector parsScores;
+        iqtree.runMultiStartSearches(numInitTrees - 1, 1, parsTrees, parsScores, parsTopologies, false);
+        for (int i = 0; i < parsTrees.size(); i++) {
+            if (iqtree.candidateTrees.treeTopologyExist(parsTopologies[i])) {
+                numDupPars++;
+                continue;
+            }
+            iqtree.candidateTrees.updateTopology(parsTrees[i], parsScores[i], parsTopologies[i]);
+            if (parsScores[i] > iqtree.bestScore)
+                iqtree.setBestTree(parsTrees[i], parsScores[i]);
+        }
+        treeNr = numInitTrees;
+    }
+    for (; treeNr < numInitTrees; treeNr++) {
         string curParsTree;
         if (params.start_tree == STT_PLL_PARSIMONY) {
 			iqtree.pllInst->randomNumberSeed = params.ran_seed + treeNr * 12345;
@@ -1286,7 +1309,9 @@ int initCandidateTreeSet(Params &params, IQTree &iqtree, int numInitTrees) {
             iqtree.computeParsimonyTree(NULL, iqtree.aln);
             curParsTree = iqtree.getTreeString();
         }
-        if (iqtree.candidateTrees.treeExist(curParsTree)) {
+        bool dupTree = (params.start_tree == STT_PLL_PARSIMONY) ? iqtree.candidateTrees.treeExist(curParsTree)
+                : iqtree.candidateTrees.treeExist(&iqtree);
+        if (dupTree) {
             numDupPars++;
             continue;
         } else {
@@ -1307,12 +1332,32 @@ int initCandidateTreeSet(Params &params, IQTree &iqtree, int numInitTrees) {
         		iqtree.initializeAllPartialPars();
         		iqtree.clearAllPartialLH();
         		iqtree.curScore = -iqtree.computeParsimony();
-        		iqtree.candidateTrees.update(curParsTree, iqtree.curScore);
+        		iqtree.candidateTrees.update(curParsTree, iqtree.curScore, &iqtree);
                 if (iqtree.curScore > iqtree.bestScore) {
                     iqtree.setBestTree(curParsTree, iqtree.curScore);
                 }
             }else
-            	iqtree.candidateTrees.update(curParsTree, -DBL_MAX);
+            	iqtree.candidateTrees.update(curParsTree, -DBL_MAX, &iqtree);
+        }
+    }
+    if (params.maximum_parsimony && params.numMultiStarts > 0 &&
+            params.start_tree == STT_PLL_PARSIMONY && !iqtree.isSuperTree()) {
+        cout << "(" << numDupPars << " duplicated parsimony trees)" << endl;
+        cout << "Running " << params.numMultiStarts << " independent parsimony searches... ";
+        cout.flush();
+        numDupPars = 0;
+        StrVector startTrees, startTopologies;
+        DoubleVector startScores;
+        iqtree.runMultiStartSearches(params.numMultiStarts, numInitTrees, startTrees, startScores, startTopologies);
+        // merge in search order, so that the candidate set does not depend on the threads
+        for (int i = 0; i < startTrees.size(); i++) {
+            if (iqtree.candidateTrees.treeTopologyExist(startTopologies[i])) {
+                numDupPars++;
+                continue;
+            }
+            iqtree.candidateTrees.updateTopology(startTrees[i], startScores[i], startTopologies[i]);
+            if (startScores[i] > iqtree.bestScore)
+                iqtree.setBestTree(startTrees[i], startScores[i]);
         }
     }
     double parsTime = getCPUTime() - startTime;
@@ -1345,7 +1390,7 @@ int initCandidateTreeSet(Params &params, IQTree &iqtree, int numInitTrees) {
         // Optimize the branch lengths
         string tree = iqtree.optimizeBranches(2);
         // Add tree to the candidate set
-		iqtree.candidateTrees.update(tree, iqtree.curScore);
+		iqtree.candidateTrees.update(tree, iqtree.curScore, &iqtree);
         if (iqtree.curScore > iqtree.bestScore) {
             iqtree.setBestTree(tree, iqtree.curScore);
         }
@@ -1357,7 +1402,7 @@ int initCandidateTreeSet(Params &params, IQTree &iqtree, int numInitTrees) {
     iqtree.candidateTrees.clear();
     if (verbose_mode >= VB_MED) {
         for (multimap<double, CandidateTree>::iterator it = iqtree.candidateTrees.begin(); it != iqtree.candidateTrees.end(); it++) {
-        	cout << it->first << " / " << it->second.topology << endl;
+        	cout << it->first << " / " << TreeStore::decodeTree(it->second.topology) << endl;
         }
     }
 
@@ -1397,7 +1442,7 @@ int initCandidateTreeSet(Params &params, IQTree &iqtree, int numInitTrees) {
         }
         cout << " / Time: " << convert_time(getRealTime() - params.start_real_time) << endl;
 
-        bool newTree = iqtree.candidateTrees.update(tree, iqtree.curScore);
+        bool newTree = iqtree.candidateTrees.update(tree, iqtree.curScore, &iqtree);
         if (!newTree) {
         	numDup++;
         }
@@ -1685,6 +1730,10 @@ void runTreeReconstruction(Params &params, string &original_model, IQTree &iqtre
         /* Initialized all data structure for PLL*/
 //        cout << "WHAT'S GOING ON HERE?" << endl;
 //        verbose_mode = VB_MAX;
+        // the PLL parsers use globals, see runStandardBootstrapParallel()
+#ifdef _OPENMP
+#pragma omp critical(pll_setup)
+#endif
     	iqtree.initializePLL(params);
     }
 
@@ -1799,7 +1848,7 @@ void runTreeReconstruction(Params &params, string &original_model, IQTree &iqtre
 //        	if (iqtree.isSuperTree())
 //        		((PhyloSuperTree*) &iqtree)->computeBranchLengths();
             iqtree.setBestTree(tree, iqtree.curScore);
-        	iqtree.candidateTrees.update(tree, iqtree.curScore);
+        	iqtree.candidateTrees.update(tree, iqtree.curScore, &iqtree);
 
         }
 
@@ -1951,6 +2000,200 @@ void runTreeReconstruction(Params &params, string &original_model, IQTree &iqtre
 /**********************************************************
  * STANDARD NON-PARAMETRIC BOOTSTRAP
  ***********************************************************/
+
+/**
+ * reconstruct the tree of one bootstrap alignment as the main analysis does
+ * @param bootstrap_alignment deleted together with the bootstrap tree
+ * @param tree tree of the original alignment, for the partition models
+ * @return the bootstrap tree, read back from params.out_prefix + ".treefile"
+ */
+static string runBootstrapReplicate(Params &params, string &original_model, Alignment *bootstrap_alignment, IQTree *tree) {
+	IQTree *boot_tree;
+	if (bootstrap_alignment->isSuperAlignment()){
+		if(params.partition_type){
+			boot_tree = new PhyloSuperTreePlen((SuperAlignment*) bootstrap_alignment, (PhyloSuperTree*) tree);
+		} else {
+			boot_tree = new PhyloSuperTree((SuperAlignment*) bootstrap_alignment, (PhyloSuperTree*) tree);
+		}
+	} else
+		boot_tree = new IQTree(bootstrap_alignment);
+	// a fresh search, nothing to restore and nothing dumped (no file name)
+	Checkpoint boot_checkpoint;
+	boot_tree->setCheckpoint(&boot_checkpoint);
+
+	if(params.maximum_parsimony){
+		optimizeAlignment(boot_tree, params);// Diep: this is to rearrange columns for better speed in REPS
+	}
+
+	// the main Maximum likelihood tree reconstruction
+	vector<ModelInfo> model_info;
+	bootstrap_alignment->checkGappySeq();
+
+	StrVector removed_seqs;
+	StrVector twin_seqs;
+	// remove identical sequences
+	if (params.ignore_identical_seqs){
+		boot_tree->removeIdenticalSeqs(params, removed_seqs, twin_seqs);
+		boot_tree->removedTaxons = removed_seqs;
+	}
+
+	runTreeReconstruction(params, original_model, *boot_tree, model_info);
+
+	// reinsert identical sequences
+	if (removed_seqs.size() > 0) {
+		boot_tree->insertTaxa(removed_seqs, twin_seqs);
+		boot_tree->printResultTree();
+	}
+
+	// read in the output tree file
+	string treefile_name = params.out_prefix;
+	treefile_name += ".treefile";
+	string tree_str;
+	try {
+		ifstream tree_in;
+		tree_in.exceptions(ios::failbit | ios::badbit);
+		tree_in.open(treefile_name.c_str());
+		tree_in >> tree_str;
+		tree_in.close();
+	} catch (ios::failure) {
+		outError(ERR_READ_INPUT, treefile_name);
+	}
+	if (params.num_bootstrap_samples == 1)
+		reportPhyloAnalysis(params, original_model, *(boot_tree->aln), *boot_tree, model_info, removed_seqs, twin_seqs);
+	// WHY was the following line missing, which caused memory leak?
+	delete boot_tree->aln;
+	delete boot_tree;
+	return tree_str;
+}
+
+#ifdef _OPENMP
+/** log of the bootstrap replicate run by this thread, NULL outside runStandardBootstrapParallel() */
+static THREAD_LOCAL string *boot_replicate_log = NULL;
+
+/**
+ * cout buffer of runStandardBootstrapParallel(): a thread running a replicate
+ * writes to the log of that replicate, printed once the former replicates are done.
+ * Any other output goes to the former cout buffer one thread at a time.
+ */
+class BootstrapLogBuf : public streambuf {
+public:
+	BootstrapLogBuf(streambuf *out_buf) { this->out_buf = out_buf; }
+
+	/** write to the former cout buffer, serialized with all other output of the threads */
+	streamsize write(const char *s, streamsize n) {
+		streamsize res;
+#pragma omp critical(boot_cout)
+		{
+			res = out_buf->sputn(s, n);
+			out_buf->pubsync();
+		}
+		return res;
+	}
+
+protected:
+	streambuf *out_buf;
+
+	virtual int overflow(int c = EOF) {
+		if (c == EOF)
+			return 0;
+		char ch = c;
+		if (!boot_replicate_log)
+			return write(&ch, 1) == 1 ? c : EOF;
+		boot_replicate_log->push_back(ch);
+		return c;
+	}
+
+	virtual streamsize xsputn(const char *s, streamsize n) {
+		if (!boot_replicate_log)
+			return write(s, n);
+		boot_replicate_log->append(s, n);
+		return n;
+	}
+
+	virtual int sync() {
+		return 0;
+	}
+};
+
+/**
+ * the replicates of runStandardBootstrap() run by several threads, each replicate with
+ * its own tree and PLL instance on a single thread. Replicate i draws its bootstrap
+ * alignment and search from random stream i, as in the serial loop, so the trees do not
+ * depend on the number of threads. The trees, logs and .bootlh lines are written in
+ * replicate order.
+ */
+static void runStandardBootstrapParallel(Params &params, string &original_model, Alignment *alignment, IQTree *tree,
+		ofstream &tree_out, const string &bootlh_name) {
+	int nsamples = params.num_bootstrap_samples;
+	StrVector boot_trees(nsamples), boot_logs(nsamples);
+	DoubleVector boot_probs(nsamples, 0.0);
+	BoolVector done(nsamples, false);
+	int next_sample = 0;
+	// leave no state of the former analysis behind, as for a new alignment; the vectorized
+	// cost matrix is shared by the threads, only their thread-local state is reset below
+	resetGlobalParamOnNewAln();
+	streambuf *saved_cout_buf = cout.rdbuf();
+	BootstrapLogBuf log_buf(saved_cout_buf);
+	cout.rdbuf(&log_buf);
+
+#pragma omp parallel
+	{
+#pragma omp for schedule(dynamic)
+		for (int sample = 0; sample < nsamples; sample++) {
+			int *saved_stream = init_random_stream(sample, nsamples, params.ran_seed);
+			boot_replicate_log = &boot_logs[sample];
+			resetThreadParamOnNewAln();
+			cout << endl << "===> START BOOTSTRAP REPLICATE NUMBER "
+					<< sample + 1 << endl << endl;
+
+			cout << "Creating bootstrap alignment..." << endl;
+			Alignment *bootstrap_alignment = new Alignment;
+			bootstrap_alignment->createBootstrapAlignment(alignment, NULL, params.bootstrap_spec);
+			if (params.print_tree_lh)
+				bootstrap_alignment->multinomialProb(*alignment, boot_probs[sample]);
+
+			// nested parallel regions are off, a replicate runs on its own thread
+			Params boot_params = params;
+			boot_params.num_threads = 1;
+			string boot_prefix = string(params.out_prefix) + ".boot" + convertIntToString(sample + 1);
+			boot_params.out_prefix = (char*)boot_prefix.c_str();
+			boot_trees[sample] = runBootstrapReplicate(boot_params, original_model, bootstrap_alignment, tree);
+			remove((boot_prefix + ".treefile").c_str());
+			boot_replicate_log = NULL;
+			finish_random_stream(saved_stream);
+
+#pragma omp critical(boot_output)
+			{
+				done[sample] = true;
+				for (; next_sample < nsamples && done[next_sample]; next_sample++) {
+					log_buf.write(boot_logs[next_sample].c_str(), boot_logs[next_sample].length());
+					try {
+						tree_out << boot_trees[next_sample] << endl;
+					} catch (ios::failure) {
+						outError(ERR_WRITE_OUTPUT, string(params.out_prefix) + ".boottrees");
+					}
+					if (params.print_tree_lh) {
+						ofstream boot_lh;
+						if (next_sample == 0)
+							boot_lh.open(bootlh_name.c_str());
+						else
+							boot_lh.open(bootlh_name.c_str(), ios_base::out | ios_base::app);
+						boot_lh << "0\t" << boot_probs[next_sample] << endl;
+						boot_lh.close();
+					}
+					string().swap(boot_logs[next_sample]);
+					string().swap(boot_trees[next_sample]);
+				}
+			}
+		}
+		resetThreadParamOnNewAln();
+	}
+	cout.rdbuf(saved_cout_buf);
+	// leave no state of the replicates behind, as for a new alignment
+	resetGlobalParamOnNewAln();
+}
+#endif
+
 void runStandardBootstrap(Params &params, string &original_model, Alignment *alignment, IQTree *tree) {
 	vector<ModelInfo> model_info;
 	StrVector removed_seqs, twin_seqs;
@@ -1989,9 +2232,37 @@ void runStandardBootstrap(Params &params, string &original_model, Alignment *ali
 
 	double start_time = getCPUTime();
 
+	int first_sample = 0;
+#ifdef _OPENMP
+	// the PLL parsimony replicates in parallel; the vectorized Sankoff cost matrix
+	// is shared by all trees and the bootstrap alignments are printed one by one
+	if (params.num_threads > 1 && params.num_bootstrap_samples > 1 &&
+			params.maximum_parsimony && !params.pll && !alignment->isSuperAlignment() &&
+			!params.sankoff_cost_file && !params.print_bootaln && !params.count_trees) {
+		cout << endl << "Running " << params.num_bootstrap_samples << " bootstrap replicates on "
+				<< params.num_threads << " threads" << endl;
+		if (params.num_bootstrap_samples < params.num_threads)
+			outWarning("Each bootstrap replicate runs on a single thread, " +
+					convertIntToString(params.num_threads - params.num_bootstrap_samples) +
+					" of the threads will stay idle");
+		try {
+			ofstream tree_out;
+			tree_out.exceptions(ios::failbit | ios::badbit);
+			tree_out.open(boottrees_name.c_str(), ios_base::out | ios_base::app);
+			runStandardBootstrapParallel(params, original_model, alignment, tree, tree_out, bootlh_name);
+			tree_out.close();
+		} catch (ios::failure) {
+			outError(ERR_WRITE_OUTPUT, boottrees_name);
+		}
+		first_sample = params.num_bootstrap_samples;
+	}
+#endif
+
 	// do bootstrap analysis
-	for (int sample = 0; sample < params.num_bootstrap_samples; sample++) {
+	for (int sample = first_sample; sample < params.num_bootstrap_samples; sample++) {
         resetGlobalParamOnNewAln();
+		// replicate i on random stream i, as runStandardBootstrapParallel() does
+		int *saved_stream = init_random_stream(sample, params.num_bootstrap_samples, params.ran_seed);
 		cout << endl << "===> START BOOTSTRAP REPLICATE NUMBER "
 				<< sample + 1 << endl << endl;
 
@@ -2013,53 +2284,11 @@ void runStandardBootstrap(Params &params, string &original_model, Alignment *ali
 			boot_lh << "0\t" << prob << endl;
 			boot_lh.close();
 		}
-		IQTree *boot_tree;
-		if (alignment->isSuperAlignment()){
-			if(params.partition_type){
-				boot_tree = new PhyloSuperTreePlen((SuperAlignment*) bootstrap_alignment, (PhyloSuperTree*) tree);
-			} else {
-				boot_tree = new PhyloSuperTree((SuperAlignment*) bootstrap_alignment, (PhyloSuperTree*) tree);
-			}
-		} else
-			boot_tree = new IQTree(bootstrap_alignment);
 		if (params.print_bootaln)
 			bootstrap_alignment->printPhylip(bootaln_name.c_str(), true);
 
-        if(params.maximum_parsimony){
-            optimizeAlignment(boot_tree, params);// Diep: this is to rearrange columns for better speed in REPS
-        }
-                    
-		// the main Maximum likelihood tree reconstruction
-		vector<ModelInfo> model_info;
-		bootstrap_alignment->checkGappySeq();
+		string tree_str = runBootstrapReplicate(params, original_model, bootstrap_alignment, tree);
 
-		StrVector removed_seqs;
-		StrVector twin_seqs;
-		// remove identical sequences
-        if (params.ignore_identical_seqs){
-            boot_tree->removeIdenticalSeqs(params, removed_seqs, twin_seqs);
-            boot_tree->removedTaxons = removed_seqs;
-        }
-
-		runTreeReconstruction(params, original_model, *boot_tree, model_info);
-
-        // reinsert identical sequences
-		if (removed_seqs.size() > 0) {
-			boot_tree->insertTaxa(removed_seqs, twin_seqs);
-			boot_tree->printResultTree();
-		}
-
-		// read in the output tree file
-		string tree_str;
-		try {
-			ifstream tree_in;
-			tree_in.exceptions(ios::failbit | ios::badbit);
-			tree_in.open(treefile_name.c_str());
-			tree_in >> tree_str;
-			tree_in.close();
-		} catch (ios::failure) {
-			outError(ERR_READ_INPUT, treefile_name);
-		}
 		// write the tree into .boottrees file
 		try {
 			ofstream tree_out;
@@ -2070,12 +2299,7 @@ void runStandardBootstrap(Params &params, string &original_model, Alignment *ali
 		} catch (ios::failure) {
 			outError(ERR_WRITE_OUTPUT, boottrees_name);
 		}
-		if (params.num_bootstrap_samples == 1)
-			reportPhyloAnalysis(params, original_model, *(boot_tree->aln), *boot_tree, model_info, removed_seqs, twin_seqs);
-		// WHY was the following line missing, which caused memory leak?
-        
-        delete boot_tree->aln;
-		delete boot_tree;
+		finish_random_stream(saved_stream);
 	}
 
 	if (params.consensus_type == CT_CONSENSUS_TREE) {
@@ -2145,6 +2369,45 @@ void runStandardBootstrap(Params &params, string &original_model, Alignment *ali
 	cout << endl;
 }
 
+/**
+ * read the alignment params.aln_file, condensed with -mpcondense.
+ * With -alncache the result is kept in <prefix>.alnbin and read from there next time.
+ */
+Alignment *readAlignment(Params &params) {
+	bool condense = params.maximum_parsimony && !params.sankoff_cost_file && params.condense_parsimony_equiv_sites;
+	string cache_file = string(params.out_prefix) + ".alnbin";
+	// the canonical path keeps another alignment written to the same prefix from matching
+#ifdef WIN32
+	char *aln_path = _fullpath(NULL, params.aln_file, 0);
+#else
+	char *aln_path = realpath(params.aln_file, NULL);
+#endif
+	string key = string(aln_path ? aln_path : params.aln_file) + "\n" +
+			(params.sequence_type ? params.sequence_type : "") + (condense ? " condensed" : "");
+	free(aln_path);
+	Alignment *alignment;
+	if (params.aln_cache) {
+		alignment = new Alignment();
+		if (alignment->readBinaryCache(cache_file.c_str(), params.aln_file, key)) {
+			params.intype = detectInputFile(params.aln_file);
+			cout << "Alignment cache " << cache_file << " has " << alignment->getNSeq() << " sequences with "
+					<< alignment->getNSite() << " columns and " << alignment->getNPattern() << " patterns" << endl;
+			return alignment;
+		}
+		delete alignment;
+	}
+	alignment = new Alignment(params.aln_file, params.sequence_type, params.intype);
+	if (condense) {
+		Alignment *aln = new Alignment();
+		aln->condenseParsimonyEquivalentSites(alignment);
+		delete alignment;
+		alignment = aln;
+	}
+	if (params.aln_cache && alignment->seq_type != SEQ_CODON)
+		alignment->writeBinaryCache(cache_file.c_str(), params.aln_file, key);
+	return alignment;
+}
+
 void convertAlignment(Params &params, IQTree *iqtree) {
 	Alignment *alignment = iqtree->aln;
 	if (params.num_bootstrap_samples || params.print_bootaln) {
@@ -2210,17 +2473,11 @@ void runPhyloAnalysis(Params &params, Checkpoint *checkpoint) {
 		// this alignment will actually be of type SuperAlignment
 		alignment = tree->aln;
 	} else if(params.maximum_parsimony && params.sankoff_cost_file){
-		alignment = new Alignment(params.aln_file, params.sequence_type, params.intype);
+		alignment = readAlignment(params);
 		tree = new ParsTree(alignment);
 		dynamic_cast<ParsTree *>(tree)->initParsData(&params);
 	}else {
-		alignment = new Alignment(params.aln_file, params.sequence_type, params.intype);
-		if (params.maximum_parsimony && !params.sankoff_cost_file && params.condense_parsimony_equiv_sites) {
-			Alignment *aln = new Alignment();
-			aln->condenseParsimonyEquivalentSites(alignment);
-			delete alignment;
-			alignment = aln;
-		}
+		alignment = readAlignment(params);
 		tree = new IQTree(alignment);
 
 
@@ -1066,6 +1066,13 @@ typedef struct {
 
     parsimonyNumber *informativePtnScore; // Diep: informative pattern score
 
+    /* bytes allocated for the parsimony arrays above, which are only
+       reallocated when they have to grow (see pllReserveParsimonyBuffer) */
+    size_t parsVectSize;
+    size_t perSitePartialParsSize;
+    size_t informativePtnWgtSize;
+    size_t informativePtnScoreSize;
+
     /* This buffer of size width is used to store intermediate values for the
        branch length optimization under newton-raphson. The data in here can be
        re-used for all iterations irrespective of the branch length.
@@ -1302,6 +1309,7 @@ typedef struct {
 
     unsigned int bestParsimony;
     unsigned int *parsimonyScore;
+    size_t parsimonyScoreSize; /**< bytes allocated for parsimonyScore */
 
     double bestOfNode;
     nodeptr removeNode; /**< the node that has been removed. Together with \a
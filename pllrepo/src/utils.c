@@ -1214,6 +1214,12 @@ static partitionList * createPartitions (pllQueue * parts, int * bounds)
      pl->partitionData[i]->ascBias                   = pi->ascBias;
      pl->partitionData[i]->parsVect                  = NULL;
      pl->partitionData[i]->perSitePartialPars		= NULL; // Diep: added this according to new PLL version
+     pl->partitionData[i]->informativePtnWgt         = NULL;
+     pl->partitionData[i]->informativePtnScore       = NULL;
+     pl->partitionData[i]->parsVectSize              = 0;
+     pl->partitionData[i]->perSitePartialParsSize    = 0;
+     pl->partitionData[i]->informativePtnWgtSize     = 0;
+     pl->partitionData[i]->informativePtnScoreSize   = 0;
 
 
 
@@ -0,0 +1,185 @@
+/*
+ * splitcounter.cpp
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "splitcounter.h"
+#include "mtree.h"
+
+SplitCounter::SplitCounter() {
+    nentries = 0;
+    reference_id = -1;
+    corr_num = corr_x = corr_y = corr_xy = corr_xx = corr_yy = 0;
+}
+
+SplitCounter::~SplitCounter() {
+    clear();
+}
+
+void SplitCounter::clear() {
+    for (vector<Split*>::reverse_iterator it = splits.rbegin(); it != splits.rend(); it++)
+        delete (*it);
+    splits.clear();
+    split_index.clear();
+    split_count.clear();
+    split_trivial.clear();
+    ref_count.clear();
+    reference_id = -1;
+    corr_num = corr_x = corr_y = corr_xy = corr_xx = corr_yy = 0;
+    entry_splits.clear();
+    entry_converted.clear();
+    id_entries.clear();
+    tree_weight.clear();
+    counted_trees.clear();
+    nentries = 0;
+}
+
+void SplitCounter::countEntry(TreeStore &treels, int entry, int weight, vector<string> &taxname, bool rooted) {
+    if (entry >= entry_converted.size()) {
+        entry_converted.resize(treels.size(), false);
+        entry_splits.resize(treels.size());
+    }
+    if (!entry_converted[entry]) {
+        // convert the tree into splits as MTreeSet::init() and convertSplits() do
+        MTree tree;
+        stringstream ss(treels.getTreeAt(entry));
+        bool myrooted = rooted;
+        tree.readTree(ss, myrooted);
+        NodeVector taxa;
+        tree.getTaxa(taxa);
+        for (NodeVector::iterator taxit = taxa.begin(); taxit != taxa.end(); taxit++)
+            (*taxit)->id = atoi((*taxit)->name.c_str());
+        if (tree.leafNum != taxname.size())
+            outError("Tree has different number of taxa!");
+
+        SplitGraph isg;
+        tree.convertSplits(taxname, isg);
+        IntVector &ids = entry_splits[entry];
+        ids.reserve(isg.size());
+        for (SplitGraph::iterator itg = isg.begin(); itg != isg.end(); itg++)
+            ids.push_back(insertSplit(*itg));
+        entry_converted[entry] = true;
+    }
+    if (reference_id < 0) {
+        for (IntVector::iterator it = entry_splits[entry].begin(); it != entry_splits[entry].end(); it++)
+            split_count[*it] += weight;
+        return;
+    }
+    for (IntVector::iterator it = entry_splits[entry].begin(); it != entry_splits[entry].end(); it++) {
+        addCorrelationTerm(*it, -1);
+        split_count[*it] += weight;
+        addCorrelationTerm(*it, 1);
+    }
+}
+
+int SplitCounter::insertSplit(Split *sp) {
+    int id;
+    if (split_index.findSplit(sp, id))
+        return id;
+    id = splits.size();
+    Split *newsp = new Split(*sp);
+    splits.push_back(newsp);
+    split_count.push_back(0);
+    split_trivial.push_back(newsp->trivial() != -1);
+    split_index.insertSplit(newsp, id);
+    return id;
+}
+
+void SplitCounter::addCorrelationTerm(int id, int sign) {
+    if (split_trivial[id])
+        return;
+    int64_t x = (id < ref_count.size()) ? ref_count[id] : 0;
+    int64_t y = split_count[id];
+    if (x == 0 && y == 0)
+        return;
+    corr_num += sign;
+    corr_x += sign * x;
+    corr_y += sign * y;
+    corr_xy += sign * x * y;
+    corr_xx += sign * x * x;
+    corr_yy += sign * y * y;
+}
+
+void SplitCounter::setReference(SplitGraph &sg, int id) {
+    ref_count.assign(splits.size(), 0);
+    for (SplitGraph::iterator it = sg.begin(); it != sg.end(); it++) {
+        int sid = insertSplit(*it);
+        if (sid >= ref_count.size())
+            ref_count.resize(sid + 1, 0);
+        ref_count[sid] = (int)(*it)->getWeight();
+    }
+    reference_id = id;
+    corr_num = corr_x = corr_y = corr_xy = corr_xx = corr_yy = 0;
+    for (int sid = 0; sid < splits.size(); sid++)
+        addCorrelationTerm(sid, 1);
+}
+
+double SplitCounter::getCorrelation() {
+    // Pearson correlation from the sums, as computeCorrelation() in iqtree.cpp
+    double n = corr_num;
+    double fx = n * corr_xx - (double)corr_x * corr_x;
+    double fy = n * corr_yy - (double)corr_y * corr_y;
+    if (fx <= 0.0 || fy <= 0.0)
+        return 1.0;
+    return (n * corr_xy - (double)corr_x * corr_y) / (sqrt(fx) * sqrt(fy));
+}
+
+void SplitCounter::addTreeWeight(TreeStore &treels, int id, int weight, vector<string> &taxname, bool rooted) {
+    if (id < 0)
+        return;
+    if (id >= tree_weight.size())
+        tree_weight.resize(id + 1, 0);
+    tree_weight[id] += weight;
+    if (id < id_entries.size())
+        for (IntVector::iterator it = id_entries[id].begin(); it != id_entries[id].end(); it++)
+            countEntry(treels, *it, weight, taxname, rooted);
+}
+
+void SplitCounter::update(TreeStore &treels, IntVector &boot_trees, vector<string> &taxname, bool rooted) {
+    // new candidate trees, counted at once if a replicate already picked their index
+    for (; nentries < treels.size(); nentries++) {
+        int id = treels.getIdAt(nentries);
+        if (id >= id_entries.size())
+            id_entries.resize(id + 1);
+        id_entries[id].push_back(nentries);
+        if (id < tree_weight.size() && tree_weight[id] > 0)
+            countEntry(treels, nentries, tree_weight[id], taxname, rooted);
+    }
+
+    if (counted_trees.size() < boot_trees.size())
+        counted_trees.resize(boot_trees.size(), -1);
+    for (int sample = 0; sample < boot_trees.size(); sample++) {
+        if (boot_trees[sample] == counted_trees[sample])
+            continue;
+        addTreeWeight(treels, counted_trees[sample], -1, taxname, rooted);
+        addTreeWeight(treels, boot_trees[sample], 1, taxname, rooted);
+        counted_trees[sample] = boot_trees[sample];
+    }
+}
+
+int SplitCounter::convertSplits(TreeStore &treels, vector<string> &taxname, SplitGraph &sg, SplitIntMap &hash_ss) {
+    sg.createBlocks();
+    for (vector<string>::iterator its = taxname.begin(); its != taxname.end(); its++)
+        sg.getTaxa()->AddTaxonLabel(NxsString(its->c_str()));
+
+    // the splits are listed in the order of their first tree, as MTreeSet::convertSplits() does
+    BoolVector listed(splits.size(), false);
+    int sum_weights = 0;
+    for (int entry = 0; entry < nentries; entry++) {
+        int id = treels.getIdAt(entry);
+        if (id >= tree_weight.size() || tree_weight[id] == 0)
+            continue;
+        sum_weights += tree_weight[id];
+        for (IntVector::iterator it = entry_splits[entry].begin(); it != entry_splits[entry].end(); it++) {
+            if (listed[*it])
+                continue;
+            listed[*it] = true;
+            Split *sp = new Split(*splits[*it]);
+            sp->setWeight(split_count[*it]);
+            sg.push_back(sp);
+            hash_ss.insertSplit(sp, split_count[*it]);
+        }
+    }
+    return sum_weights;
+}
@@ -0,0 +1,126 @@
+/*
+ * splitcounter.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef SPLITCOUNTER_H_
+#define SPLITCOUNTER_H_
+
+#include "tools.h"
+#include "treestore.h"
+#include "splitgraph.h"
+#include "hashsplitset.h"
+
+/**
+ * Split frequencies of the UFBoot replicate trees, kept up to date between summaries.
+ * Each candidate tree is converted into splits once, when a replicate first picks it;
+ * afterwards only the replicates whose tree changed are recounted, so a summary
+ * does not parse the candidate trees again.
+ * The counter also tracks the correlation of the current split frequencies with
+ * a reference summary (the UFBoot stopping rule), updated whenever a count changes.
+ */
+class SplitCounter {
+public:
+    SplitCounter();
+
+    ~SplitCounter();
+
+    /**
+     * count the splits of the trees of the replicates that changed since the last call
+     * @param treels candidate trees printed with WT_TAXON_ID
+     * @param boot_trees index in treels of the tree of each replicate
+     * @param taxname taxon names ordered by ID
+     * @param rooted true if the trees are rooted
+     */
+    void update(TreeStore &treels, IntVector &boot_trees, vector<string> &taxname, bool rooted);
+
+    /**
+     * build the split system of the counted trees, the same as
+     * MTreeSet::convertSplits(taxname, sg, hash_ss, SW_COUNT, -1, false)
+     * on the trees of treels weighted by the number of replicates picking them
+     * @param treels candidate trees, as passed to update()
+     * @param taxname taxon names ordered by ID
+     * @param sg (OUT) splits weighted by their number of replicates
+     * @param hash_ss (OUT) split -> number of replicates
+     * @return sum of the tree weights
+     */
+    int convertSplits(TreeStore &treels, vector<string> &taxname, SplitGraph &sg, SplitIntMap &hash_ss);
+
+    /** forget all trees, e.g. when the candidate trees are restored from a checkpoint */
+    void clear();
+
+    /**
+     * compare the split frequencies with those of a former summary from now on
+     * @param sg splits weighted by their number of replicates, e.g. from convertSplits()
+     * @param id caller's identifier of sg, returned by getReferenceId()
+     */
+    void setReference(SplitGraph &sg, int id);
+
+    /** @return id passed to setReference(), -1 if none since the last clear() */
+    int getReferenceId() { return reference_id; }
+
+    /**
+     * @return correlation coefficient of the numbers of replicates of the non-trivial
+     * splits occurring in the reference or in the counted trees, the same as
+     * IQTree::computeBootstrapCorrelation() between the reference and convertSplits()
+     */
+    double getCorrelation();
+
+private:
+    /**
+     * add weight to the count of each split of a treels entry
+     * @param entry entry number in treels
+     */
+    void countEntry(TreeStore &treels, int entry, int weight, vector<string> &taxname, bool rooted);
+
+    /** add weight to tree index id, see update() */
+    void addTreeWeight(TreeStore &treels, int id, int weight, vector<string> &taxname, bool rooted);
+
+    /** @return index in splits of sp, added with a zero count if not yet seen */
+    int insertSplit(Split *sp);
+
+    /** add (sign=1) or remove (sign=-1) split id to the sums of getCorrelation() */
+    void addCorrelationTerm(int id, int sign);
+
+    /** distinct splits seen so far */
+    vector<Split*> splits;
+
+    /** split -> index in splits */
+    SplitIntMap split_index;
+
+    /** number of replicates having each split */
+    IntVector split_count;
+
+    /** true for the trivial splits, left out of the correlation */
+    BoolVector split_trivial;
+
+    /** number of replicates having each split in the reference, see setReference() */
+    IntVector ref_count;
+
+    /** see getReferenceId() */
+    int reference_id;
+
+    /** number of splits, sums of reference counts x, current counts y, x*y, x*x and y*y */
+    int64_t corr_num, corr_x, corr_y, corr_xy, corr_xx, corr_yy;
+
+    /** indices in splits of each treels entry, filled when the entry is first counted */
+    vector<IntVector> entry_splits;
+
+    /** true if entry_splits is filled for the entry */
+    BoolVector entry_converted;
+
+    /** treels entries of each tree index */
+    vector<IntVector> id_entries;
+
+    /** number of replicates picking each tree index */
+    IntVector tree_weight;
+
+    /** tree index counted for each replicate, -1 if none */
+    IntVector counted_trees;
+
+    /** number of treels entries assigned to id_entries */
+    int nentries;
+};
+
+#endif /* SPLITCOUNTER_H_ */
@@ -6,6 +6,7 @@
  */
 #include "sprparsimony.h"
 #include "parstree.h"
+#include "parsimonykernel.h"
 #include <string>
 /**
  * PLL (version 1.0.0) a software library for phylogenetic inference
@@ -114,6 +115,10 @@
 #include "pllrepo/src/pll.h"
 #include "pllrepo/src/pllInternal.h"
 
+#ifdef _OPENMP
+	#include <omp.h>
+#endif
+
 
 static pllBoolean tipHomogeneityCheckerPars(pllInstance *tr, nodeptr p, int grouping);
 
@@ -124,29 +129,37 @@ extern const unsigned int mask32[32];
 extern double masterTime;
 
 /* program options */
-extern Params *globalParam;
-IQTree * iqtree = NULL;
-unsigned long bestTreeScoreHits; // to count hits to bestParsimony
+/* search state is thread-local, see IQTree::refineBootTreesParallel() */
+extern THREAD_LOCAL Params *globalParam;
+THREAD_LOCAL IQTree * iqtree = NULL;
+THREAD_LOCAL unsigned long bestTreeScoreHits; // to count hits to bestParsimony
 
-extern parsimonyNumber * pllCostMatrix; // Diep: For weighted version
-extern int pllCostNstates; // Diep: For weighted version
+extern THREAD_LOCAL parsimonyNumber * pllCostMatrix; // Diep: For weighted version
+extern THREAD_LOCAL int pllCostNstates; // Diep: For weighted version
 extern parsimonyNumber *vectorCostMatrix; // BQM: vectorized cost matrix
-parsimonyNumber highest_cost;
+THREAD_LOCAL parsimonyNumber highest_cost;
 
 //(if needed) split the parsimony vector into several segments to avoid overflow when calc rell based on vec8us
-extern int pllRepsSegments; // # of segments
-extern int * pllSegmentUpper; // array of first index of the next segment, see IQTree::segment_upper
-parsimonyNumber * pllRemainderLowerBounds; // array of lower bound score for the un-calculated part to the right of a segment
-bool first_call = true; // is this the first call to pllOptimizeSprParsimony
-bool doing_stepwise_addition = false; // is the stepwise addition on
+extern THREAD_LOCAL int pllRepsSegments; // # of segments
+extern THREAD_LOCAL int * pllSegmentUpper; // array of first index of the next segment, see IQTree::segment_upper
+THREAD_LOCAL parsimonyNumber * pllRemainderLowerBounds; // array of lower bound score of the patterns from each one to the end, see compressSankoffDNA()
+static const size_t BOUND_CHECK_VECTORS = 4; // vectors of patterns scored by Sankoff between two checks of pllRemainderLowerBounds
+THREAD_LOCAL bool first_call = true; // is this the first call to pllOptimizeSprParsimony
+THREAD_LOCAL bool doing_stepwise_addition = false; // is the stepwise addition on
+THREAD_LOCAL size_t sprScratchNumber = 0; // index of the first scratch parsimony vector for the multithreaded SPR, 0 if none
+THREAD_LOCAL int sprUpSlots = 0; // number of scratch vectors per thread for the subtrees behind the regraft positions
 
 void resetGlobalParamOnNewAln(){
+    resetThreadParamOnNewAln();
+    vectorCostMatrix = NULL;
+}
+
+void resetThreadParamOnNewAln(){
     globalParam = NULL;
     iqtree = NULL;
     bestTreeScoreHits = 0;
     pllCostMatrix = NULL;
     pllCostNstates = 0;
-    vectorCostMatrix = NULL;
     highest_cost = 0;
 
     pllRepsSegments = -1;
@@ -156,30 +169,33 @@ void resetGlobalParamOnNewAln(){
     doing_stepwise_addition = false;
 }
 
-void initializeCostMatrix() {
-    highest_cost = *max_element(pllCostMatrix, pllCostMatrix+pllCostNstates*pllCostNstates) + 1;
-
-//    cout << "Segments: ";
-//    for (int i = 0; i < pllRepsSegments; i++)
-//        cout <<  " " << pllSegmentUpper[i];
-//    cout << endl;
+void pllReserveParsimonyBuffer(void **buf, size_t *size, size_t new_size)
+{
+	if(*buf != NULL && new_size <= *size)
+		return;
+	if(*buf != NULL)
+		rax_free(*buf);
+	rax_posix_memalign (buf, PLL_BYTE_ALIGNMENT, new_size);
+	*size = new_size;
+}
 
+void initializeVectorCostMatrix(unsigned int *cost_matrix, int nstates, bool short_int) {
 #if (defined(__SSE3) || defined(__AVX))
-    assert(pllCostMatrix);
+    assert(cost_matrix);
     if (!vectorCostMatrix) {
-        rax_posix_memalign ((void **) &(vectorCostMatrix), PLL_BYTE_ALIGNMENT, sizeof(parsimonyNumber)*pllCostNstates*pllCostNstates);
+        rax_posix_memalign ((void **) &(vectorCostMatrix), PLL_BYTE_ALIGNMENT, sizeof(parsimonyNumber)*nstates*nstates);
 
-        if (globalParam->sankoff_short_int) {
+        if (short_int) {
             parsimonyNumberShort *shortMatrix = (parsimonyNumberShort*)vectorCostMatrix;
             // duplicate the cost entries for vector operations
-            for (int i = 0; i < pllCostNstates; i++)
-                for (int j = 0; j < pllCostNstates; j++)
-                        shortMatrix[(i*pllCostNstates+j)] = pllCostMatrix[i*pllCostNstates+j];
+            for (int i = 0; i < nstates; i++)
+                for (int j = 0; j < nstates; j++)
+                        shortMatrix[(i*nstates+j)] = cost_matrix[i*nstates+j];
         } else {
             // duplicate the cost entries for vector operations
-            for (int i = 0; i < pllCostNstates; i++)
-                for (int j = 0; j < pllCostNstates; j++)
-                        vectorCostMatrix[(i*pllCostNstates+j)] = pllCostMatrix[i*pllCostNstates+j];
+            for (int i = 0; i < nstates; i++)
+                for (int j = 0; j < nstates; j++)
+                        vectorCostMatrix[(i*nstates+j)] = cost_matrix[i*nstates+j];
         }
     }
 #else
@@ -187,6 +203,54 @@ void initializeCostMatrix() {
 #endif
 }
 
+void PllSearchState::capture() {
+	params = globalParam;
+	cost_matrix = pllCostMatrix;
+	cost_nstates = pllCostNstates;
+	reps_segments = pllRepsSegments;
+	segment_upper = pllSegmentUpper;
+	remainder_lower_bounds = NULL;
+	stepwise_addition = false;
+}
+
+void PllSearchState::capture(parsimonyNumber *lower_bounds, bool stepwise) {
+	capture();
+	remainder_lower_bounds = lower_bounds;
+	stepwise_addition = stepwise;
+}
+
+void PllSearchState::apply() {
+	globalParam = params;
+	pllCostMatrix = cost_matrix;
+	pllCostNstates = cost_nstates;
+	pllRepsSegments = reps_segments;
+	pllSegmentUpper = segment_upper;
+}
+
+void PllSearchState::apply(parsimonyNumber *&lower_bounds, bool &stepwise) {
+	apply();
+	lower_bounds = remainder_lower_bounds;
+	stepwise = stepwise_addition;
+}
+
+void PllSearchState::release(parsimonyNumber *&lower_bounds) {
+#ifdef _OPENMP
+	if(omp_get_thread_num() != 0)
+		lower_bounds = NULL;
+#endif
+}
+
+void initializeCostMatrix() {
+    highest_cost = *max_element(pllCostMatrix, pllCostMatrix+pllCostNstates*pllCostNstates) + 1;
+
+//    cout << "Segments: ";
+//    for (int i = 0; i < pllRepsSegments; i++)
+//        cout <<  " " << pllSegmentUpper[i];
+//    cout << endl;
+
+    initializeVectorCostMatrix(pllCostMatrix, pllCostNstates, globalParam->sankoff_short_int);
+}
+
 // note: pllCostMatrix[i*pllCostNstates+j] = cost from i to j
 
 ///************************************************ pop count stuff ***********************************************/
@@ -785,6 +849,7 @@ static void newviewParsimonyIterativeFast(pllInstance *tr, partitionList *pr, in
 
     INT_TYPE
     allOne = SET_ALL_BITS_ONE;
+    const ParsimonyKernel *parsKernel = getParsimonyKernel();
 
     int model, *ti = tr->ti, count = ti[0], index;
 
@@ -807,6 +872,15 @@ static void newviewParsimonyIterativeFast(pllInstance *tr, partitionList *pr, in
 
             unsigned int i;
 
+            if (parsKernel && !perSiteScores) {
+                totalScore += parsKernel->newview(
+                    &pr->partitionData[model]->parsVect[width * states * qNumber],
+                    &pr->partitionData[model]->parsVect[width * states * rNumber],
+                    &pr->partitionData[model]->parsVect[width * states * pNumber],
+                    states, width);
+                continue;
+            }
+
             switch (states) {
             case 2: {
                 parsimonyNumber *left[2], *right[2], *cur[2];
@@ -1039,6 +1113,10 @@ parsimonyNumber evaluateSankoffParsimonyIterativeFastSIMD(pllInstance *tr, parti
 
     uint32_t total_sum = 0;
 
+	// Diep: IMPORTANT! since the pllRemainderLowerBounds is computed for full ntaxa
+	// the early termination must be disabled during stepwise addition
+	bool bounded = (!doing_stepwise_addition) && (!perSiteScores) && pllRemainderLowerBounds;
+
     if(tr->ti[0] > 4)
         newviewParsimonyIterativeFast(tr, pr, perSiteScores);
 
@@ -1080,11 +1158,6 @@ parsimonyNumber evaluateSankoffParsimonyIterativeFastSIMD(pllInstance *tr, parti
                 // sum += best_score * (size_t)tr->aliaswgt[i]; // wrong (because aliaswgt is for all patterns, not just informative pattern)
                 if(perSiteScores) {
                     best_score.store_a(&ptnScore[i]);
-                } else {
-                    // TODO without having to store per site score AND finished a block of patterns
-                    // then use the lower-bound to stop early
-                    // if current_score + lower_bound_remaining > best_score then
-                    //     return current_score + lower_bound_remaining
                 }
 
                 if (BY_PATTERN)
@@ -1092,16 +1165,21 @@ parsimonyNumber evaluateSankoffParsimonyIterativeFastSIMD(pllInstance *tr, parti
                 else
                     sum += best_score;
 
-                // if(sum >= bestScore)
-                // 		return sum;
+                // the patterns are sorted by decreasing parsimony, so the move is
+                // dropped as soon as the patterns left cannot make it the best one
+                size_t next = i + VectorClass::size();
+                if(bounded && (next - lower) % (BOUND_CHECK_VECTORS * VectorClass::size()) == 0 && next < upper){
+                    parsimonyNumber est_score = total_sum + horizontal_add(sum) +
+                        pllRemainderLowerBounds[next];
+                    if(est_score > tr->bestParsimony)
+                        return est_score;
+                }
             }
 
             total_sum += horizontal_add(sum);
 
-			// Diep: IMPORTANT! since the pllRemainderLowerBounds is computed for full ntaxa
-			// the following must be disabled during stepwise addition
-            if((!doing_stepwise_addition) && (!perSiteScores) && (seg < pllRepsSegments - 1)){
-				parsimonyNumber est_score = total_sum + pllRemainderLowerBounds[seg];
+            if(bounded && (seg < pllRepsSegments - 1)){
+				parsimonyNumber est_score = total_sum + pllRemainderLowerBounds[upper];
 				if(est_score > tr->bestParsimony){
 					return est_score;
 				}
@@ -1114,7 +1192,7 @@ parsimonyNumber evaluateSankoffParsimonyIterativeFastSIMD(pllInstance *tr, parti
 
 
 
-static unsigned int evaluateParsimonyIterativeFast(pllInstance *tr, partitionList *pr, int perSiteScores)
+static unsigned int evaluateParsimonyIterativeFast(pllInstance *tr, partitionList *pr, int perSiteScores, unsigned int bound)
 {
 	if(pllCostMatrix) {
 //        return evaluateSankoffParsimonyIterativeFast(tr, pr, perSiteScores);
@@ -1183,6 +1261,7 @@ static unsigned int evaluateParsimonyIterativeFast(pllInstance *tr, partitionLis
 
   INT_TYPE
     allOne = SET_ALL_BITS_ONE;
+    const ParsimonyKernel *parsKernel = getParsimonyKernel();
 
   size_t
     pNumber = (size_t)tr->ti[1],
@@ -1192,7 +1271,6 @@ static unsigned int evaluateParsimonyIterativeFast(pllInstance *tr, partitionLis
     model;
 
   unsigned int
-    bestScore = tr->bestParsimony,
     sum;
 
   if(tr->ti[0] > 4)
@@ -1200,6 +1278,11 @@ static unsigned int evaluateParsimonyIterativeFast(pllInstance *tr, partitionLis
 
   sum = tr->parsimonyScore[pNumber] + tr->parsimonyScore[qNumber];
 
+  // the subtree scores are a lower bound of the score, so the patterns are
+  // counted only while the score may still reach the bound
+  if(sum > bound)
+    return sum;
+
   if(perSiteScores){
 	  resetPerSiteNodeScores(pr, tr->start->number);
 	  addPerSiteSubtreeScores(pr, tr->start->number, pNumber, qNumber);
@@ -1213,6 +1296,16 @@ static unsigned int evaluateParsimonyIterativeFast(pllInstance *tr, partitionLis
         width  = pr->partitionData[model]->parsimonyLength,
         i;
 
+       if (parsKernel && !perSiteScores) {
+           sum += parsKernel->evaluate(
+               &pr->partitionData[model]->parsVect[width * states * qNumber],
+               &pr->partitionData[model]->parsVect[width * states * pNumber],
+               states, width, bound - sum);
+           if(sum > bound)
+             return sum;
+           continue;
+       }
+
        switch(states)
          {
          case 2:
@@ -1240,8 +1333,8 @@ static unsigned int evaluateParsimonyIterativeFast(pllInstance *tr, partitionLis
                  if(perSiteScores)
                 	 storePerSiteNodeScores(pr, model, v_N, i, tr->start->number);
 
-//                 if(sum >= bestScore)
-//                   return sum;
+                 if(sum > bound)
+                   return sum;
                }
            }
            break;
@@ -1271,8 +1364,8 @@ static unsigned int evaluateParsimonyIterativeFast(pllInstance *tr, partitionLis
                  sum += vectorPopcount(v_N);
                  if(perSiteScores)
                 	 storePerSiteNodeScores(pr, model, v_N, i, tr->start->number);
-//                 if(sum >= bestScore)
-//                   return sum;
+                 if(sum > bound)
+                   return sum;
                }
            }
            break;
@@ -1308,8 +1401,8 @@ static unsigned int evaluateParsimonyIterativeFast(pllInstance *tr, partitionLis
                   sum += vectorPopcount(v_N);
                   if(perSiteScores)
                  	 storePerSiteNodeScores(pr, model, v_N, i, tr->start->number);
-//                  if(sum >= bestScore)
-//                    return sum;
+                    if(sum > bound)
+                      return sum;
                 }
            }
            break;
@@ -1347,8 +1440,8 @@ static unsigned int evaluateParsimonyIterativeFast(pllInstance *tr, partitionLis
                  sum += vectorPopcount(v_N);
                  if(perSiteScores)
                 	 storePerSiteNodeScores(pr, model, v_N, i, tr->start->number);
-//                 if(sum >= bestScore)
-//                   return sum;
+                 if(sum > bound)
+                   return sum;
                }
            }
          }
@@ -1532,6 +1625,7 @@ static void newviewSankoffParsimonyIterativeFast(pllInstance *tr, partitionList
 static void newviewParsimonyIterativeFast(pllInstance *tr, partitionList *pr, int perSiteScores)
 {
 	if(pllCostMatrix) return newviewSankoffParsimonyIterativeFast(tr, pr, perSiteScores);
+	const ParsimonyKernel *parsKernel = getParsimonyKernel();
   int
     model,
     *ti = tr->ti,
@@ -1558,6 +1652,15 @@ static void newviewParsimonyIterativeFast(pllInstance *tr, partitionList *pr, in
           unsigned int
             i;
 
+          if (parsKernel && !perSiteScores) {
+              totalScore += parsKernel->newview(
+                  &pr->partitionData[model]->parsVect[width * states * qNumber],
+                  &pr->partitionData[model]->parsVect[width * states * rNumber],
+                  &pr->partitionData[model]->parsVect[width * states * pNumber],
+                  states, width);
+              continue;
+          }
+
           switch(states)
             {
             case 2:
@@ -1866,9 +1969,10 @@ static unsigned int evaluateSankoffParsimonyIterativeFast(pllInstance *tr, parti
 
 
 
-static unsigned int evaluateParsimonyIterativeFast(pllInstance *tr, partitionList *pr, int perSiteScores)
+static unsigned int evaluateParsimonyIterativeFast(pllInstance *tr, partitionList *pr, int perSiteScores, unsigned int bound)
 {
 	if(pllCostMatrix) return evaluateSankoffParsimonyIterativeFast(tr, pr, perSiteScores);
+	const ParsimonyKernel *parsKernel = getParsimonyKernel();
 
   size_t
     pNumber = (size_t)tr->ti[1],
@@ -1878,7 +1982,6 @@ static unsigned int evaluateParsimonyIterativeFast(pllInstance *tr, partitionLis
     model;
 
   unsigned int
-    bestScore = tr->bestParsimony,
     sum;
 
   if(tr->ti[0] > 4)
@@ -1886,6 +1989,11 @@ static unsigned int evaluateParsimonyIterativeFast(pllInstance *tr, partitionLis
 
   sum = tr->parsimonyScore[pNumber] + tr->parsimonyScore[qNumber];
 
+  // the subtree scores are a lower bound of the score, so the patterns are
+  // counted only while the score may still reach the bound
+  if(sum > bound)
+    return sum;
+
   for(model = 0; model < pr->numberOfPartitions; model++)
     {
       size_t
@@ -1894,6 +2002,16 @@ static unsigned int evaluateParsimonyIterativeFast(pllInstance *tr, partitionLis
         width  = pr->partitionData[model]->parsimonyLength,
         i;
 
+       if (parsKernel && !perSiteScores) {
+           sum += parsKernel->evaluate(
+               &pr->partitionData[model]->parsVect[width * states * qNumber],
+               &pr->partitionData[model]->parsVect[width * states * pNumber],
+               states, width, bound - sum);
+           if(sum > bound)
+             return sum;
+           continue;
+       }
+
        switch(states)
          {
          case 2:
@@ -1920,8 +2038,8 @@ static unsigned int evaluateParsimonyIterativeFast(pllInstance *tr, partitionLis
 
                   sum += ((unsigned int) __builtin_popcount(t_N));
 
-//                 if(sum >= bestScore)
-//                   return sum;
+                 if(sum > bound)
+                   return sum;
                }
            }
            break;
@@ -1953,8 +2071,8 @@ static unsigned int evaluateParsimonyIterativeFast(pllInstance *tr, partitionLis
 
                   sum += ((unsigned int) __builtin_popcount(t_N));
 
-//                 if(sum >= bestScore)
-//                   return sum;
+                 if(sum > bound)
+                   return sum;
                }
            }
            break;
@@ -1986,8 +2104,8 @@ static unsigned int evaluateParsimonyIterativeFast(pllInstance *tr, partitionLis
 
                   sum += ((unsigned int) __builtin_popcount(t_N));
 
-//                  if(sum >= bestScore)
-//                    return sum;
+                    if(sum > bound)
+                      return sum;
                 }
            }
            break;
@@ -2021,8 +2139,8 @@ static unsigned int evaluateParsimonyIterativeFast(pllInstance *tr, partitionLis
 
                   sum += ((unsigned int) __builtin_popcount(t_N));
 
-//                 if(sum >= bestScore)
-//                   return sum;
+                 if(sum > bound)
+                   return sum;
                }
            }
          }
@@ -2033,7 +2151,11 @@ static unsigned int evaluateParsimonyIterativeFast(pllInstance *tr, partitionLis
 
 #endif
 
-static unsigned int evaluateParsimony(pllInstance *tr, partitionList *pr, nodeptr p, pllBoolean full, int perSiteScores)
+/**
+ * @param bound the evaluation may stop once the score exceeds bound and return
+ * this partial score, UINT_MAX for the exact score (ignored by Sankoff parsimony)
+ */
+static unsigned int evaluateParsimony(pllInstance *tr, partitionList *pr, nodeptr p, pllBoolean full, int perSiteScores, unsigned int bound)
 {
 	volatile unsigned int result;
 	nodeptr q = p->back;
@@ -2058,7 +2180,7 @@ static unsigned int evaluateParsimony(pllInstance *tr, partitionList *pr, nodept
 
 	ti[0] = counter;
 
-	result = evaluateParsimonyIterativeFast(tr, pr, perSiteScores);
+	result = evaluateParsimonyIterativeFast(tr, pr, perSiteScores, bound);
 
 	return result;
 }
@@ -2250,6 +2372,23 @@ static void nodeRectifierPars(pllInstance *tr)
 
 
 
+/**
+ * keep the insertion of p into the branch q-q->back as the best SPR move if its score mp
+ * is better than tr->bestParsimony, or equal with probability 1/(number of equally good moves)
+ */
+static void updateBestInsertion(pllInstance *tr, nodeptr p, nodeptr q, unsigned int mp)
+{
+	if(mp < tr->bestParsimony) bestTreeScoreHits = 1;
+	else if(mp == tr->bestParsimony) bestTreeScoreHits++;
+
+	if((mp < tr->bestParsimony) ||
+		((mp == tr->bestParsimony) && (random_double() <= 1.0 / bestTreeScoreHits))){
+		tr->bestParsimony = mp;
+		tr->insertNode = q;
+		tr->removeNode = p;
+	}
+}
+
 static void testInsertParsimony (pllInstance *tr, partitionList *pr, nodeptr p, nodeptr q, pllBoolean saveBranches, int perSiteScores)
 {
   unsigned int
@@ -2304,7 +2443,10 @@ static void testInsertParsimony (pllInstance *tr, partitionList *pr, nodeptr p,
 
       insertParsimony(tr, pr, p, q, perSiteScores);
 
-      mp = evaluateParsimony(tr, pr, p->next->next, PLL_FALSE, perSiteScores);
+      // a move scoring worse than the best one is dropped by updateBestInsertion() anyway,
+      // so its evaluation may stop once the bound is exceeded; UFBoot needs exact scores
+      mp = evaluateParsimony(tr, pr, p->next->next, PLL_FALSE, perSiteScores,
+          perSiteScores ? UINT_MAX : tr->bestParsimony);
 
 //		if(globalParam->gbo_replicates > 0 && perSiteScores){
 		if(perSiteScores){
@@ -2312,15 +2454,7 @@ static void testInsertParsimony (pllInstance *tr, partitionList *pr, nodeptr p,
 			pllSaveCurrentTreeSprParsimony(tr, pr, mp); // run UFBoot
 		}
 
-		if(mp < tr->bestParsimony) bestTreeScoreHits = 1;
-		else if(mp == tr->bestParsimony) bestTreeScoreHits++;
-
-		if((mp < tr->bestParsimony) ||
-			((mp == tr->bestParsimony) && (random_double() <= 1.0 / bestTreeScoreHits))){
-			tr->bestParsimony = mp;
-			tr->insertNode = q;
-			tr->removeNode = p;
-		}
+		updateBestInsertion(tr, p, q, mp);
 
       if(saveBranches)
         hookup(q, r, z, numBranches);
@@ -2364,6 +2498,293 @@ static void addTraverseParsimony (pllInstance *tr, partitionList *pr, nodeptr p,
     }
 }
 
+/**
+ * @return number of parsimony vectors to allocate: one per node (index 1 .. 2*mxtips-1),
+ * followed by the scratch vectors of addTraverseParsimonyParallel() if SPR moves
+ * are evaluated by several threads
+ */
+static size_t parsimonyVectorCount(pllInstance *tr, int perSiteScores)
+{
+	size_t count = 2 * (size_t)tr->mxtips;
+	sprScratchNumber = 0;
+#ifdef _OPENMP
+	if(!perSiteScores && globalParam->num_threads > 1 && !omp_in_parallel()){
+		// per thread, a ring of vectors for the subtrees behind the regraft positions,
+		// deep enough for the SPR radius, plus 1 for the branch being scored
+		sprUpSlots = max(globalParam->spr_maxtrav, globalParam->sprDist) + 1;
+		sprUpSlots = max(2, min(sprUpSlots, tr->mxtips));
+		sprScratchNumber = count;
+		count += (size_t)globalParam->num_threads * (sprUpSlots + 1);
+	}
+#endif
+	return count;
+}
+
+#ifdef _OPENMP
+
+/** vector of the subtree behind a regraft position, computed by each thread, see threadUpVector() */
+struct SprUpVector {
+	/** node vector joined with the subtree of the parent, -1 if this is the node vector 'base' itself */
+	int sibling;
+	/** index of the parent entry, -1 if 'sibling' is joined with the node vector 'base' instead */
+	int parent;
+	int base;
+	/** number of ancestors, selects the slot in the ring of vectors of a thread */
+	int depth;
+};
+
+/** regraft position tested by addTraverseParsimonyParallel() */
+struct SprInsertion {
+	/** p is inserted into the branch q-q->back */
+	nodeptr q;
+	/** index of the entry of the subtree behind q->back, i.e. away from q */
+	int up;
+};
+
+/** append an entry to ups, @return its index */
+static int addUpVector(vector<SprUpVector> &ups, int sibling, int parent, int base)
+{
+	SprUpVector up = {sibling, parent, base, (parent < 0) ? 0 : ups[parent].depth + 1};
+	ups.push_back(up);
+	return ups.size() - 1;
+}
+
+/**
+ * @return index of the parsimony vector of ups[k]; it is computed into the slot
+ * depth % nslots of the ring first_up .. first_up+nslots-1 of the calling thread,
+ * starting from the nearest ancestor still in the ring
+ * @param slot_up entry held by each slot of the ring, -1 if none
+ */
+static int threadUpVector(pllInstance *tr, partitionList *pr, vector<SprUpVector> &ups, int k,
+		int first_up, vector<int> &slot_up)
+{
+	SprUpVector &up = ups[k];
+	if(up.sibling < 0)
+		return up.base;
+	int slot = up.depth % slot_up.size();
+	if(slot_up[slot] != k){
+		int behind = (up.parent < 0) ? up.base : threadUpVector(tr, pr, ups, up.parent, first_up, slot_up);
+		tr->ti[0] = 8;
+		tr->ti[4] = first_up + slot;
+		tr->ti[5] = up.sibling;
+		tr->ti[6] = behind;
+		newviewParsimonyIterativeFast(tr, pr, 0);
+		slot_up[slot] = k;
+	}
+	return first_up + slot;
+}
+
+/**
+ * list the regraft positions of addTraverseParsimony(tr, pr, p, q, mintrav, maxtrav, PLL_FALSE, ...)
+ * in the same order, and append to ups the subtrees behind each of them
+ * @param visited (OUT) nodes whose vector is used, in preorder
+ */
+static void collectInsertionsParsimony(pllInstance *tr, nodeptr q, int up, int mintrav, int maxtrav,
+		vector<SprInsertion> &insertions, vector<nodeptr> &visited, vector<SprUpVector> &ups)
+{
+	visited.push_back(q);
+
+	if (--mintrav <= 0){
+		SprInsertion ins = {q, up};
+		insertions.push_back(ins);
+	}
+
+	if ((q->number > tr->mxtips) && (--maxtrav > 0))
+	{
+		nodeptr
+			q1 = q->next->back,
+			q2 = q->next->next->back;
+		// the subtree behind q1->back consists of q2 and the one behind q->back
+		int
+			up1 = addUpVector(ups, q2->number, up, -1),
+			up2 = addUpVector(ups, q1->number, up, -1);
+
+		collectInsertionsParsimony(tr, q1, up1, mintrav, maxtrav, insertions, visited, ups);
+		collectInsertionsParsimony(tr, q2, up2, mintrav, maxtrav, insertions, visited, ups);
+	}
+}
+
+/**
+ * score the insertion of the subtree 'pruned' into each branch of insertions by several
+ * threads, without changing the tree; the node vectors used by ups must be up to date.
+ * Each thread takes a contiguous run of insertions and computes the subtrees behind them
+ * into its own ring of scratch vectors, so the preorder of insertions mostly finds
+ * the parent of the next subtree still there.
+ * @param pruned index of the parsimony vector of the inserted subtree
+ * @param scores (OUT) score of each insertion, not exact if larger than tr->bestParsimony
+ */
+static void scoreInsertionsParallel(pllInstance *tr, partitionList *pr, int pruned,
+		vector<SprInsertion> &insertions, vector<SprUpVector> &ups, vector<unsigned int> &scores)
+{
+	int ninsertions = insertions.size();
+	scores.resize(ninsertions);
+
+	PllSearchState state;
+	state.capture(pllRemainderLowerBounds, doing_stepwise_addition);
+	// the scratch vectors of the calling thread, sprScratchNumber and sprUpSlots are thread-local
+	int first_scratch = sprScratchNumber;
+	int nslots = sprUpSlots;
+
+#pragma omp parallel num_threads(state.params->num_threads)
+	{
+		state.apply(pllRemainderLowerBounds, doing_stepwise_addition);
+
+		// the scores are compared with the best one found before this round:
+		// moves stopped early by the lower bounds lose against the later best scores, too
+		pllInstance thread_tr = *tr;
+		int thread_ti[8];
+		int first_up = first_scratch + omp_get_thread_num() * (nslots + 1);
+		int cur = first_up + nslots;
+		vector<int> slot_up(nslots, -1);
+		thread_tr.ti = thread_ti;
+
+#pragma omp for schedule(static)
+		for (int i = 0; i < ninsertions; i++) {
+			// cur = (q, up), then evaluate the branch cur-pruned
+			int up = threadUpVector(&thread_tr, pr, ups, insertions[i].up, first_up, slot_up);
+			thread_ti[0] = 8;
+			thread_ti[1] = cur;
+			thread_ti[2] = pruned;
+			thread_ti[4] = cur;
+			thread_ti[5] = insertions[i].q->number;
+			thread_ti[6] = up;
+			scores[i] = evaluateParsimonyIterativeFast(&thread_tr, pr, 0, thread_tr.bestParsimony);
+		}
+
+		PllSearchState::release(pllRemainderLowerBounds);
+	}
+
+}
+
+/**
+ * multithreaded version of the addTraverseParsimony() calls of rearrangeParsimony(),
+ * giving the same tr->bestParsimony, tr->insertNode and tr->removeNode.
+ * p is pruned, its former neighbours p1 and p2 are joined.
+ * The vectors of all subtrees below the regraft positions are first brought up to date,
+ * then the threads score the positions with their own scratch vectors, without changing the tree.
+ */
+static void addTraverseParsimonyParallel(pllInstance *tr, partitionList *pr, nodeptr p, nodeptr p1, nodeptr p2, int mintrav, int maxtrav)
+{
+	vector<SprInsertion> insertions;
+	vector<nodeptr> visited;
+	vector<SprUpVector> ups;
+
+	visited.push_back(p->back);
+	visited.push_back(p1);
+	visited.push_back(p2);
+
+	for (int side = 0; side < 2; side++) {
+		nodeptr
+			r = (side == 0) ? p1 : p2,
+			other = (side == 0) ? p2 : p1;
+		if (r->number <= tr->mxtips)
+			continue;
+		nodeptr
+			r1 = r->next->back,
+			r2 = r->next->next->back;
+		int
+			up1 = addUpVector(ups, r2->number, -1, other->number),
+			up2 = addUpVector(ups, r1->number, -1, other->number);
+		collectInsertionsParsimony(tr, r1, up1, mintrav, maxtrav, insertions, visited, ups);
+		collectInsertionsParsimony(tr, r2, up2, mintrav, maxtrav, insertions, visited, ups);
+	}
+
+	// bring the vectors of the pruned subtree and of all subtrees below the regraft positions
+	// (oriented towards p1-p2) up to date
+	int counter = 4;
+	for (vector<nodeptr>::iterator it = visited.begin(); it != visited.end(); it++)
+		if((*it)->number > tr->mxtips && !(*it)->xPars)
+			computeTraversalInfoParsimony(*it, tr->ti, &counter, tr->mxtips, PLL_FALSE, 0);
+	tr->ti[0] = counter;
+	if(counter > 4)
+		newviewParsimonyIterativeFast(tr, pr, 0);
+
+	vector<unsigned int> scores;
+	scoreInsertionsParallel(tr, pr, p->back->number, insertions, ups, scores);
+
+	for (int i = 0; i < insertions.size(); i++)
+		updateBestInsertion(tr, p, insertions[i].q, scores[i]);
+}
+
+/**
+ * append to ti the computation of the vectors of q and the internal nodes below it,
+ * oriented away from q->back, that are not up to date
+ */
+static void computeTraversalInfoDown(pllInstance *tr, nodeptr q, int *ti, int *counter)
+{
+	if (q->number <= tr->mxtips)
+		return;
+	if (!q->xPars)
+		computeTraversalInfoParsimony(q, ti, counter, tr->mxtips, PLL_FALSE, 0);
+	computeTraversalInfoDown(tr, q->next->back, ti, counter);
+	computeTraversalInfoDown(tr, q->next->next->back, ti, counter);
+}
+
+/**
+ * list the branches tested by stepwiseAddition(tr, pr, p, q) in the same order,
+ * and append to ups the subtrees behind each of them
+ */
+static void collectStepwiseInsertions(pllInstance *tr, nodeptr q, int up,
+		vector<SprInsertion> &insertions, vector<SprUpVector> &ups)
+{
+	SprInsertion ins = {q, up};
+	insertions.push_back(ins);
+
+	if (q->number > tr->mxtips && tr->parsimonyScore[q->number] > 0)
+	{
+		nodeptr
+			q1 = q->next->back,
+			q2 = q->next->next->back;
+		int
+			up1 = addUpVector(ups, q2->number, up, -1),
+			up2 = addUpVector(ups, q1->number, up, -1);
+
+		collectStepwiseInsertions(tr, q1, up1, insertions, ups);
+		collectStepwiseInsertions(tr, q2, up2, insertions, ups);
+	}
+}
+
+/**
+ * multithreaded version of stepwiseAddition(tr, pr, p, f->back),
+ * giving the same tr->bestParsimony and tr->insertNode.
+ * The vectors below every branch (oriented away from the tip f) are first brought
+ * up to date, then the threads score the branches without changing the tree.
+ * The scores are compared in the order of stepwiseAddition(), so the ties draw
+ * the same random numbers.
+ */
+static void stepwiseAdditionParallel(pllInstance *tr, partitionList *pr, nodeptr p, nodeptr f)
+{
+	int counter = 4;
+	computeTraversalInfoDown(tr, f->back, tr->ti, &counter);
+	tr->ti[0] = counter;
+	if(counter > 4)
+		newviewParsimonyIterativeFast(tr, pr, 0);
+
+	vector<SprInsertion> insertions;
+	vector<SprUpVector> ups;
+	// the subtree behind the first branch is the tip f itself
+	int root = addUpVector(ups, -1, -1, f->number);
+	collectStepwiseInsertions(tr, f->back, root, insertions, ups);
+
+	vector<unsigned int> scores;
+	scoreInsertionsParallel(tr, pr, p->back->number, insertions, ups, scores);
+
+	for (int i = 0; i < insertions.size(); i++) {
+		unsigned int mp = scores[i];
+
+		if(mp < tr->bestParsimony) bestTreeScoreHits = 1;
+		else if(mp == tr->bestParsimony) bestTreeScoreHits++;
+
+		if((mp < tr->bestParsimony) || ((mp == tr->bestParsimony) && (random_double() <= 1.0 / bestTreeScoreHits)))
+		{
+			tr->bestParsimony = mp;
+			tr->insertNode = insertions[i].q;
+		}
+	}
+}
+
+#endif // _OPENMP
+
 
 static void makePermutationFast(int *perm, int n, pllInstance *tr)
 {
@@ -2429,7 +2850,12 @@ static int rearrangeParsimony(pllInstance *tr, partitionList *pr, nodeptr p, int
 
   q = p->back;
 
-	unsigned int mp = evaluateParsimony(tr, pr, p, PLL_FALSE, perSiteScores); // Diep: This is VERY important to make sure SPR is accurate*****
+#ifdef _OPENMP
+  // regraft positions are scored by several threads if the scratch vectors were allocated
+  pllBoolean multithreaded = sprScratchNumber && !perSiteScores && !tr->grouped && !omp_in_parallel();
+#endif
+
+	unsigned int mp = evaluateParsimony(tr, pr, p, PLL_FALSE, perSiteScores, UINT_MAX); // Diep: This is VERY important to make sure SPR is accurate*****
 	if(perSiteScores){
 		// If UFBoot is enabled ...
 		pllSaveCurrentTreeSprParsimony(tr, pr, mp); // run UFBoot
@@ -2457,6 +2883,12 @@ static int rearrangeParsimony(pllInstance *tr, partitionList *pr, nodeptr p, int
           //removeNodeParsimony(p, tr);
           removeNodeParsimony(p);
 
+#ifdef _OPENMP
+          if (multithreaded && !doAll)
+            addTraverseParsimonyParallel(tr, pr, p, p1, p2, mintrav, maxtrav);
+          else
+#endif
+          {
           if ((p1->number > tr->mxtips))
             {
               addTraverseParsimony(tr, pr, p, p1->next->back, mintrav, maxtrav, doAll, PLL_FALSE, perSiteScores);
@@ -2468,6 +2900,7 @@ static int rearrangeParsimony(pllInstance *tr, partitionList *pr, nodeptr p, int
               addTraverseParsimony(tr, pr, p, p2->next->back, mintrav, maxtrav, doAll, PLL_FALSE, perSiteScores);
               addTraverseParsimony(tr, pr, p, p2->next->next->back, mintrav, maxtrav, doAll, PLL_FALSE, perSiteScores);
             }
+          }
 
 
           hookupDefault(p->next,       p1);
@@ -2500,6 +2933,12 @@ static int rearrangeParsimony(pllInstance *tr, partitionList *pr, nodeptr p, int
 
           mintrav2 = mintrav > 2 ? mintrav : 2;
 
+#ifdef _OPENMP
+          if (multithreaded && !doAll)
+            addTraverseParsimonyParallel(tr, pr, q, q1, q2, mintrav2, maxtrav);
+          else
+#endif
+          {
           if ((q1->number > tr->mxtips))
             {
               addTraverseParsimony(tr, pr, q, q1->next->back, mintrav2 , maxtrav, doAll, PLL_FALSE, perSiteScores);
@@ -2511,6 +2950,7 @@ static int rearrangeParsimony(pllInstance *tr, partitionList *pr, nodeptr p, int
               addTraverseParsimony(tr, pr, q, q2->next->back, mintrav2 , maxtrav, doAll, PLL_FALSE, perSiteScores);
               addTraverseParsimony(tr, pr, q, q2->next->next->back, mintrav2 , maxtrav, doAll, PLL_FALSE, perSiteScores);
             }
+          }
 
           hookupDefault(q->next,       q1);
           hookupDefault(q->next->next, q2);
@@ -2789,7 +3229,7 @@ static void compressSankoffDNA(pllInstance *tr, partitionList *pr, int *informat
     i,
     model;
 
-  totalNodes = 2 * (size_t)tr->mxtips;
+  totalNodes = parsimonyVectorCount(tr, perSiteScores);
 
 
   for(model = 0; model < (size_t) pr->numberOfPartitions; model++)
@@ -2827,18 +3267,18 @@ static void compressSankoffDNA(pllInstance *tr, partitionList *pr, int *informat
 	// for a certain node of DNA: ptn1_A, ptn2_A, ptn3_A,..., ptn1_C, ptn2_C, ptn3_C,...,ptn1_G, ptn2_G, ptn3_G,...,ptn1_T, ptn2_T, ptn3_T,...,
 	// (not 100% sure) this is also the perSitePartialPars
 
-      rax_posix_memalign ((void **) &(pr->partitionData[model]->parsVect), PLL_BYTE_ALIGNMENT, (size_t)compressedEntriesPadded * states * totalNodes * sizeof(parsimonyNumber));
+      pllReserveParsimonyBuffer((void **) &(pr->partitionData[model]->parsVect), &(pr->partitionData[model]->parsVectSize), (size_t)compressedEntriesPadded * states * totalNodes * sizeof(parsimonyNumber));
         memset(pr->partitionData[model]->parsVect, 0, compressedEntriesPadded * states * totalNodes * sizeof(parsimonyNumber));
 
       //Here, without option -short_off, Numeric is 'usigned short'. So, only first half of array 'informativePtnWgt' is allocated
       //and we can not directly access this array's elements. A proposed way is creating a reference with type cast:
       //Numeric *ptnWgt = (Numeric*)pr->partitionData[model]->informativePtnWgt;
-      rax_posix_memalign ((void **) &(pr->partitionData[model]->informativePtnWgt), PLL_BYTE_ALIGNMENT, (size_t)compressedEntriesPadded * sizeof(Numeric));
+      pllReserveParsimonyBuffer((void **) &(pr->partitionData[model]->informativePtnWgt), &(pr->partitionData[model]->informativePtnWgtSize), (size_t)compressedEntriesPadded * sizeof(Numeric));
 
         memset(pr->partitionData[model]->informativePtnWgt, 0, (size_t)compressedEntriesPadded * sizeof(Numeric));
 
       if(perSiteScores){
-			rax_posix_memalign ((void **) &(pr->partitionData[model]->informativePtnScore), PLL_BYTE_ALIGNMENT, (size_t)compressedEntriesPadded * sizeof(Numeric));
+			pllReserveParsimonyBuffer((void **) &(pr->partitionData[model]->informativePtnScore), &(pr->partitionData[model]->informativePtnScoreSize), (size_t)compressedEntriesPadded * sizeof(Numeric));
             memset(pr->partitionData[model]->informativePtnScore, 0, (size_t)compressedEntriesPadded * sizeof(Numeric));
       }
 
@@ -2940,34 +3380,37 @@ static void compressSankoffDNA(pllInstance *tr, partitionList *pr, int *informat
 
 	// TODO: remove this for Sankoff?
 
-	rax_posix_memalign ((void **) &(tr->parsimonyScore), PLL_BYTE_ALIGNMENT, sizeof(unsigned int) * totalNodes);
+	pllReserveParsimonyBuffer((void **) &(tr->parsimonyScore), &(tr->parsimonyScoreSize), sizeof(unsigned int) * totalNodes);
 
 	for(i = 0; i < totalNodes; i++)
 		tr->parsimonyScore[i] = 0;
 
-	if((!perSiteScores) && pllRepsSegments > 1){
-		// compute lower-bound if not currently extracting per site score AND having > 1 segments
-		pllRemainderLowerBounds = new parsimonyNumber[pllRepsSegments - 1]; // last segment does not need lower bound
-		assert(iqtree != NULL);
+	if(pllRemainderLowerBounds){
+		delete [] pllRemainderLowerBounds;
+		pllRemainderLowerBounds = NULL;
+	}
+	// the lower bounds come from the MST scores of a ParsTree, without them
+	// the Sankoff evaluations are not stopped early
+	ParsTree *pars_tree = dynamic_cast<ParsTree *>(iqtree);
+	if(!perSiteScores && pars_tree){
+		// compute lower-bound if not currently extracting per site score
 		int partitionId = 0;
 		int ptn;
 		int nptn = iqtree->aln->n_informative_patterns;
 		int * min_ptn_pars = new int[nptn];
+		pllRemainderLowerBounds = new parsimonyNumber[nptn + 1];
 
 		for(ptn = 0; ptn < nptn; ptn++)
-			min_ptn_pars[ptn] = dynamic_cast<ParsTree *>(iqtree)->findMstScore(ptn);
+			min_ptn_pars[ptn] = pars_tree->findMstScore(ptn);
 
     Numeric *ptnWgt = (Numeric*)pr->partitionData[partitionId]->informativePtnWgt;
-		for(int seg = 0; seg < pllRepsSegments - 1; seg++){
-			pllRemainderLowerBounds[seg] = 0;
-			for(ptn = pllSegmentUpper[seg]; ptn < nptn; ptn++){
-				pllRemainderLowerBounds[seg] += min_ptn_pars[ptn] * ptnWgt[ptn];
-			}
-		}
+		// lower bound of the patterns from ptn to the end
+		pllRemainderLowerBounds[nptn] = 0;
+		for(ptn = nptn - 1; ptn >= 0; ptn--)
+			pllRemainderLowerBounds[ptn] = pllRemainderLowerBounds[ptn + 1] + min_ptn_pars[ptn] * ptnWgt[ptn];
 
 		delete [] min_ptn_pars;
-	}else
-		pllRemainderLowerBounds = NULL;
+	}
 
 }
 
@@ -2987,7 +3430,7 @@ static void compressDNA(pllInstance *tr, partitionList *pr, int *informative, in
     i,
     model;
 
-  totalNodes = 2 * (size_t)tr->mxtips;
+  totalNodes = parsimonyVectorCount(tr, perSiteScores);
 
 
 
@@ -3029,7 +3472,7 @@ static void compressDNA(pllInstance *tr, partitionList *pr, int *informative, in
 #endif
 
 
-      rax_posix_memalign ((void **) &(pr->partitionData[model]->parsVect), PLL_BYTE_ALIGNMENT, (size_t)compressedEntriesPadded * states * totalNodes * sizeof(parsimonyNumber));
+      pllReserveParsimonyBuffer((void **) &(pr->partitionData[model]->parsVect), &(pr->partitionData[model]->parsVectSize), (size_t)compressedEntriesPadded * states * totalNodes * sizeof(parsimonyNumber));
 
       for(i = 0; i < compressedEntriesPadded * states * totalNodes; i++)
         pr->partitionData[model]->parsVect[i] = 0;
@@ -3037,7 +3480,7 @@ static void compressDNA(pllInstance *tr, partitionList *pr, int *informative, in
       if (perSiteScores)
        {
          /* for per site parsimony score at each node */
-         rax_posix_memalign ((void **) &(pr->partitionData[model]->perSitePartialPars), PLL_BYTE_ALIGNMENT, totalNodes * (size_t)compressedEntriesPadded * PLL_PCF * sizeof (parsimonyNumber));
+         pllReserveParsimonyBuffer((void **) &(pr->partitionData[model]->perSitePartialPars), &(pr->partitionData[model]->perSitePartialParsSize), totalNodes * (size_t)compressedEntriesPadded * PLL_PCF * sizeof (parsimonyNumber));
          for (i = 0; i < totalNodes * (size_t)compressedEntriesPadded * PLL_PCF; ++i)
         	 pr->partitionData[model]->perSitePartialPars[i] = 0;
        }
@@ -3113,7 +3556,7 @@ static void compressDNA(pllInstance *tr, partitionList *pr, int *informative, in
       rax_free(compressedValues);
     }
 
-  rax_posix_memalign ((void **) &(tr->parsimonyScore), PLL_BYTE_ALIGNMENT, sizeof(unsigned int) * totalNodes);
+  pllReserveParsimonyBuffer((void **) &(tr->parsimonyScore), &(tr->parsimonyScoreSize), sizeof(unsigned int) * totalNodes);
 
   for(i = 0; i < totalNodes; i++)
     tr->parsimonyScore[i] = 0;
@@ -3143,7 +3586,7 @@ static void stepwiseAddition(pllInstance *tr, partitionList *pr, nodeptr p, node
   tr->ti[1] = p->number;
   tr->ti[2] = p->back->number;
 
-  mp = evaluateParsimonyIterativeFast(tr, pr, PLL_FALSE);
+  mp = evaluateParsimonyIterativeFast(tr, pr, PLL_FALSE, tr->bestParsimony);
 
   if(mp < tr->bestParsimony) bestTreeScoreHits = 1;
   else if(mp == tr->bestParsimony) bestTreeScoreHits++;
@@ -3166,6 +3609,11 @@ static void stepwiseAddition(pllInstance *tr, partitionList *pr, nodeptr p, node
 }
 
 
+/**
+ * set the PLL pattern weights to the pattern frequencies of iqtree->aln,
+ * which has the same patterns in the same order as the PLL alignment
+ * (ratchet and bootstrap alignments only change the frequencies)
+ */
 void _updateInternalPllOnRatchet(pllInstance *tr, partitionList *pr){
 //	cout << "lower = " << pr->partitionData[0]->lower << ", upper = " << pr->partitionData[0]->upper << ", aln->size() = " << iqtree->aln->size() << endl;
 	for(int i = 0; i < pr->numberOfPartitions; i++){
@@ -3182,13 +3630,7 @@ void _allocateParsimonyDataStructures(pllInstance *tr, partitionList *pr, int pe
 	  int * informative = (int *)rax_malloc(sizeof(int) * (size_t)tr->originalCrunchedLength);
 	  determineUninformativeSites(tr, pr, informative);
 
-	  if(pllCostMatrix){
-		for(int i = 0; i < pr->numberOfPartitions; i++){
-			pr->partitionData[i]->informativePtnWgt = NULL;
-			pr->partitionData[i]->informativePtnScore = NULL;
-		}
-	  }
-
+	  // the vectors of a previous call are reused if they are large enough
 	  compressDNA(tr, pr, informative, perSiteScores);
 
 	  for(i = tr->mxtips + 1; i <= tr->mxtips + tr->mxtips - 1; i++)
@@ -3201,7 +3643,8 @@ void _allocateParsimonyDataStructures(pllInstance *tr, partitionList *pr, int pe
 	      p->next->next->xPars = 0;
 	    }
 
-	  tr->ti = (int*)rax_malloc(sizeof(int) * 4 * (size_t)tr->mxtips);
+	  if(tr->ti == NULL)
+		  tr->ti = (int*)rax_malloc(sizeof(int) * 4 * (size_t)tr->mxtips);
 
 	  rax_free(informative);
 }
@@ -3215,6 +3658,7 @@ void _pllFreeParsimonyDataStructures(pllInstance *tr, partitionList *pr)
 	  rax_free(tr->parsimonyScore);
 	  tr->parsimonyScore = NULL;
   }
+  tr->parsimonyScoreSize = 0;
 
   for(model = 0; model < (size_t) pr->numberOfPartitions; ++model){
 	  if(pr->partitionData[model]->parsVect != NULL){
@@ -3225,28 +3669,28 @@ void _pllFreeParsimonyDataStructures(pllInstance *tr, partitionList *pr)
 		  rax_free(pr->partitionData[model]->perSitePartialPars);
 		  pr->partitionData[model]->perSitePartialPars = NULL;
 	  }
+	  if(pr->partitionData[model]->informativePtnWgt != NULL){
+		  rax_free(pr->partitionData[model]->informativePtnWgt);
+		  pr->partitionData[model]->informativePtnWgt = NULL;
+	  }
+	  if(pr->partitionData[model]->informativePtnScore != NULL){
+		  rax_free(pr->partitionData[model]->informativePtnScore);
+		  pr->partitionData[model]->informativePtnScore = NULL;
+	  }
+	  pr->partitionData[model]->parsVectSize = 0;
+	  pr->partitionData[model]->perSitePartialParsSize = 0;
+	  pr->partitionData[model]->informativePtnWgtSize = 0;
+	  pr->partitionData[model]->informativePtnScoreSize = 0;
   }
 
   if(tr->ti != NULL){
 	  rax_free(tr->ti);
 	  tr->ti = NULL;
   }
-  if(pllCostMatrix){
-		for(int i = 0; i < pr->numberOfPartitions; i++){
-			if(pr->partitionData[i]->informativePtnWgt != NULL){
-				rax_free(pr->partitionData[i]->informativePtnWgt);
-				pr->partitionData[i]->informativePtnWgt = NULL;
-			}
-			if(pr->partitionData[i]->informativePtnScore != NULL){
-				rax_free(pr->partitionData[i]->informativePtnScore);
-				pr->partitionData[i]->informativePtnScore = NULL;
-			}
-		}
-		if(pllRemainderLowerBounds){
-			delete [] pllRemainderLowerBounds;
-			pllRemainderLowerBounds = NULL;
-		}
-	}
+  if(pllRemainderLowerBounds){
+	  delete [] pllRemainderLowerBounds;
+	  pllRemainderLowerBounds = NULL;
+  }
 
 }
 
@@ -3299,6 +3743,12 @@ static void _pllMakeParsimonyTreeFast(pllInstance *tr, partitionList *pr, int sp
           tr->constraintVector[number] = -9;
         }
 
+#ifdef _OPENMP
+      // the branches are scored by several threads if the scratch vectors were allocated
+      if (sprScratchNumber && !omp_in_parallel())
+        stepwiseAdditionParallel(tr, pr, q, f);
+      else
+#endif
       stepwiseAddition(tr, pr, q, f->back);
 //      cout << "tr->ntips = " << tr->ntips << endl;
 
@@ -3393,14 +3843,16 @@ int pllOptimizeSprParsimony(pllInstance * tr, partitionList * pr, int mintrav, i
 
 	iqtree = _iqtree; // update pointer to IQTree
 
-	if(globalParam->ratchet_iter >= 0 && (iqtree->on_ratchet_hclimb1 || iqtree->on_ratchet_hclimb2)){
+	if((globalParam->ratchet_iter >= 0 && (iqtree->on_ratchet_hclimb1 || iqtree->on_ratchet_hclimb2)) || iqtree->on_opt_btree){
 		// oct 23: in non-ratchet iteration, allocate is not triggered
+		// the ratchet and bootstrap alignments reweight the patterns of the PLL alignment,
+		// the tips are compressed again into the vectors of the previous search
 		_updateInternalPllOnRatchet(tr, pr);
 		_allocateParsimonyDataStructures(tr, pr, perSiteScores);
-	}else if(first_call || (iqtree && iqtree->on_opt_btree))
+	}else if(first_call)
 		_allocateParsimonyDataStructures(tr, pr, perSiteScores); // called once if not running ratchet
 
-	if(first_call){
+	if(first_call && !iqtree->on_opt_btree){
 		first_call = false;
 	}
 
@@ -3421,7 +3873,7 @@ int pllOptimizeSprParsimony(pllInstance * tr, partitionList * pr, int mintrav, i
 
 	nodeRectifierPars(tr);
 	tr->bestParsimony = UINT_MAX;
-	tr->bestParsimony = evaluateParsimony(tr, pr, tr->start, PLL_TRUE, perSiteScores);
+	tr->bestParsimony = evaluateParsimony(tr, pr, tr->start, PLL_TRUE, perSiteScores, UINT_MAX);
 
 	assert(-iqtree->curScore == tr->bestParsimony);
 
@@ -3429,7 +3881,7 @@ int pllOptimizeSprParsimony(pllInstance * tr, partitionList * pr, int mintrav, i
 	/*
 	// Diep: to be investigated
 	tr->bestParsimony = -iqtree->logl_cutoff;
-	evaluateParsimony(tr, pr, tr->start, PLL_TRUE, perSiteScores);
+	evaluateParsimony(tr, pr, tr->start, PLL_TRUE, perSiteScores, UINT_MAX);
 	*/
 
 	int j;
@@ -3772,7 +4224,7 @@ void computeUserTreeParsimomy(Params &params) {
         pllNewickParseDestroy(&pll_tree);
 		_allocateParsimonyDataStructures(ptree->pllInst, ptree->pllPartitions, false);
 		ptree->pllInst->bestParsimony = UINT_MAX; // Important because of early termination in evaluateSankoffParsimonyIterativeFastSIMD
-		unsigned int pll_score = evaluateParsimony(ptree->pllInst, ptree->pllPartitions, ptree->pllInst->start, PLL_TRUE, false);
+		unsigned int pll_score = evaluateParsimony(ptree->pllInst, ptree->pllPartitions, ptree->pllInst->start, PLL_TRUE, false, UINT_MAX);
 		cout << "Parsimony score (by PLL kernel) is: " << pll_score << endl;
 
 
@@ -3796,7 +4248,7 @@ void computeUserTreeParsimomy(Params &params) {
         pllNewickParseDestroy(&pll_tree);
 		_allocateParsimonyDataStructures(ptree->pllInst, ptree->pllPartitions, false);
 		ptree->pllInst->bestParsimony = UINT_MAX; // Important because of early termination in evaluateSankoffParsimonyIterativeFastSIMD
-		unsigned int pll_score = evaluateParsimony(ptree->pllInst, ptree->pllPartitions, ptree->pllInst->start, PLL_TRUE, false);
+		unsigned int pll_score = evaluateParsimony(ptree->pllInst, ptree->pllPartitions, ptree->pllInst->start, PLL_TRUE, false, UINT_MAX);
 		cout << "Parsimony score (by PLL kernel) is: " << pll_score << endl;
 
 
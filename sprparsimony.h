@@ -12,6 +12,57 @@
 
 void resetGlobalParamOnNewAln(); // Diep 2021-12-28: This serves analysis composed of multiple runs (such as SBS);
 
+/**
+ * resetGlobalParamOnNewAln() for the thread-local state of the calling thread only,
+ * leaving the vectorized cost matrix shared by all threads alone
+ */
+void resetThreadParamOnNewAln();
+
+/**
+ * build the vectorized cost matrix shared by all threads if it does not exist yet,
+ * call it before a parallel region whose threads search with a cost matrix
+ * @param cost_matrix cost from state i to j at i*nstates+j
+ * @param short_int true for -short_int
+ */
+void initializeVectorCostMatrix(unsigned int *cost_matrix, int nstates, bool short_int);
+
+/**
+ * the thread-local state of the PLL parsimony search, which the threads of a parallel
+ * region take over from the calling thread: capture() it before the region, apply() it
+ * in each thread, and apply() it again in the calling thread afterwards
+ */
+struct PllSearchState {
+	Params *params;
+	parsimonyNumber *cost_matrix;
+	int cost_nstates;
+	int reps_segments;
+	int *segment_upper;
+	/** lower bounds and stepwise addition flag of the SPR or TBR search, each file keeps its own */
+	parsimonyNumber *remainder_lower_bounds;
+	bool stepwise_addition;
+
+	/** save the state shared by the SPR and TBR searches of the calling thread */
+	void capture();
+
+	/** capture() plus the lower bounds and stepwise addition flag of one search */
+	void capture(parsimonyNumber *lower_bounds, bool stepwise);
+
+	/** set the shared state in the calling thread */
+	void apply();
+
+	/**
+	 * apply() plus the lower bounds and stepwise addition flag of one search,
+	 * pass the thread-local variables of that search
+	 */
+	void apply(parsimonyNumber *&lower_bounds, bool &stepwise);
+
+	/**
+	 * at the end of the parallel region: the lower bounds are borrowed from the
+	 * calling thread, which frees them, so the other threads forget them
+	 */
+	static void release(parsimonyNumber *&lower_bounds);
+};
+
 /*
  * An alternative for pllComputeRandomizedStepwiseAdditionParsimonyTree
  * because the original one seems to have the wrong deallocation function
@@ -53,5 +104,15 @@ void convertNewickToNexus(Params &params);
 // act as pllAlignmentRemoveDups of PLL but for sorted alignment of IQTREE
 extern void pllSortedAlignmentRemoveDups (pllAlignmentData * alignmentData, partitionList * pl); /* Diep added */
 
+/**
+ * make sure *buf (aligned, allocated by rax_posix_memalign) holds at least new_size bytes.
+ * The old buffer is kept if it is large enough, so that the parsimony vectors of
+ * a PLL instance can be refilled for a reweighted alignment without reallocation.
+ * @param buf the buffer, may be NULL
+ * @param size bytes allocated for *buf, updated on reallocation
+ * @param new_size bytes needed
+ */
+void pllReserveParsimonyBuffer(void **buf, size_t *size, size_t new_size);
+
 
 #endif /* SPRPARSIMONY_H_ */
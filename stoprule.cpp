@@ -31,6 +31,7 @@ StopRule::StopRule() : CheckpointFactory()
 	max_iteration = 0;
 	unsuccess_iteration = 100;
 	min_correlation = 0.99;
+	correlation_stop = false;
 	step_iteration = 100;
 	start_real_time = -1.0;
 	cur_iteration = 1;
@@ -62,6 +63,7 @@ void StopRule::initialize(Params &params) {
 	max_iteration = params.max_iterations;
 	unsuccess_iteration = params.unsuccess_iteration;
 	min_correlation = params.min_correlation;
+	correlation_stop = params.boot_correlation_stop;
 	step_iteration = params.step_iterations;
 	start_real_time = getRealTime();
 	max_run_time = params.maxtime * 60; // maxtime is in minutes
@@ -109,7 +111,8 @@ bool StopRule::meetStopCondition(int cur_iteration, double cur_correlation) {
 		else
 			return cur_iteration > predicted_iteration;
 	case SC_UNSUCCESS_ITERATION:
-		return cur_iteration > getLastImprovedIteration() + unsuccess_iteration;
+		return cur_iteration > getLastImprovedIteration() + unsuccess_iteration ||
+				(correlation_stop && cur_correlation >= min_correlation);
 	case SC_BOOTSTRAP_CORRELATION:
 		return ((cur_correlation >= min_correlation) && (cur_iteration > getLastImprovedIteration() + unsuccess_iteration))
 				|| cur_iteration > max_iteration;
@@ -139,6 +139,9 @@ private:
 	/** bootstrap correlation threshold to stop */
 	double min_correlation;
 
+	/** TRUE to stop by unsuccessful iterations or by min_correlation, whichever comes first */
+	bool correlation_stop;
+
 	/** step size for checking bootstrap convergence */
 	int step_iteration;
 
@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <sprparsimony.h>
 #include <tbrparsimony.h>
+#include "parsimonykernel.h"
 
 #include "nnisearch.h"
 #include "parstree.h"
@@ -123,34 +124,46 @@
 #include "pllrepo/src/pll.h"
 #include "pllrepo/src/pllInternal.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 extern const unsigned int mask32[32];
 // /* vector-specific stuff */
 
 extern double masterTime;
 
 // /* program options */
-extern Params *globalParam;
-static IQTree *iqtree = NULL;
-static unsigned long bestTreeScoreHits; // to count hits to bestParsimony
-static unsigned int randomMP;
-
-extern parsimonyNumber *pllCostMatrix;    // Diep: For weighted version
-extern int pllCostNstates;                // Diep: For weighted version
+// search state is thread-local, see IQTree::refineBootTreesParallel()
+extern THREAD_LOCAL Params *globalParam;
+static THREAD_LOCAL IQTree *iqtree = NULL;
+static THREAD_LOCAL unsigned long bestTreeScoreHits; // to count hits to bestParsimony
+static THREAD_LOCAL unsigned int randomMP;
+
+extern THREAD_LOCAL parsimonyNumber *pllCostMatrix; // Diep: For weighted version
+extern THREAD_LOCAL int pllCostNstates;             // Diep: For weighted version
 extern parsimonyNumber *vectorCostMatrix; // BQM: vectorized cost matrix
-static parsimonyNumber highest_cost;
+static THREAD_LOCAL parsimonyNumber highest_cost;
 
 // //(if needed) split the parsimony vector into several segments to avoid
 // overflow when calc rell based on vec8us
-extern int pllRepsSegments;  // # of segments
-extern int *pllSegmentUpper; // array of first index of the next segment, see
-                             // IQTree::segment_upper
-static node **tbr_par = NULL;
-static bool *recalculate = NULL;
-static parsimonyNumber
-    *pllRemainderLowerBounds; // array of lower bound score for the
-                              // un-calculated part to the right of a segment
-static bool doing_stepwise_addition = false; // is the stepwise addition on
-static bool first_call = true;
+extern THREAD_LOCAL int pllRepsSegments;  // # of segments
+extern THREAD_LOCAL int *pllSegmentUpper; // array of first index of the next
+                                          // segment, see IQTree::segment_upper
+static THREAD_LOCAL node **tbr_par = NULL;
+static THREAD_LOCAL bool *recalculate = NULL;
+static THREAD_LOCAL parsimonyNumber
+    *pllRemainderLowerBounds; // array of lower bound score of the patterns
+                              // from each one to the end, see
+                              // compressSankoffDNA()
+// vectors of patterns scored by Sankoff between two checks of
+// pllRemainderLowerBounds
+static const size_t BOUND_CHECK_VECTORS = 4;
+static THREAD_LOCAL bool doing_stepwise_addition = false; // is the stepwise addition on
+static THREAD_LOCAL bool first_call = true;
+// index of the first scratch parsimony vector for the multithreaded TBR, 0 if
+// none
+static THREAD_LOCAL size_t tbrScratchNumber = 0;
 
 void _resetGlobalParamOnNewAln() {
     globalParam = NULL;
@@ -865,6 +878,7 @@ static void _newviewParsimonyIterativeFast(pllInstance *tr, partitionList *pr,
 
     INT_TYPE
     allOne = SET_ALL_BITS_ONE;
+    const ParsimonyKernel *parsKernel = getParsimonyKernel();
 
     int model, *ti = tr->ti, count = ti[0], index;
 
@@ -887,6 +901,15 @@ static void _newviewParsimonyIterativeFast(pllInstance *tr, partitionList *pr,
 
             unsigned int i;
 
+            if (parsKernel && !perSiteScores) {
+                totalScore += parsKernel->newview(
+                    &pr->partitionData[model]->parsVect[width * states * qNumber],
+                    &pr->partitionData[model]->parsVect[width * states * rNumber],
+                    &pr->partitionData[model]->parsVect[width * states * pNumber],
+                    states, width);
+                continue;
+            }
+
             switch (states) {
             case 2: {
                 parsimonyNumber *left[2], *right[2], *cur[2];
@@ -1121,6 +1144,11 @@ parsimonyNumber _evaluateSankoffParsimonyIterativeFastSIMD(pllInstance *tr,
 
     uint32_t total_sum = 0;
 
+    // Diep: IMPORTANT! since the pllRemainderLowerBounds is computed for full
+    // ntaxa the early termination must be disabled during stepwise addition
+    bool bounded = (!doing_stepwise_addition) && (!perSiteScores) &&
+                   pllRemainderLowerBounds;
+
     if (tr->ti[0] > 4)
         _newviewParsimonyIterativeFast(tr, pr, perSiteScores);
 
@@ -1167,12 +1195,6 @@ parsimonyNumber _evaluateSankoffParsimonyIterativeFastSIMD(pllInstance *tr,
                 // pattern)
                 if (perSiteScores) {
                     best_score.store_a(&ptnScore[i]);
-                } else {
-                    // TODO without having to store per site score AND finished
-                    // a block of patterns then use the lower-bound to stop
-                    // early if current_score + lower_bound_remaining >
-                    // best_score then
-                    //     return current_score + lower_bound_remaining
                 }
 
                 if (BY_PATTERN)
@@ -1180,19 +1202,26 @@ parsimonyNumber _evaluateSankoffParsimonyIterativeFastSIMD(pllInstance *tr,
                 else
                     sum += best_score;
 
-                // if(sum >= bestScore)
-                // 		return sum;
+                // the patterns are sorted by decreasing parsimony, so the move
+                // is dropped as soon as the patterns left cannot make it the
+                // best one
+                size_t next = i + VectorClass::size();
+                if (bounded &&
+                    (next - lower) % (BOUND_CHECK_VECTORS * VectorClass::size()) ==
+                        0 &&
+                    next < upper) {
+                    parsimonyNumber est_score = total_sum + horizontal_add(sum) +
+                                                pllRemainderLowerBounds[next];
+                    if (est_score > tr->bestParsimony)
+                        return est_score;
+                }
             }
 
             total_sum += horizontal_add(sum);
 
-            // Diep: IMPORTANT! since the pllRemainderLowerBounds is computed
-            // for full ntaxa the following must be disabled during stepwise
-            // addition
-            if ((!doing_stepwise_addition) && (!perSiteScores) &&
-                (seg < pllRepsSegments - 1)) {
+            if (bounded && (seg < pllRepsSegments - 1)) {
                 parsimonyNumber est_score =
-                    total_sum + pllRemainderLowerBounds[seg];
+                    total_sum + pllRemainderLowerBounds[upper];
                 if (est_score > tr->bestParsimony) {
                     return est_score;
                 }
@@ -1205,7 +1234,8 @@ parsimonyNumber _evaluateSankoffParsimonyIterativeFastSIMD(pllInstance *tr,
 
 static unsigned int _evaluateParsimonyIterativeFast(pllInstance *tr,
                                                     partitionList *pr,
-                                                    int perSiteScores) {
+                                                    int perSiteScores,
+                                                    unsigned int bound) {
     if (pllCostMatrix) {
 //        return evaluateSankoffParsimonyIterativeFast(tr, pr, perSiteScores);
 #ifdef __AVX
@@ -1297,18 +1327,24 @@ static unsigned int _evaluateParsimonyIterativeFast(pllInstance *tr,
 
     INT_TYPE
     allOne = SET_ALL_BITS_ONE;
+    const ParsimonyKernel *parsKernel = getParsimonyKernel();
 
     size_t pNumber = (size_t)tr->ti[1], qNumber = (size_t)tr->ti[2];
 
     int model;
 
-    unsigned int bestScore = tr->bestParsimony, sum;
+    unsigned int sum;
 
     if (tr->ti[0] > 4)
         _newviewParsimonyIterativeFast(tr, pr, perSiteScores);
 
     sum = tr->parsimonyScore[pNumber] + tr->parsimonyScore[qNumber];
 
+    // the subtree scores are a lower bound of the score, so the patterns are
+    // counted only while the score may still reach the bound
+    if (sum > bound)
+        return sum;
+
     if (perSiteScores) {
         _resetPerSiteNodeScores(pr, tr->start->number);
         _addPerSiteSubtreeScores(pr, tr->start->number, pNumber, qNumber);
@@ -1318,6 +1354,16 @@ static unsigned int _evaluateParsimonyIterativeFast(pllInstance *tr,
         size_t k, states = pr->partitionData[model]->states,
                   width = pr->partitionData[model]->parsimonyLength, i;
 
+        if (parsKernel && !perSiteScores) {
+            sum += parsKernel->evaluate(
+                &pr->partitionData[model]->parsVect[width * states * qNumber],
+                &pr->partitionData[model]->parsVect[width * states * pNumber],
+                states, width, bound - sum);
+            if (sum > bound)
+                return sum;
+            continue;
+        }
+
         switch (states) {
         case 2: {
             parsimonyNumber *left[2], *right[2];
@@ -1344,8 +1390,8 @@ static unsigned int _evaluateParsimonyIterativeFast(pllInstance *tr,
                     storePerSiteNodeScores(pr, model, v_N, i,
                                            tr->start->number);
 
-                //                 if(sum >= bestScore)
-                //                   return sum;
+                if (sum > bound)
+                    return sum;
             }
         } break;
         case 4: {
@@ -1377,8 +1423,8 @@ static unsigned int _evaluateParsimonyIterativeFast(pllInstance *tr,
                 if (perSiteScores)
                     storePerSiteNodeScores(pr, model, v_N, i,
                                            tr->start->number);
-                //                 if(sum >= bestScore)
-                //                   return sum;
+                if (sum > bound)
+                    return sum;
             }
         } break;
         case 20: {
@@ -1410,8 +1456,8 @@ static unsigned int _evaluateParsimonyIterativeFast(pllInstance *tr,
                 if (perSiteScores)
                     storePerSiteNodeScores(pr, model, v_N, i,
                                            tr->start->number);
-                //                  if(sum >= bestScore)
-                //                    return sum;
+                if (sum > bound)
+                    return sum;
             }
         } break;
         default: {
@@ -1446,8 +1492,8 @@ static unsigned int _evaluateParsimonyIterativeFast(pllInstance *tr,
                 if (perSiteScores)
                     storePerSiteNodeScores(pr, model, v_N, i,
                                            tr->start->number);
-                //                 if(sum >= bestScore)
-                //                   return sum;
+                if (sum > bound)
+                    return sum;
             }
         }
         }
@@ -1631,6 +1677,7 @@ static void _newviewParsimonyIterativeFast(pllInstance *tr, partitionList *pr,
                                            int perSiteScores) {
     if (pllCostMatrix)
         return _newviewSankoffParsimonyIterativeFast(tr, pr, perSiteScores);
+    const ParsimonyKernel *parsKernel = getParsimonyKernel();
     int model, *ti = tr->ti, count = ti[0], index;
 
     for (index = 4; index < count; index += 4) {
@@ -1645,6 +1692,15 @@ static void _newviewParsimonyIterativeFast(pllInstance *tr, partitionList *pr,
 
             unsigned int i;
 
+            if (parsKernel && !perSiteScores) {
+                totalScore += parsKernel->newview(
+                    &pr->partitionData[model]->parsVect[width * states * qNumber],
+                    &pr->partitionData[model]->parsVect[width * states * rNumber],
+                    &pr->partitionData[model]->parsVect[width * states * pNumber],
+                    states, width);
+                continue;
+            }
+
             switch (states) {
             case 2: {
                 parsimonyNumber *left[2], *right[2], *cur[2];
@@ -1934,25 +1990,42 @@ static unsigned int _evaluateSankoffParsimonyIterativeFast(pllInstance *tr,
 
 static unsigned int _evaluateParsimonyIterativeFast(pllInstance *tr,
                                                     partitionList *pr,
-                                                    int perSiteScores) {
+                                                    int perSiteScores,
+                                                    unsigned int bound) {
     if (pllCostMatrix)
         return _evaluateSankoffParsimonyIterativeFast(tr, pr, perSiteScores);
+    const ParsimonyKernel *parsKernel = getParsimonyKernel();
 
     size_t pNumber = (size_t)tr->ti[1], qNumber = (size_t)tr->ti[2];
 
     int model;
 
-    unsigned int bestScore = tr->bestParsimony, sum;
+    unsigned int sum;
 
     if (tr->ti[0] > 4)
         _newviewParsimonyIterativeFast(tr, pr, perSiteScores);
 
     sum = tr->parsimonyScore[pNumber] + tr->parsimonyScore[qNumber];
 
+    // the subtree scores are a lower bound of the score, so the patterns are
+    // counted only while the score may still reach the bound
+    if (sum > bound)
+        return sum;
+
     for (model = 0; model < pr->numberOfPartitions; model++) {
         size_t k, states = pr->partitionData[model]->states,
                   width = pr->partitionData[model]->parsimonyLength, i;
 
+        if (parsKernel && !perSiteScores) {
+            sum += parsKernel->evaluate(
+                &pr->partitionData[model]->parsVect[width * states * qNumber],
+                &pr->partitionData[model]->parsVect[width * states * pNumber],
+                states, width, bound - sum);
+            if (sum > bound)
+                return sum;
+            continue;
+        }
+
         switch (states) {
         case 2: {
             parsimonyNumber t_A, t_C, t_N, *left[2], *right[2];
@@ -1972,8 +2045,8 @@ static unsigned int _evaluateParsimonyIterativeFast(pllInstance *tr,
 
                 sum += ((unsigned int)__builtin_popcount(t_N));
 
-                //                 if(sum >= bestScore)
-                //                   return sum;
+                if (sum > bound)
+                    return sum;
             }
         } break;
         case 4: {
@@ -1996,8 +2069,8 @@ static unsigned int _evaluateParsimonyIterativeFast(pllInstance *tr,
 
                 sum += ((unsigned int)__builtin_popcount(t_N));
 
-                //                 if(sum >= bestScore)
-                //                   return sum;
+                if (sum > bound)
+                    return sum;
             }
         } break;
         case 20: {
@@ -2023,8 +2096,8 @@ static unsigned int _evaluateParsimonyIterativeFast(pllInstance *tr,
 
                 sum += ((unsigned int)__builtin_popcount(t_N));
 
-                //                  if(sum >= bestScore)
-                //                    return sum;
+                if (sum > bound)
+                    return sum;
             }
         } break;
         default: {
@@ -2053,8 +2126,8 @@ static unsigned int _evaluateParsimonyIterativeFast(pllInstance *tr,
 
                 sum += ((unsigned int)__builtin_popcount(t_N));
 
-                //                 if(sum >= bestScore)
-                //                   return sum;
+                if (sum > bound)
+                    return sum;
             }
         }
         }
@@ -2065,9 +2138,14 @@ static unsigned int _evaluateParsimonyIterativeFast(pllInstance *tr,
 
 #endif
 
+/**
+ * @param bound the evaluation may stop once the score exceeds bound and return
+ * this partial score, UINT_MAX for the exact score (ignored by Sankoff
+ * parsimony)
+ */
 static unsigned int _evaluateParsimony(pllInstance *tr, partitionList *pr,
                                        nodeptr p, pllBoolean full,
-                                       int perSiteScores) {
+                                       int perSiteScores, unsigned int bound) {
     volatile unsigned int result;
     nodeptr q = p->back;
     int *ti = tr->ti, counter = 4;
@@ -2093,15 +2171,17 @@ static unsigned int _evaluateParsimony(pllInstance *tr, partitionList *pr,
 
     ti[0] = counter;
 
-    result = _evaluateParsimonyIterativeFast(tr, pr, perSiteScores);
+    result = _evaluateParsimonyIterativeFast(tr, pr, perSiteScores, bound);
 
     return result;
 }
 
-static unsigned int evaluateParsimonyTBR(pllInstance *tr, partitionList *pr,
-                                         nodeptr u, nodeptr v, nodeptr w,
-                                         int perSiteScores) {
-    volatile unsigned int result;
+/**
+ * fill tr->ti with the vectors to recompute for the branch w-w->back after u
+ * and v have been reconnected, and reroot the recalculation marks at w
+ */
+static void getTraversalInfoTBR(pllInstance *tr, nodeptr u, nodeptr v,
+                                nodeptr w, int perSiteScores) {
     nodeptr p = tr->curRoot;
     nodeptr q = tr->curRootBack;
     int *ti = tr->ti, counter = 4;
@@ -2116,7 +2196,16 @@ static unsigned int evaluateParsimonyTBR(pllInstance *tr, partitionList *pr,
     computeTraversalInfoParsimonyTBR(w->back, ti, &counter, tr->mxtips,
                                      perSiteScores);
     ti[0] = counter;
-    result = _evaluateParsimonyIterativeFast(tr, pr, perSiteScores);
+}
+
+/** @param bound see _evaluateParsimony() */
+static unsigned int evaluateParsimonyTBR(pllInstance *tr, partitionList *pr,
+                                         nodeptr u, nodeptr v, nodeptr w,
+                                         int perSiteScores,
+                                         unsigned int bound) {
+    volatile unsigned int result;
+    getTraversalInfoTBR(tr, u, v, w, perSiteScores);
+    result = _evaluateParsimonyIterativeFast(tr, pr, perSiteScores, bound);
     return result;
 }
 
@@ -2191,13 +2280,32 @@ static void determineUninformativeSites(pllInstance *tr, partitionList *pr,
 
     /* printf("Uninformative Patterns: %d\n", number); */
 }
+/**
+ * @return number of parsimony vectors to allocate: one per node (index 1 ..
+ * 2*mxtips-1), followed by the scratch vectors of pllTestTBRMovesParallel() if
+ * TBR moves are scored by several threads
+ */
+static size_t parsimonyVectorCount(pllInstance *tr, int perSiteScores) {
+    size_t count = 2 * (size_t)tr->mxtips;
+    tbrScratchNumber = 0;
+#ifdef _OPENMP
+    if (!perSiteScores && globalParam->num_threads > 1 && !omp_in_parallel()) {
+        // at most 1 vector per internal node of the two subtrees, 1 per branch
+        // and 2 per internal node for the subtrees behind the branches
+        tbrScratchNumber = count;
+        count += 5 * (size_t)tr->mxtips;
+    }
+#endif
+    return count;
+}
+
 template <class Numeric, const int VECSIZE>
 static void compressSankoffDNA(pllInstance *tr, partitionList *pr,
                                int *informative, int perSiteScores) {
     // cout << "Begin compressSankoffDNA()" << endl;
     size_t totalNodes, i, model;
 
-    totalNodes = 2 * (size_t)tr->mxtips;
+    totalNodes = parsimonyVectorCount(tr, perSiteScores);
 
     for (model = 0; model < (size_t)pr->numberOfPartitions; model++) {
         size_t k, states = (size_t)pr->partitionData[model]->states,
@@ -2233,10 +2341,11 @@ static void compressSankoffDNA(pllInstance *tr, partitionList *pr,
         // ptn2_C, ptn3_C,...,ptn1_G, ptn2_G, ptn3_G,...,ptn1_T, ptn2_T,
         // ptn3_T,..., (not 100% sure) this is also the perSitePartialPars
 
-        rax_posix_memalign((void **)&(pr->partitionData[model]->parsVect),
-                           PLL_BYTE_ALIGNMENT,
-                           (size_t)compressedEntriesPadded * states *
-                               totalNodes * sizeof(parsimonyNumber));
+        pllReserveParsimonyBuffer(
+            (void **)&(pr->partitionData[model]->parsVect),
+            &(pr->partitionData[model]->parsVectSize),
+            (size_t)compressedEntriesPadded * states * totalNodes *
+                sizeof(parsimonyNumber));
         memset(pr->partitionData[model]->parsVect, 0,
                compressedEntriesPadded * states * totalNodes *
                    sizeof(parsimonyNumber));
@@ -2246,18 +2355,18 @@ static void compressSankoffDNA(pllInstance *tr, partitionList *pr,
         // directly access this array's elements. A proposed way is creating a
         // reference with type cast: Numeric *ptnWgt =
         // (Numeric*)pr->partitionData[model]->informativePtnWgt;
-        rax_posix_memalign(
+        pllReserveParsimonyBuffer(
             (void **)&(pr->partitionData[model]->informativePtnWgt),
-            PLL_BYTE_ALIGNMENT,
+            &(pr->partitionData[model]->informativePtnWgtSize),
             (size_t)compressedEntriesPadded * sizeof(Numeric));
 
         memset(pr->partitionData[model]->informativePtnWgt, 0,
                (size_t)compressedEntriesPadded * sizeof(Numeric));
 
         if (perSiteScores) {
-            rax_posix_memalign(
+            pllReserveParsimonyBuffer(
                 (void **)&(pr->partitionData[model]->informativePtnScore),
-                PLL_BYTE_ALIGNMENT,
+                &(pr->partitionData[model]->informativePtnScoreSize),
                 (size_t)compressedEntriesPadded * sizeof(Numeric));
             memset(pr->partitionData[model]->informativePtnScore, 0,
                    (size_t)compressedEntriesPadded * sizeof(Numeric));
@@ -2363,40 +2472,41 @@ static void compressSankoffDNA(pllInstance *tr, partitionList *pr,
 
     // TODO: remove this for Sankoff?
 
-    rax_posix_memalign((void **)&(tr->parsimonyScore), PLL_BYTE_ALIGNMENT,
-                       sizeof(unsigned int) * totalNodes);
+    pllReserveParsimonyBuffer((void **)&(tr->parsimonyScore),
+                              &(tr->parsimonyScoreSize),
+                              sizeof(unsigned int) * totalNodes);
 
     for (i = 0; i < totalNodes; i++)
         tr->parsimonyScore[i] = 0;
 
-    if ((!perSiteScores) && pllRepsSegments > 1) {
-        // compute lower-bound if not currently extracting per site score AND
-        // having > 1 segments
-        pllRemainderLowerBounds =
-            new parsimonyNumber[pllRepsSegments -
-                                1]; // last segment does not need lower bound
-        assert(iqtree != NULL);
+    if (pllRemainderLowerBounds) {
+        delete[] pllRemainderLowerBounds;
+        pllRemainderLowerBounds = NULL;
+    }
+    // the lower bounds come from the MST scores of a ParsTree, without them
+    // the Sankoff evaluations are not stopped early
+    ParsTree *pars_tree = dynamic_cast<ParsTree *>(iqtree);
+    if (!perSiteScores && pars_tree) {
+        // compute lower-bound if not currently extracting per site score
         int partitionId = 0;
         int ptn;
         int nptn = iqtree->aln->n_informative_patterns;
         int *min_ptn_pars = new int[nptn];
+        pllRemainderLowerBounds = new parsimonyNumber[nptn + 1];
 
         for (ptn = 0; ptn < nptn; ptn++)
-            min_ptn_pars[ptn] =
-                dynamic_cast<ParsTree *>(iqtree)->findMstScore(ptn);
+            min_ptn_pars[ptn] = pars_tree->findMstScore(ptn);
 
         Numeric *ptnWgt =
             (Numeric *)pr->partitionData[partitionId]->informativePtnWgt;
-        for (int seg = 0; seg < pllRepsSegments - 1; seg++) {
-            pllRemainderLowerBounds[seg] = 0;
-            for (ptn = pllSegmentUpper[seg]; ptn < nptn; ptn++) {
-                pllRemainderLowerBounds[seg] += min_ptn_pars[ptn] * ptnWgt[ptn];
-            }
-        }
+        // lower bound of the patterns from ptn to the end
+        pllRemainderLowerBounds[nptn] = 0;
+        for (ptn = nptn - 1; ptn >= 0; ptn--)
+            pllRemainderLowerBounds[ptn] =
+                pllRemainderLowerBounds[ptn + 1] + min_ptn_pars[ptn] * ptnWgt[ptn];
 
         delete[] min_ptn_pars;
-    } else
-        pllRemainderLowerBounds = NULL;
+    }
 }
 
 static void compressDNA(pllInstance *tr, partitionList *pr, int *informative,
@@ -2412,7 +2522,7 @@ static void compressDNA(pllInstance *tr, partitionList *pr, int *informative,
 
     size_t totalNodes, i, model;
 
-    totalNodes = 2 * (size_t)tr->mxtips;
+    totalNodes = parsimonyVectorCount(tr, perSiteScores);
 
     for (model = 0; model < (size_t)pr->numberOfPartitions; model++) {
         size_t k, states = (size_t)pr->partitionData[model]->states,
@@ -2451,19 +2561,20 @@ static void compressDNA(pllInstance *tr, partitionList *pr, int *informative,
         compressedEntriesPadded = compressedEntries;
 #endif
 
-        rax_posix_memalign((void **)&(pr->partitionData[model]->parsVect),
-                           PLL_BYTE_ALIGNMENT,
-                           (size_t)compressedEntriesPadded * states *
-                               totalNodes * sizeof(parsimonyNumber));
+        pllReserveParsimonyBuffer(
+            (void **)&(pr->partitionData[model]->parsVect),
+            &(pr->partitionData[model]->parsVectSize),
+            (size_t)compressedEntriesPadded * states * totalNodes *
+                sizeof(parsimonyNumber));
 
         for (i = 0; i < compressedEntriesPadded * states * totalNodes; i++)
             pr->partitionData[model]->parsVect[i] = 0;
 
         if (perSiteScores) {
             /* for per site parsimony score at each node */
-            rax_posix_memalign(
+            pllReserveParsimonyBuffer(
                 (void **)&(pr->partitionData[model]->perSitePartialPars),
-                PLL_BYTE_ALIGNMENT,
+                &(pr->partitionData[model]->perSitePartialParsSize),
                 totalNodes * (size_t)compressedEntriesPadded * PLL_PCF *
                     sizeof(parsimonyNumber));
             for (i = 0;
@@ -2535,12 +2646,17 @@ static void compressDNA(pllInstance *tr, partitionList *pr, int *informative,
         rax_free(compressedValues);
     }
 
-    rax_posix_memalign((void **)&(tr->parsimonyScore), PLL_BYTE_ALIGNMENT,
-                       sizeof(unsigned int) * totalNodes);
+    pllReserveParsimonyBuffer((void **)&(tr->parsimonyScore),
+                              &(tr->parsimonyScoreSize),
+                              sizeof(unsigned int) * totalNodes);
 
     for (i = 0; i < totalNodes; i++)
         tr->parsimonyScore[i] = 0;
 }
+/**
+ * set the PLL pattern weights to the pattern frequencies of iqtree->aln,
+ * which has the same patterns in the same order as the PLL alignment
+ */
 static void _updateInternalPllOnRatchet(pllInstance *tr, partitionList *pr) {
     //	cout << "lower = " << pr->partitionData[0]->lower << ", upper = " <<
     // pr->partitionData[0]->upper << ", aln->size() = " << iqtree->aln->size()
@@ -2560,13 +2676,7 @@ void _allocateParsimonyDataStructuresTBR(pllInstance *tr, partitionList *pr,
         (int *)rax_malloc(sizeof(int) * (size_t)tr->originalCrunchedLength);
     determineUninformativeSites(tr, pr, informative);
 
-    if (pllCostMatrix) {
-        for (int i = 0; i < pr->numberOfPartitions; i++) {
-            pr->partitionData[i]->informativePtnWgt = NULL;
-            pr->partitionData[i]->informativePtnScore = NULL;
-        }
-    }
-
+    // the vectors of a previous call are reused if they are large enough
     compressDNA(tr, pr, informative, perSiteScores);
     // cout << "Allocate parismony data structures\n";
     for (i = 1; i <= tr->mxtips + tr->mxtips - 2; i++) {
@@ -2593,7 +2703,8 @@ void _allocateParsimonyDataStructuresTBR(pllInstance *tr, partitionList *pr,
         tbr_par[i] = NULL;
     }
 
-    tr->ti = (int *)rax_malloc(sizeof(int) * 4 * (size_t)tr->mxtips);
+    if (tr->ti == NULL)
+        tr->ti = (int *)rax_malloc(sizeof(int) * 4 * (size_t)tr->mxtips);
 
     rax_free(informative);
 }
@@ -2770,13 +2881,53 @@ static bool restoreTreeRearrangeParsimonyTBR(pllInstance *tr, partitionList *pr,
     q = (q->xPars ? q : q->back);
     r = (r->xPars ? r : r->back);
     assert(pllTbrConnectSubtrees(tr, q, r, &tr->TBR_removeBranch));
-    evaluateParsimonyTBR(tr, pr, q, r, tr->TBR_removeBranch, perSiteScores);
+    evaluateParsimonyTBR(tr, pr, q, r, tr->TBR_removeBranch, perSiteScores,
+                         UINT_MAX);
     tr->curRoot = tr->TBR_removeBranch;
     tr->curRootBack = tr->TBR_removeBranch->back;
 
     return PLL_TRUE;
 }
 
+/**
+ * connect branch1 and branch2 with freeBranch as in pllTestTBRMove()
+ * @return the branch to remove to undo the move
+ */
+static nodeptr pllConnectTBRMove(pllInstance *tr, nodeptr branch1,
+                                 nodeptr branch2, nodeptr *freeBranch) {
+    nodeptr tmpNode = branch1->back;
+
+    assert(pllTbrConnectSubtrees(tr, branch1, branch2, freeBranch));
+
+    if (branch1->back->next->back == tmpNode) {
+        return branch1->back->next->next;
+    } else {
+        return branch1->back->next;
+    }
+}
+
+/**
+ * keep the TBR move joining branch1 and branch2 as the best one if its score mp
+ * is better than tr->bestParsimony, or equal with probability 1/(number of
+ * equally good moves)
+ */
+static void updateBestTBRMove(pllInstance *tr, nodeptr branch1,
+                              nodeptr branch2, nodeptr removeBranch,
+                              unsigned int mp) {
+    if (mp < tr->bestParsimony)
+        bestTreeScoreHits = 1;
+    else if (mp == tr->bestParsimony)
+        bestTreeScoreHits++;
+    if ((mp < tr->bestParsimony) ||
+        ((mp == tr->bestParsimony) &&
+         (random_double() <= 1.0 / bestTreeScoreHits))) {
+        tr->bestParsimony = mp;
+        tr->TBR_insertBranch1 = branch1;
+        tr->TBR_insertBranch2 = branch2;
+        tr->TBR_removeBranch = removeBranch;
+    }
+}
+
 /** Based on PLL
  @brief Internal function for testing and saving a TBR move (if yeild better
  score)
@@ -2813,18 +2964,14 @@ static int pllTestTBRMove(pllInstance *tr, partitionList *pr, nodeptr branch1,
     branch2 = (branch2->xPars ? branch2 : branch2->back);
     freeBranch = ((*freeBranch)->xPars ? freeBranch : (&((*freeBranch)->back)));
     // assert((*freeBranch)->xPars);
-    nodeptr tmpNode = branch1->back;
-
-    assert(pllTbrConnectSubtrees(tr, branch1, branch2, freeBranch));
-
-    nodeptr TBR_removeBranch = NULL;
-    if (branch1->back->next->back == tmpNode) {
-        TBR_removeBranch = branch1->back->next->next;
-    } else {
-        TBR_removeBranch = branch1->back->next;
-    }
-    unsigned int mp = evaluateParsimonyTBR(tr, pr, branch1, branch2,
-                                           TBR_removeBranch, perSiteScores);
+    nodeptr TBR_removeBranch =
+        pllConnectTBRMove(tr, branch1, branch2, freeBranch);
+    // a move scoring worse than the best one is dropped by updateBestTBRMove()
+    // anyway, so its evaluation may stop once the bound is exceeded; UFBoot
+    // needs exact scores
+    unsigned int mp = evaluateParsimonyTBR(
+        tr, pr, branch1, branch2, TBR_removeBranch, perSiteScores,
+        perSiteScores ? UINT_MAX : tr->bestParsimony);
     tr->curRoot = TBR_removeBranch;
     tr->curRootBack = TBR_removeBranch->back;
 
@@ -2833,18 +2980,7 @@ static int pllTestTBRMove(pllInstance *tr, partitionList *pr, nodeptr branch1,
         pllSaveCurrentTreeTBRParsimony(tr, pr, mp); // run UFBoot
     }
 
-    if (mp < tr->bestParsimony)
-        bestTreeScoreHits = 1;
-    else if (mp == tr->bestParsimony)
-        bestTreeScoreHits++;
-    if ((mp < tr->bestParsimony) ||
-        ((mp == tr->bestParsimony) &&
-         (random_double() <= 1.0 / bestTreeScoreHits))) {
-        tr->bestParsimony = mp;
-        tr->TBR_insertBranch1 = branch1;
-        tr->TBR_insertBranch2 = branch2;
-        tr->TBR_removeBranch = TBR_removeBranch;
-    }
+    updateBestTBRMove(tr, branch1, branch2, TBR_removeBranch, mp);
 
     /* restore */
     assert(pllTbrRemoveBranch(tr, pr, TBR_removeBranch));
@@ -2852,6 +2988,12 @@ static int pllTestTBRMove(pllInstance *tr, partitionList *pr, nodeptr branch1,
     return PLL_TRUE;
 }
 
+/** TBR move joining the branches branch1-branch1->back and
+ * branch2-branch2->back */
+struct TbrMove {
+    nodeptr branch1, branch2;
+};
+
 /**
  @brief Internal function for recursively traversing a tree and testing a
  possible TBR move insertion
@@ -2866,18 +3008,25 @@ static int pllTestTBRMove(pllInstance *tr, partitionList *pr, nodeptr branch1,
 static void pllTraverseUpdateTBRQ(pllInstance *tr, partitionList *pr, nodeptr p,
                                   nodeptr q, nodeptr *r, int mintrav,
                                   int maxtrav, int distP, int distQ,
-                                  int perSiteScores) {
+                                  int perSiteScores,
+                                  vector<TbrMove> *moves = NULL) {
 
     if (mintrav <= 0) {
-        assert((pllTestTBRMove(tr, pr, p, q, r, perSiteScores)));
+        if (moves) {
+            TbrMove move = {p, q};
+            moves->push_back(move);
+        } else
+            assert((pllTestTBRMove(tr, pr, p, q, r, perSiteScores)));
     }
 
     /* traverse the q subtree */
     if ((!isTip(q->number, tr->mxtips)) && (maxtrav - 1 >= 0)) {
         pllTraverseUpdateTBRQ(tr, pr, p, q->next->back, r, mintrav - 1,
-                              maxtrav - 1, distP, distQ + 1, perSiteScores);
+                              maxtrav - 1, distP, distQ + 1, perSiteScores,
+                              moves);
         pllTraverseUpdateTBRQ(tr, pr, p, q->next->next->back, r, mintrav - 1,
-                              maxtrav - 1, distP, distQ + 1, perSiteScores);
+                              maxtrav - 1, distP, distQ + 1, perSiteScores,
+                              moves);
     }
 }
 
@@ -2895,18 +3044,268 @@ static void pllTraverseUpdateTBRQ(pllInstance *tr, partitionList *pr, nodeptr p,
 static void pllTraverseUpdateTBRP(pllInstance *tr, partitionList *pr, nodeptr p,
                                   nodeptr q, nodeptr *r, int mintrav,
                                   int maxtrav, int distP, int distQ,
-                                  int perSiteScores) {
+                                  int perSiteScores,
+                                  vector<TbrMove> *moves = NULL) {
     pllTraverseUpdateTBRQ(tr, pr, p, q, r, mintrav, maxtrav, distP, distQ,
-                          perSiteScores);
+                          perSiteScores, moves);
     /* traverse the p subtree */
     if ((!isTip(p->number, tr->mxtips)) && (maxtrav - 1 >= 0)) {
         pllTraverseUpdateTBRP(tr, pr, p->next->back, q, r, mintrav - 1,
-                              maxtrav - 1, distP + 1, distQ, perSiteScores);
+                              maxtrav - 1, distP + 1, distQ, perSiteScores,
+                              moves);
         pllTraverseUpdateTBRP(tr, pr, p->next->next->back, q, r, mintrav - 1,
-                              maxtrav - 1, distP + 1, distQ, perSiteScores);
+                              maxtrav - 1, distP + 1, distQ, perSiteScores,
+                              moves);
     }
 }
 
+#ifdef _OPENMP
+
+/**
+ * append to ti the computation of the vector of the subtree behind x->back,
+ * i.e. away from the removed branch, unless the vector of x is still valid
+ * @param stale nodes whose vector contains the removed branch
+ * @param down (IN/OUT) vector index of each subtree computed so far, 0 if none
+ * @return vector index of the subtree
+ */
+static int pllDownVectorTBR(pllInstance *tr, nodeptr x, vector<char> &stale,
+                            IntVector &down, IntVector &ti, int &scratch) {
+    if (isTip(x->number, tr->mxtips) || (x->xPars && !stale[x->number]))
+        return x->number;
+    if (down[x->number])
+        return down[x->number];
+    int left = pllDownVectorTBR(tr, x->next->back, stale, down, ti, scratch);
+    int right =
+        pllDownVectorTBR(tr, x->next->next->back, stale, down, ti, scratch);
+    int cur = scratch++;
+    ti.push_back(cur);
+    ti.push_back(left);
+    ti.push_back(right);
+    ti.push_back(0);
+    down[x->number] = cur;
+    return cur;
+}
+
+/**
+ * append to ti the computation of the vectors of the branch x-x->back and of
+ * the branches below x up to the given depth, as if the two subtrees were
+ * joined at these branches
+ * @param up vector index of the subtree behind x->back
+ * @param edge (OUT) vector index of each branch, by the node number of x
+ */
+static void pllEdgeVectorsTBR(pllInstance *tr, nodeptr x, int up, int depth,
+                              vector<char> &stale, IntVector &down,
+                              IntVector &edge, IntVector &ti, int &scratch) {
+    int cur = pllDownVectorTBR(tr, x, stale, down, ti, scratch);
+    edge[x->number] = scratch++;
+    ti.push_back(edge[x->number]);
+    ti.push_back(cur);
+    ti.push_back(up);
+    ti.push_back(0);
+
+    if (isTip(x->number, tr->mxtips) || depth <= 0)
+        return;
+    nodeptr x1 = x->next->back, x2 = x->next->next->back;
+    int down1 = pllDownVectorTBR(tr, x1, stale, down, ti, scratch);
+    int down2 = pllDownVectorTBR(tr, x2, stale, down, ti, scratch);
+    int up1 = scratch++, up2 = scratch++;
+    // the subtree behind x1->back consists of x2 and the one behind x->back
+    ti.push_back(up1);
+    ti.push_back(down2);
+    ti.push_back(up);
+    ti.push_back(0);
+    ti.push_back(up2);
+    ti.push_back(down1);
+    ti.push_back(up);
+    ti.push_back(0);
+    pllEdgeVectorsTBR(tr, x1, up1, depth - 1, stale, down, edge, ti, scratch);
+    pllEdgeVectorsTBR(tr, x2, up2, depth - 1, stale, down, edge, ti, scratch);
+}
+
+/**
+ * same as pllTestTBRMove() for a move with the known score mp, without
+ * computing any vector: branch records, recalculation marks, current root and
+ * best move are updated exactly as pllTestTBRMove() does
+ * @param touched (OUT) marks the nodes whose vector pllTestTBRMove() computes
+ */
+static void pllReplayTBRMove(pllInstance *tr, partitionList *pr,
+                             nodeptr branch1, nodeptr branch2,
+                             nodeptr *freeBranch, unsigned int mp,
+                             vector<char> &touched) {
+    branch1 = (branch1->xPars ? branch1 : branch1->back);
+    branch2 = (branch2->xPars ? branch2 : branch2->back);
+    freeBranch = ((*freeBranch)->xPars ? freeBranch : (&((*freeBranch)->back)));
+    nodeptr TBR_removeBranch =
+        pllConnectTBRMove(tr, branch1, branch2, freeBranch);
+    getTraversalInfoTBR(tr, branch1, branch2, TBR_removeBranch, PLL_FALSE);
+    for (int i = 4; i < tr->ti[0]; i += 4)
+        touched[tr->ti[i]] = 1;
+    tr->curRoot = TBR_removeBranch;
+    tr->curRootBack = TBR_removeBranch->back;
+
+    updateBestTBRMove(tr, branch1, branch2, TBR_removeBranch, mp);
+
+    assert(pllTbrRemoveBranch(tr, pr, TBR_removeBranch));
+}
+
+/** store the nodes of the subtree behind x->back by their numbers */
+static void pllListNodesTBR(pllInstance *tr, nodeptr x,
+                            vector<nodeptr> &nodes) {
+    nodes[x->number] = x;
+    if (isTip(x->number, tr->mxtips))
+        return;
+    pllListNodesTBR(tr, x->next->back, nodes);
+    pllListNodesTBR(tr, x->next->next->back, nodes);
+}
+
+/**
+ * append to ti the computation of the marked vector of a node, after the
+ * marked vectors it depends on
+ */
+static void pllTouchedVectorsTBR(pllInstance *tr, int number,
+                                 vector<nodeptr> &nodes, vector<char> &touched,
+                                 IntVector &ti) {
+    if (!touched[number])
+        return;
+    touched[number] = 0;
+    // the vector belongs to the record marked by xPars
+    nodeptr x = nodes[number];
+    if (!x->xPars)
+        x = (x->next->xPars ? x->next : x->next->next);
+    nodeptr left = x->next->back, right = x->next->next->back;
+    pllTouchedVectorsTBR(tr, left->number, nodes, touched, ti);
+    pllTouchedVectorsTBR(tr, right->number, nodes, touched, ti);
+    ti.push_back(number);
+    ti.push_back(left->number);
+    ti.push_back(right->number);
+    ti.push_back(0);
+}
+
+/**
+ * multithreaded version of the pllTestTBRMove() calls of pllComputeTBR(),
+ * giving the same tree state, tr->bestParsimony and best move.
+ * The branch p-q is removed, p1-p2 and q1-q2 are joined, moves are listed in
+ * the order of the serial search.
+ * The vectors of all branches of the moves are first computed into scratch
+ * vectors, then the threads score the moves without changing the tree. The
+ * moves are then replayed in order without vector computations, and the node
+ * vectors computed by the serial search are brought up to date.
+ */
+static void pllTestTBRMovesParallel(pllInstance *tr, partitionList *pr,
+                                    nodeptr p, nodeptr q, nodeptr p1,
+                                    nodeptr p2, nodeptr q1, nodeptr q2,
+                                    nodeptr *r, int maxtrav,
+                                    vector<TbrMove> &moves) {
+    size_t nodes = 2 * (size_t)tr->mxtips;
+    vector<char> stale(nodes, 0);
+    IntVector down(nodes, 0), edge(nodes, 0), ti(4, 0);
+    int scratch = tbrScratchNumber;
+
+    // the vectors containing the removed branch: from p and q up to the root
+    for (int side = 0; side < 2; side++) {
+        nodeptr x = (side == 0) ? p : q;
+        while (!stale[x->number]) {
+            stale[x->number] = 1;
+            if (x->number == tr->curRoot->number ||
+                x->number == tr->curRootBack->number)
+                break;
+            x = tbr_par[x->number];
+            assert(x);
+        }
+    }
+
+    for (int side = 0; side < 2; side++) {
+        nodeptr x1 = (side == 0) ? p1 : q1, x2 = (side == 0) ? p2 : q2;
+        // the joined branch x1-x2 and the branches below x1
+        pllEdgeVectorsTBR(tr, x1,
+                          pllDownVectorTBR(tr, x2, stale, down, ti, scratch),
+                          maxtrav, stale, down, edge, ti, scratch);
+        edge[x2->number] = edge[x1->number];
+        if (isTip(x2->number, tr->mxtips) || maxtrav <= 0)
+            continue;
+        // the branches below x2
+        nodeptr c1 = x2->next->back, c2 = x2->next->next->back;
+        int up = pllDownVectorTBR(tr, x1, stale, down, ti, scratch);
+        int down1 = pllDownVectorTBR(tr, c1, stale, down, ti, scratch);
+        int down2 = pllDownVectorTBR(tr, c2, stale, down, ti, scratch);
+        int up1 = scratch++, up2 = scratch++;
+        ti.push_back(up1);
+        ti.push_back(down2);
+        ti.push_back(up);
+        ti.push_back(0);
+        ti.push_back(up2);
+        ti.push_back(down1);
+        ti.push_back(up);
+        ti.push_back(0);
+        pllEdgeVectorsTBR(tr, c1, up1, maxtrav - 1, stale, down, edge, ti,
+                          scratch);
+        pllEdgeVectorsTBR(tr, c2, up2, maxtrav - 1, stale, down, edge, ti,
+                          scratch);
+    }
+    ti[0] = ti.size();
+    assert(scratch <= tbrScratchNumber + 5 * tr->mxtips);
+
+    int *tr_ti = tr->ti;
+    tr->ti = &ti[0];
+    if (ti[0] > 4)
+        _newviewParsimonyIterativeFast(tr, pr, PLL_FALSE);
+    tr->ti = tr_ti;
+
+    int nmoves = moves.size();
+    vector<unsigned int> scores(nmoves);
+
+    PllSearchState state;
+    state.capture(pllRemainderLowerBounds, doing_stepwise_addition);
+
+#pragma omp parallel num_threads(state.params->num_threads)
+    {
+        state.apply(pllRemainderLowerBounds, doing_stepwise_addition);
+
+        // the scores are compared with the best one found before this round:
+        // moves stopped early by the lower bounds lose against the later best
+        // scores, too
+        pllInstance thread_tr = *tr;
+        int thread_ti[4];
+        thread_tr.ti = thread_ti;
+
+#pragma omp for schedule(static)
+        for (int i = 0; i < nmoves; i++) {
+            assert(edge[moves[i].branch1->number] &&
+                   edge[moves[i].branch2->number]);
+            thread_ti[0] = 4;
+            thread_ti[1] = edge[moves[i].branch1->number];
+            thread_ti[2] = edge[moves[i].branch2->number];
+            scores[i] = _evaluateParsimonyIterativeFast(
+                &thread_tr, pr, PLL_FALSE, thread_tr.bestParsimony);
+        }
+
+        PllSearchState::release(pllRemainderLowerBounds);
+    }
+
+    vector<char> touched(nodes, 0);
+    for (int i = 0; i < nmoves; i++)
+        pllReplayTBRMove(tr, pr, moves[i].branch1, moves[i].branch2, r,
+                         scores[i], touched);
+
+    // the vectors of p and q are computed again when the tree is reconnected
+    touched[p->number] = touched[q->number] = 0;
+    vector<nodeptr> node_of(nodes, NULL);
+    pllListNodesTBR(tr, p1, node_of);
+    pllListNodesTBR(tr, p2, node_of);
+    pllListNodesTBR(tr, q1, node_of);
+    pllListNodesTBR(tr, q2, node_of);
+    ti.resize(4);
+    for (int i = tr->mxtips + 1; i < (int)nodes; i++)
+        pllTouchedVectorsTBR(tr, i, node_of, touched, ti);
+    ti[0] = ti.size();
+    tr->ti = &ti[0];
+    if (ti[0] > 4)
+        _newviewParsimonyIterativeFast(tr, pr, PLL_FALSE);
+    tr->ti = tr_ti;
+}
+
+#endif // _OPENMP
+
 static void pllTraverseUpdateTBRBetterQ(pllInstance *tr, partitionList *pr,
                                       nodeptr p, nodeptr q, nodeptr *r,
                                       int mintrav, int maxtrav,
@@ -3007,42 +3406,55 @@ static int pllComputeTBR(pllInstance *tr, partitionList *pr, nodeptr p,
     /* split the tree in two components */
     assert(pllTbrRemoveBranch(tr, pr, p));
 
+    // with several threads, the moves are only listed here and tested by
+    // pllTestTBRMovesParallel()
+    vector<TbrMove> tbr_moves, *moves = NULL;
+#ifdef _OPENMP
+    if (tbrScratchNumber && !perSiteScores && !omp_in_parallel())
+        moves = &tbr_moves;
+#endif
+
     /* recursively traverse and perform TBR */
     pllTraverseUpdateTBRP(tr, pr, p1, q1, &p, mintrav, maxtrav, 0, 0,
-                          perSiteScores);
+                          perSiteScores, moves);
     if (!isTip(q2->number, tr->mxtips)) {
         pllTraverseUpdateTBRP(tr, pr, p1, q2->next->back, &p, mintrav - 1,
-                              maxtrav - 1, 0, 1, perSiteScores);
+                              maxtrav - 1, 0, 1, perSiteScores, moves);
         pllTraverseUpdateTBRP(tr, pr, p1, q2->next->next->back, &p, mintrav - 1,
-                              maxtrav - 1, 0, 1, perSiteScores);
+                              maxtrav - 1, 0, 1, perSiteScores, moves);
     }
 
     if (!isTip(p2->number, tr->mxtips)) {
         pllTraverseUpdateTBRP(tr, pr, p2->next->back, q1, &p, mintrav - 1,
-                              maxtrav - 1, 1, 0, perSiteScores);
+                              maxtrav - 1, 1, 0, perSiteScores, moves);
         pllTraverseUpdateTBRP(tr, pr, p2->next->next->back, q1, &p, mintrav - 1,
-                              maxtrav - 1, 1, 0, perSiteScores);
+                              maxtrav - 1, 1, 0, perSiteScores, moves);
         if (!isTip(q2->number, tr->mxtips)) {
             pllTraverseUpdateTBRP(tr, pr, p2->next->back, q2->next->back, &p,
                                   mintrav - 2, maxtrav - 2, 1, 1,
-                                  perSiteScores);
+                                  perSiteScores, moves);
             pllTraverseUpdateTBRP(tr, pr, p2->next->back, q2->next->next->back,
                                   &p, mintrav - 2, maxtrav - 2, 1, 1,
-                                  perSiteScores);
+                                  perSiteScores, moves);
             pllTraverseUpdateTBRP(tr, pr, p2->next->next->back, q2->next->back,
                                   &p, mintrav - 2, maxtrav - 2, 1, 1,
-                                  perSiteScores);
+                                  perSiteScores, moves);
             pllTraverseUpdateTBRP(tr, pr, p2->next->next->back,
                                   q2->next->next->back, &p, mintrav - 2,
-                                  maxtrav - 2, 1, 1, perSiteScores);
+                                  maxtrav - 2, 1, 1, perSiteScores, moves);
         }
     }
+#ifdef _OPENMP
+    if (moves)
+        pllTestTBRMovesParallel(tr, pr, p, q, p1, p2, q1, q2, &p, maxtrav,
+                                tbr_moves);
+#endif
     /* restore the topology as it was before the split */
     nodeptr freeBranch = (p->xPars ? p : q);
     p1 = (p1->xPars ? p1 : p1->back);
     q1 = (q1->xPars ? q1 : q1->back);
     assert(pllTbrConnectSubtrees(tr, p1, q1, &freeBranch));
-    evaluateParsimonyTBR(tr, pr, p1, q1, freeBranch, perSiteScores);
+    evaluateParsimonyTBR(tr, pr, p1, q1, freeBranch, perSiteScores, UINT_MAX);
     tr->curRoot = freeBranch;
     tr->curRootBack = freeBranch->back;
 
@@ -3092,7 +3504,7 @@ static int pllComputeTBRBetter(pllInstance *tr, partitionList *pr, nodeptr p,
     p1 = ((*bestIns1)->xPars ? (*bestIns1) : (*bestIns1)->back);
     q1 = ((*bestIns2)->xPars ? (*bestIns2) : (*bestIns2)->back);
     assert(pllTbrConnectSubtrees(tr, p1, q1, &freeBranch));
-    evaluateParsimonyTBR(tr, pr, p1, q1, freeBranch, perSiteScores);
+    evaluateParsimonyTBR(tr, pr, p1, q1, freeBranch, perSiteScores, UINT_MAX);
     tr->curRoot = freeBranch;
     tr->curRootBack = freeBranch->back;
 
@@ -3111,7 +3523,8 @@ static int pllTestTBRMoveLeaf(pllInstance *tr, partitionList *pr,
     hookupDefault(i1, p->next);
     hookupDefault(i2, p->next->next);
     unsigned int mp =
-        evaluateParsimonyTBR(tr, pr, p->back, insertBranch, p, perSiteScores);
+        evaluateParsimonyTBR(tr, pr, p->back, insertBranch, p, perSiteScores,
+                             perSiteScores ? UINT_MAX : tr->bestParsimony);
     tr->curRoot = removeBranch;
     tr->curRootBack = removeBranch->back;
     if (perSiteScores) {
@@ -3196,7 +3609,7 @@ static int pllComputeTBRLeaf(pllInstance *tr, partitionList *pr, nodeptr p,
     hookupDefault(p->next->next, p2);
     p1 = (p1->xPars ? p1 : p2);
     // assert(p1->xPars);
-    evaluateParsimonyTBR(tr, pr, q, p1, q, perSiteScores);
+    evaluateParsimonyTBR(tr, pr, q, p1, q, perSiteScores, UINT_MAX);
     tr->curRoot = q;
     tr->curRootBack = q->back;
     return PLL_TRUE;
@@ -3219,7 +3632,7 @@ static bool restoreTreeRearrangeParsimonyTBRLeaf(pllInstance *tr,
     hookupDefault(r, tr->TBR_removeBranch->next);
     hookupDefault(rb, tr->TBR_removeBranch->next->next);
     evaluateParsimonyTBR(tr, pr, tr->TBR_removeBranch->back, r,
-                         tr->TBR_removeBranch, perSiteScores);
+                         tr->TBR_removeBranch, perSiteScores, UINT_MAX);
     tr->curRoot = tr->TBR_removeBranch;
     tr->curRootBack = tr->TBR_removeBranch->back;
 
@@ -3303,18 +3716,20 @@ int pllOptimizeTbrParsimony(pllInstance *tr, partitionList *pr, int mintrav,
 
     iqtree = _iqtree; // update pointer to IQTree
 
-    if (globalParam->ratchet_iter >= 0 &&
-        (iqtree->on_ratchet_hclimb1 || iqtree->on_ratchet_hclimb2)) {
+    if ((globalParam->ratchet_iter >= 0 &&
+         (iqtree->on_ratchet_hclimb1 || iqtree->on_ratchet_hclimb2)) ||
+        iqtree->on_opt_btree) {
         // oct 23: in non-ratchet iteration, allocate is not triggered
+        // the ratchet and bootstrap alignments reweight the patterns of the
+        // PLL alignment, the tips are compressed again into the old vectors
         _updateInternalPllOnRatchet(tr, pr);
-        _allocateParsimonyDataStructuresTBR(
-            tr, pr, perSiteScores); // called once if not running ratchet
-    } else if (first_call || (iqtree && iqtree->on_opt_btree)) {
+        _allocateParsimonyDataStructuresTBR(tr, pr, perSiteScores);
+    } else if (first_call) {
         _allocateParsimonyDataStructuresTBR(
             tr, pr, perSiteScores); // called once if not running ratchet
     }
 
-    if (first_call) {
+    if (first_call && !iqtree->on_opt_btree) {
         first_call = false;
     }
 
@@ -3327,7 +3742,7 @@ int pllOptimizeTbrParsimony(pllInstance *tr, partitionList *pr, int mintrav,
     nodeRectifierParsVer2(tr, true);
     tr->bestParsimony = UINT_MAX;
     tr->bestParsimony =
-        _evaluateParsimony(tr, pr, tr->start, PLL_TRUE, perSiteScores);
+        _evaluateParsimony(tr, pr, tr->start, PLL_TRUE, perSiteScores, UINT_MAX);
     // cout << "tr->bestParsimony = " << tr->bestParsimony << '\n';
 
     assert(-iqtree->curScore == tr->bestParsimony);
@@ -3479,7 +3894,7 @@ static void stepwiseAddition(pllInstance *tr, partitionList *pr, nodeptr p,
     tr->ti[1] = p->number;
     tr->ti[2] = p->back->number;
 
-    mp = _evaluateParsimonyIterativeFast(tr, pr, PLL_FALSE);
+    mp = _evaluateParsimonyIterativeFast(tr, pr, PLL_FALSE, tr->bestParsimony);
 
     if (mp < tr->bestParsimony)
         bestTreeScoreHits = 1;
@@ -3503,6 +3918,142 @@ static void stepwiseAddition(pllInstance *tr, partitionList *pr, nodeptr p,
     }
 }
 
+#ifdef _OPENMP
+
+/** branch tested by stepwiseAdditionParallel() */
+struct StepwiseInsertion {
+    /** the new taxon is inserted into the branch q-q->back */
+    nodeptr q;
+    /** index of the parsimony vector of the subtree behind q->back */
+    int up;
+};
+
+/**
+ * append to ti the computation of the vectors of q and the internal nodes
+ * below it, oriented away from q->back, that are not up to date
+ */
+static void computeTraversalInfoDown(pllInstance *tr, nodeptr q, int *ti,
+                                     int *counter) {
+    if (isTip(q->number, tr->mxtips))
+        return;
+    if (!q->xPars)
+        computeTraversalInfoParsimony(q, ti, counter, tr->mxtips, PLL_FALSE,
+                                      0);
+    computeTraversalInfoDown(tr, q->next->back, ti, counter);
+    computeTraversalInfoDown(tr, q->next->next->back, ti, counter);
+}
+
+/**
+ * list the branches tested by stepwiseAddition(tr, pr, p, q) in the same
+ * order, and append to ti the computation of the vectors 'up' behind each of
+ * them; the vectors below the branches must be up to date
+ */
+static void collectStepwiseInsertions(pllInstance *tr, nodeptr q, int up,
+                                      vector<StepwiseInsertion> &insertions,
+                                      IntVector &ti, int &scratch) {
+    StepwiseInsertion ins = {q, up};
+    insertions.push_back(ins);
+
+    if (isTip(q->number, tr->mxtips) || tr->parsimonyScore[q->number] == 0)
+        return;
+    nodeptr q1 = q->next->back, q2 = q->next->next->back;
+    int up1 = scratch++, up2 = scratch++;
+    // the subtree behind q1->back consists of q2 and the one behind q->back
+    ti.push_back(up1);
+    ti.push_back(q2->number);
+    ti.push_back(up);
+    ti.push_back(0);
+    ti.push_back(up2);
+    ti.push_back(q1->number);
+    ti.push_back(up);
+    ti.push_back(0);
+    collectStepwiseInsertions(tr, q1, up1, insertions, ti, scratch);
+    collectStepwiseInsertions(tr, q2, up2, insertions, ti, scratch);
+}
+
+/**
+ * multithreaded version of stepwiseAddition(tr, pr, p, f->back), giving the
+ * same tr->bestParsimony and tr->insertNode.
+ * The vectors below every branch (oriented away from the tip f) and behind the
+ * tested branches are first computed into node and scratch vectors, then the
+ * threads score the branches with one scratch vector each, without changing
+ * the tree. The scores are compared in the order of stepwiseAddition(), so the
+ * ties draw the same random numbers.
+ */
+static void stepwiseAdditionParallel(pllInstance *tr, partitionList *pr,
+                                     nodeptr p, nodeptr f) {
+    int counter = 4;
+    computeTraversalInfoDown(tr, f->back, tr->ti, &counter);
+    tr->ti[0] = counter;
+    if (counter > 4)
+        _newviewParsimonyIterativeFast(tr, pr, PLL_FALSE);
+
+    vector<StepwiseInsertion> insertions;
+    IntVector ti(4, 0);
+    int scratch = tbrScratchNumber;
+    collectStepwiseInsertions(tr, f->back, f->number, insertions, ti, scratch);
+    ti[0] = ti.size();
+    assert(scratch <= tbrScratchNumber + 2 * tr->mxtips);
+
+    int *tr_ti = tr->ti;
+    tr->ti = &ti[0];
+    if (ti[0] > 4)
+        _newviewParsimonyIterativeFast(tr, pr, PLL_FALSE);
+    tr->ti = tr_ti;
+
+    int ninsertions = insertions.size();
+    vector<unsigned int> scores(ninsertions);
+    // one scratch vector per branch after the vectors 'up'
+    int first_cur = tbrScratchNumber + 2 * tr->mxtips;
+    assert(first_cur + ninsertions <= tbrScratchNumber + 5 * tr->mxtips);
+
+    PllSearchState state;
+    state.capture(pllRemainderLowerBounds, doing_stepwise_addition);
+
+#pragma omp parallel num_threads(state.params->num_threads)
+    {
+        state.apply(pllRemainderLowerBounds, doing_stepwise_addition);
+
+        pllInstance thread_tr = *tr;
+        int thread_ti[8];
+        thread_tr.ti = thread_ti;
+
+#pragma omp for schedule(static)
+        for (int i = 0; i < ninsertions; i++) {
+            // cur = (q, up), then evaluate the branch cur-p->back
+            int cur = first_cur + i;
+            thread_ti[0] = 8;
+            thread_ti[1] = cur;
+            thread_ti[2] = p->back->number;
+            thread_ti[4] = cur;
+            thread_ti[5] = insertions[i].q->number;
+            thread_ti[6] = insertions[i].up;
+            scores[i] = _evaluateParsimonyIterativeFast(
+                &thread_tr, pr, PLL_FALSE, thread_tr.bestParsimony);
+        }
+
+        PllSearchState::release(pllRemainderLowerBounds);
+    }
+
+    for (int i = 0; i < ninsertions; i++) {
+        unsigned int mp = scores[i];
+
+        if (mp < tr->bestParsimony)
+            bestTreeScoreHits = 1;
+        else if (mp == tr->bestParsimony)
+            bestTreeScoreHits++;
+
+        if ((mp < tr->bestParsimony) ||
+            ((mp == tr->bestParsimony) &&
+             (random_double() <= 1.0 / bestTreeScoreHits))) {
+            tr->bestParsimony = mp;
+            tr->insertNode = insertions[i].q;
+        }
+    }
+}
+
+#endif // _OPENMP
+
 static void pllMakeParsimonyTreeFastTBR(pllInstance *tr, partitionList *pr,
                                         int tbr_mintrav, int tbr_maxtrav) {
     nodeptr p, f;
@@ -3534,7 +4085,14 @@ static void pllMakeParsimonyTreeFastTBR(pllInstance *tr, partitionList *pr,
         p->back = q;
         q->back = p;
 
-        stepwiseAddition(tr, pr, q, f->back);
+#ifdef _OPENMP
+        // the branches are scored by several threads if the scratch vectors
+        // were allocated
+        if (tbrScratchNumber && !omp_in_parallel())
+            stepwiseAdditionParallel(tr, pr, q, f);
+        else
+#endif
+            stepwiseAddition(tr, pr, q, f->back);
         //      cout << "tr->ntips = " << tr->ntips << endl;
 
         {
@@ -3557,7 +4115,7 @@ static void pllMakeParsimonyTreeFastTBR(pllInstance *tr, partitionList *pr,
 
     tr->bestParsimony = UINT_MAX;
     tr->bestParsimony =
-        _evaluateParsimony(tr, pr, tr->start, PLL_TRUE, PLL_FALSE);
+        _evaluateParsimony(tr, pr, tr->start, PLL_TRUE, PLL_FALSE, UINT_MAX);
 
     unsigned int bestIterationScoreHits = 1;
     randomMP = tr->bestParsimony;
@@ -590,6 +590,7 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.ignore_checkpoint = true;
     params.checkpoint_dump_interval = 60;
     params.ckp_rerun = false;
+    params.ckp_binary = false;
     params.tbr_pars = false;
     params.tbr_mintrav = 1;
     params.tbr_maxtrav = 5;
@@ -773,6 +774,7 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.distinct_trees = false;
     params.online_bootstrap = true;
     params.min_correlation = 0.99;
+    params.boot_correlation_stop = false;
     params.step_iterations = 100;
     params.store_candidate_trees = false;
 	params.print_ufboot_trees = false;
@@ -806,6 +808,7 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.speednni = true; // turn on reduced hill-climbing NNI by default now
     params.adaptPert = false;
     params.numParsTrees = 100;
+    params.numMultiStarts = 0;
     params.sprDist = -1;
     params.numNNITrees = 20;
     params.avh_test = 0;
@@ -825,6 +828,7 @@ void parseArg(int argc, char *argv[], Params &params) {
     params.sankoff_cost_file = NULL;
     params.sankoff_short_int = true; // Diep: Revert for MPBoot release
     params.condense_parsimony_equiv_sites = false;
+    params.aln_cache = false;
     params.spr_parsimony = true;// Diep: Revert for UFBoot-MP release
     params.spr_mintrav = 1; // same as PLL
     params.spr_maxtrav = 6; // PLL default is 20
@@ -931,6 +935,12 @@ void parseArg(int argc, char *argv[], Params &params) {
                 cout << "Note that checkpoint currently only works with normal treesearch and normal bootstrap!\n";
 				continue;
 			}
+            if (strcmp(argv[cnt], "-ckp_bin") == 0) {
+                params.ignore_checkpoint = false;
+                params.ckp_binary = true;
+                cout << "Note that checkpoint currently only works with normal treesearch and normal bootstrap!\n";
+				continue;
+			}
             if (strcmp(argv[cnt], "-ckp_rerun") == 0) {
                 params.ignore_checkpoint = false;
                 params.ckp_rerun = true;
@@ -2216,6 +2226,10 @@ void parseArg(int argc, char *argv[], Params &params) {
 				params.min_correlation = convert_double(argv[cnt]);
 				continue;
 			}
+			if (strcmp(argv[cnt], "-bcor_stop") == 0) {
+				params.boot_correlation_stop = true;
+				continue;
+			}
 			if (strcmp(argv[cnt], "-nstep") == 0) {
 				cnt++;
 				if (cnt >= argc)
@@ -2305,6 +2319,15 @@ void parseArg(int argc, char *argv[], Params &params) {
 				params.numParsTrees = convert_int(argv[cnt]);
 				continue;
 			}
+			if (strcmp(argv[cnt], "-multistart") == 0) {
+				cnt++;
+				if (cnt >= argc)
+					throw "Use -multistart <number_of_searches>";
+				params.numMultiStarts = convert_int(argv[cnt]);
+				if (params.numMultiStarts < 0)
+					throw "Number of searches must not be negative";
+				continue;
+			}
 			if (strcmp(argv[cnt], "-toppars") == 0) {
 				cnt++;
 				if (cnt >= argc)
@@ -2434,6 +2457,10 @@ void parseArg(int argc, char *argv[], Params &params) {
 			if(strcmp(argv[cnt], "-mpcondense") == 0){
             	params.condense_parsimony_equiv_sites = true;
             	continue;
+            }
+			if(strcmp(argv[cnt], "-alncache") == 0){
+            	params.aln_cache = true;
+            	continue;
             }
 			if(strcmp(argv[cnt], "-spr_pars") == 0){
             	params.spr_parsimony = true;
@@ -2856,6 +2883,9 @@ void parseArg(int argc, char *argv[], Params &params) {
 			params.sprDist = 20;
     }
 
+    if (params.boot_correlation_stop && params.gbo_replicates == 0)
+    	outError("-bcor_stop must work with -bb");
+
     if(params.optimize_boot_trees == false && params.save_trees_off == true){
     	outError("-save_trees_off must work with -opt_btree");
     }else if(params.optimize_boot_trees == true && params.save_trees_off == true){
@@ -2987,6 +3017,7 @@ void usage_iqtree(char* argv[], bool full_command) {
             << "  -nm <#iterations>    Maximum number of iterations (default: 1000)" << endl
 			<< "  -nstep <#iterations> #Iterations for UFBoot stopping rule (default: 100)" << endl
             << "  -bcor <min_corr>     Minimum correlation coefficient (default: 0.99)" << endl
+            << "  -bcor_stop           Also stop once the split supports reach <min_corr>" << endl
 			<< "  -beps <epsilon>      RELL epsilon to break tie (default: 0.5)" << endl
             << endl << "STANDARD NON-PARAMETRIC BOOTSTRAP:" << endl
             << "  -b <#replicates>     Bootstrap + ML tree + consensus tree (>=100)" << endl
@@ -3103,6 +3134,7 @@ void usage_mpboot(char* argv[], bool full_command) {
             << "  -st <data_type>      BIN, DNA, AA, CODON, or MORPH (default: auto-detect)" << endl
             << "  <treefile>           Initial tree for tree reconstruction (default: MP)" << endl
             << "  -pre <PREFIX>        Using <PREFIX> for output files (default: alignment name)" << endl
+            << "  -alncache            Keep the parsed alignment in <PREFIX>.alnbin for later runs" << endl
             << "  -seed <number>       Random seed number, normally used for debugging purpose" << endl
             << "  -v, -vv, -vvv        Verbose mode, printing more messages to screen" << endl
 
@@ -3113,6 +3145,8 @@ void usage_mpboot(char* argv[], bool full_command) {
 			<< "  -ratchet_percent <number> Percentage of informative sites selected for perturbation during ratchet (default: 50)" << endl
 			<< "  -ratchet_off              Turn of ratchet, i.e. Only use tree perturbation" << endl
 			<< "  -spr_rad <number>         Maximum radius of SPR (default: 3)" << endl
+			<< "  -multistart <number>      Number of independent random addition + SPR/TBR searches" << endl
+			<< "                            added to the initial candidate trees, run in parallel with -omp (default: 0)" << endl
 			<< "  -cand_cutoff <#s>         Use top #s percentile as cutoff for selecting bootstrap candidates (default: 10)" << endl
 			<< "  -opt_btree_off            Turn off refinement step on the final bootstrap tree set" << endl
 			<< "  -nni_pars                 Hill-climb by NNI instead of SPR" << endl
@@ -3134,6 +3168,7 @@ void usage_mpboot(char* argv[], bool full_command) {
             << "  -nm <#iterations>    Maximum number of iterations (default: 1000)" << endl
 			<< "  -nstep <#iterations> #Iterations for UFBoot stopping rule (default: 100)" << endl
             << "  -bcor <min_corr>     Minimum correlation coefficient (default: 0.99)" << endl
+            << "  -bcor_stop           Also stop once the split supports reach <min_corr>" << endl
 			<< "  -beps <epsilon>      RELL epsilon to break tie (default: 0.5)" << endl
             << endl << "CONSENSUS RECONSTRUCTION:" << endl
             << "  <tree_file>          Set of input trees for consensus reconstruction" << endl
@@ -3282,6 +3317,13 @@ int finish_random() {
 	return 0;
 }
 
+int *init_random_stream(int stream_id, int nstreams, int seed) {
+	return NULL;
+}
+
+void finish_random_stream(int *prev_stream) {
+}
+
 
 #elif RAN_TYPE == RAN_RAND4
 /******************************************************************************/
@@ -3397,13 +3439,20 @@ int init_random(int seed) /* RAND4 */ {
 int finish_random() {
 	return 0;
 }
+
+int *init_random_stream(int stream_id, int nstreams, int seed) {
+	return NULL;
+}
+
+void finish_random_stream(int *prev_stream) {
+}
 /******************/
 
 #else /* SPRNG */
 
 /******************/
 
-int *randstream;
+THREAD_LOCAL int *randstream;
 
 int init_random(int seed) {
     //    srand((unsigned) time(NULL));
@@ -3433,6 +3482,24 @@ int finish_random() {
 	return free_sprng(randstream);
 }
 
+int *init_random_stream(int stream_id, int nstreams, int seed) {
+    int *prev_stream = randstream;
+    // SPRNG keeps a global stream counter
+#ifdef _OPENMP
+#pragma omp critical (sprng)
+#endif
+    randstream = init_sprng(stream_id, nstreams, seed, SPRNG_DEFAULT);
+    return prev_stream;
+}
+
+void finish_random_stream(int *prev_stream) {
+#ifdef _OPENMP
+#pragma omp critical (sprng)
+#endif
+    free_sprng(randstream);
+    randstream = prev_stream;
+}
+
 #endif /* USE_SPRNG */
 
 /******************/
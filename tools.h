@@ -57,6 +57,13 @@
 #define __func__ __FUNCTION__
 #endif
 
+// thread-local storage for plain global variables
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
 #if defined(USE_HASH_MAP) && !defined(_MSC_VER)
 	#if !defined(__GNUC__)
 		#include <hash_map>
@@ -420,12 +427,20 @@ struct Params {
     /** time (in seconds) between checkpoint dump */
     int checkpoint_dump_interval;
     bool ckp_rerun;
+    /** TRUE to write the checkpoint as an append-only binary log (<prefix>.ckp.bin) */
+    bool ckp_binary;
 
 	/**
 	 *  Number of starting parsimony trees
 	 */
 	int numParsTrees;
 
+	/**
+	 *  Number of independent parsimony searches (random stepwise addition + SPR/TBR)
+	 *  added to the initial candidate tree set, run concurrently with -omp
+	 */
+	int numMultiStarts;
+
 	/**
 	 *  SPR distance (radius) for parsimony tree
 	 */
@@ -1427,6 +1442,9 @@ struct Params {
     /** minimal correlation coefficient for bootstrap stopping rule */
     double min_correlation;
 
+    /** TRUE to also stop UFBoot as soon as the correlation reaches min_correlation (-bcor_stop) */
+    bool boot_correlation_stop;
+
     /** number of iterations between bootstrap stopping rule check */
     int step_iterations;
 
@@ -1513,6 +1531,12 @@ struct Params {
     /** TRUE to condense parsimony equivalent sites, default: false */
     bool condense_parsimony_equiv_sites;
 
+    /**
+     * TRUE to keep the parsed alignment in the binary cache <prefix>.alnbin,
+     * later runs read the cache instead of the alignment file, default: false
+     */
+    bool aln_cache;
+
     /*
      * Diep:
      * Name of file storing Sankoff cost matrix
@@ -2109,6 +2133,22 @@ int init_random(int seed);
  */
 int finish_random();
 
+/**
+ * switch the calling thread to its own random stream, so that the numbers
+ * drawn do not depend on the scheduling of other threads
+ * @param stream_id stream number in [0, nstreams)
+ * @param nstreams total number of streams
+ * @param seed seed for generator
+ * @return the previous random stream of the calling thread
+ */
+int *init_random_stream(int stream_id, int nstreams, int seed);
+
+/**
+ * free the stream created by init_random_stream() and switch back
+ * @param prev_stream the stream returned by init_random_stream()
+ */
+void finish_random_stream(int *prev_stream);
+
 /**
  * returns a random integer in the range [0; n - 1]
  * @param n upper-bound of random number
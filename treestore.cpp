@@ -0,0 +1,350 @@
+/*
+ * treestore.cpp
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "treestore.h"
+#include "mtree.h"
+
+/** tokens of an encoded tree besides the taxon IDs */
+enum {
+    TOKEN_OPEN = -1, TOKEN_CLOSE = -2, TOKEN_END = -3
+};
+
+/** largest taxon ID encoded, larger ones keep the tree as a plain string */
+const int MAX_CODE_TAXID = (1 << 30) - 1;
+
+/**
+ * split a Newick string into tokens, only if encodeTree() can restore it exactly
+ * @param tree a tree string
+ * @param tokens (OUT) taxon IDs and TOKEN_*
+ * @param max_id (OUT) largest taxon ID
+ * @return false if tree is not an unnamed topology of taxon IDs
+ */
+static bool tokenizeTree(const string &tree, IntVector &tokens, int &max_id) {
+    // last token: 0 = none, 1 = '(', 2 = taxon or ')', 3 = ','
+    int prev = 0, depth = 0;
+    max_id = 0;
+    size_t len = tree.length();
+    for (size_t i = 0; i < len; ) {
+        char c = tree[i];
+        if (c == '(') {
+            if (prev == 2)
+                return false;
+            tokens.push_back(TOKEN_OPEN);
+            depth++;
+            prev = 1;
+            i++;
+        } else if (c >= '0' && c <= '9') {
+            if (prev == 2)
+                return false;
+            if (c == '0' && i + 1 < len && tree[i + 1] >= '0' && tree[i + 1] <= '9')
+                return false; // leading zero
+            int id = 0;
+            for (; i < len && tree[i] >= '0' && tree[i] <= '9'; i++) {
+                if (id > MAX_CODE_TAXID / 10)
+                    return false;
+                id = id * 10 + (tree[i] - '0');
+            }
+            if (id > MAX_CODE_TAXID)
+                return false;
+            tokens.push_back(id);
+            if (id > max_id)
+                max_id = id;
+            prev = 2;
+        } else if (c == ',') {
+            if (prev != 2 || depth == 0)
+                return false;
+            prev = 3;
+            i++;
+        } else if (c == ')') {
+            if (prev != 2 || depth == 0)
+                return false;
+            tokens.push_back(TOKEN_CLOSE);
+            depth--;
+            prev = 2;
+            i++;
+        } else if (c == ';') {
+            if (prev != 2 || depth != 0 || i + 1 != len)
+                return false;
+            tokens.push_back(TOKEN_END);
+            return true;
+        } else
+            return false;
+    }
+    return false;
+}
+
+/**
+ * pack tokens as bits, lowest bit first: a taxon is 0 followed by its ID on width bits,
+ * '(' is 10, ')' is 110 and ';' is 111
+ */
+static void packTokens(IntVector &tokens, int max_id, string &code) {
+    int width = 1;
+    while ((max_id >> width) != 0)
+        width++;
+    code.clear();
+    code.reserve(1 + (tokens.size() * (width + 1)) / 8 + 1);
+    code.push_back((char)width);
+    uint64_t bits = 0;
+    int nbits = 0;
+    for (IntVector::iterator it = tokens.begin(); it != tokens.end(); it++) {
+        switch (*it) {
+        case TOKEN_OPEN:
+            bits |= (uint64_t)1 << nbits;
+            nbits += 2;
+            break;
+        case TOKEN_CLOSE:
+            bits |= (uint64_t)3 << nbits;
+            nbits += 3;
+            break;
+        case TOKEN_END:
+            bits |= (uint64_t)7 << nbits;
+            nbits += 3;
+            break;
+        default:
+            bits |= (uint64_t)(*it) << (nbits + 1);
+            nbits += width + 1;
+        }
+        for (; nbits >= 8; nbits -= 8, bits >>= 8)
+            code.push_back((char)(bits & 255));
+    }
+    if (nbits > 0)
+        code.push_back((char)(bits & 255));
+}
+
+void TreeStore::encodeTree(const string &tree, string &code) {
+    IntVector tokens;
+    int max_id;
+    if (tokenizeTree(tree, tokens, max_id)) {
+        packTokens(tokens, max_id, code);
+    } else {
+        code.assign(1, (char)0);
+        code += tree;
+    }
+}
+
+/**
+ * @param min_id (OUT) smallest taxon ID below each node, by node ID
+ * @return smallest taxon ID of the subtree, -1 if it has a named internal node
+ */
+static int getMinTaxonID(Node *node, Node *dad, IntVector &min_id) {
+    int id;
+    if (node->isLeaf()) {
+        if (node->name == ROOT_NAME)
+            return -1;
+        id = node->id;
+    } else {
+        if (!node->name.empty())
+            return -1;
+        id = INT_MAX;
+        FOR_NEIGHBOR_IT(node, dad, it) {
+            int child_id = getMinTaxonID((*it)->node, node, min_id);
+            if (child_id < 0)
+                return -1;
+            if (child_id < id)
+                id = child_id;
+        }
+    }
+    if (node->id >= min_id.size())
+        min_id.resize(node->id + 1, -1);
+    min_id[node->id] = id;
+    return id;
+}
+
+/** tokens of the subtree in the order of printTree() with WT_SORT_TAXA */
+static void getTreeTokens(Node *node, Node *dad, IntVector &min_id, IntVector &tokens) {
+    if (node->isLeaf()) {
+        tokens.push_back(node->id);
+        return;
+    }
+    // children sorted by their smallest taxon ID
+    vector<pair<int, Node*> > children;
+    FOR_NEIGHBOR_IT(node, dad, it)
+        children.push_back(make_pair(min_id[(*it)->node->id], (*it)->node));
+    sort(children.begin(), children.end());
+    tokens.push_back(TOKEN_OPEN);
+    for (vector<pair<int, Node*> >::iterator it = children.begin(); it != children.end(); it++)
+        getTreeTokens(it->second, node, min_id, tokens);
+    tokens.push_back(TOKEN_CLOSE);
+}
+
+void TreeStore::encodeTree(MTree *tree, string &code) {
+    Node *node = tree->root;
+    if (node && node->isLeaf() && !node->neighbors[0]->node->isLeaf()) {
+        // as printTree(), start from the neighbor of the root leaf
+        node = node->neighbors[0]->node;
+        IntVector min_id(tree->nodeNum, -1);
+        int max_id = 0;
+        if (getMinTaxonID(node, NULL, min_id) >= 0) {
+            IntVector tokens;
+            tokens.reserve(2 * tree->nodeNum);
+            getTreeTokens(node, NULL, min_id, tokens);
+            tokens.push_back(TOKEN_END);
+            for (IntVector::iterator it = tokens.begin(); it != tokens.end(); it++)
+                if (*it > max_id)
+                    max_id = *it;
+            if (max_id <= MAX_CODE_TAXID) {
+                packTokens(tokens, max_id, code);
+                return;
+            }
+        }
+    }
+    ostringstream ostr;
+    tree->printTree(ostr, WT_TAXON_ID | WT_SORT_TAXA);
+    encodeTree(ostr.str(), code);
+}
+
+string TreeStore::decodeTree(const string &code) {
+    int width = (unsigned char)code[0];
+    if (width == 0)
+        return code.substr(1);
+    string tree;
+    tree.reserve(code.length() * 3);
+    uint64_t mask = ((uint64_t)1 << width) - 1;
+    uint64_t bits = 0;
+    int nbits = 0;
+    size_t pos = 1;
+    bool item = false; // last token is a taxon or ')'
+    int need = max(width + 1, 3); // bits of the longest token
+    char num[16];
+    while (true) {
+        for (; nbits < need && pos < code.length(); nbits += 8, pos++)
+            bits |= (uint64_t)(unsigned char)code[pos] << nbits;
+        assert(nbits > 0);
+        if ((bits & 1) == 0) {
+            // taxon ID
+            int id = (bits >> 1) & mask;
+            bits >>= width + 1;
+            nbits -= width + 1;
+            if (item)
+                tree += ',';
+            int len = 0;
+            do {
+                num[len++] = '0' + id % 10;
+                id /= 10;
+            } while (id > 0);
+            while (len > 0)
+                tree += num[--len];
+            item = true;
+        } else if ((bits & 2) == 0) {
+            bits >>= 2;
+            nbits -= 2;
+            if (item)
+                tree += ',';
+            tree += '(';
+            item = false;
+        } else if ((bits & 4) == 0) {
+            bits >>= 3;
+            nbits -= 3;
+            tree += ')';
+            item = true;
+        } else {
+            tree += ';';
+            break;
+        }
+    }
+    return tree;
+}
+
+TreeStore::TreeStore() {
+}
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t fmix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+TreeStore::TreeHash TreeStore::hashTree(const string &code) {
+    const uint64_t c1 = 0x87c37b91114253d5ULL;
+    const uint64_t c2 = 0x4cf5ad432745937fULL;
+    uint64_t h1 = 0, h2 = 0;
+    size_t len = code.length();
+    const char *data = code.data();
+    for (size_t i = 0; i < len; i += 16) {
+        // the last block is padded with zeros
+        uint64_t k[2] = {0, 0};
+        memcpy(k, data + i, min(len - i, (size_t)16));
+        uint64_t k1 = k[0], k2 = k[1];
+        k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+        k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+    h1 ^= len;
+    h2 ^= len;
+    h1 += h2;
+    h2 += h1;
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+    TreeHash hash;
+    hash.lo = h1;
+    hash.hi = h2;
+    return hash;
+}
+
+int TreeStore::findEntry(const string &code, const TreeHash &hash) const {
+    unordered_map<uint64_t, int>::const_iterator it = hash_entry.find(hash.lo);
+    if (it == hash_entry.end())
+        return -1;
+    for (int entry = it->second; entry >= 0; entry = same_hash[entry])
+        if (hash_hi[entry] == hash.hi && trees[entry] == code)
+            return entry;
+    return -1;
+}
+
+int TreeStore::find(const string &tree) const {
+    string code;
+    encodeTree(tree, code);
+    return findCode(code);
+}
+
+int TreeStore::findCode(const string &code) const {
+    int entry = findEntry(code, hashTree(code));
+    return (entry < 0) ? -1 : ids[entry];
+}
+
+int TreeStore::insert(const string &tree, int id) {
+    string code;
+    encodeTree(tree, code);
+    return insertCode(code, id);
+}
+
+int TreeStore::insertCode(const string &code, int id) {
+    assert(id >= 0);
+    TreeHash hash = hashTree(code);
+    int entry = findEntry(code, hash);
+    if (entry >= 0)
+        return ids[entry];
+    entry = trees.size();
+    unordered_map<uint64_t, int>::iterator it = hash_entry.find(hash.lo);
+    same_hash.push_back((it == hash_entry.end()) ? -1 : it->second);
+    hash_entry[hash.lo] = entry;
+    trees.push_back(code);
+    hash_hi.push_back(hash.hi);
+    ids.push_back(id);
+    if (id >= entry_of.size())
+        entry_of.resize(id + 1, -1);
+    entry_of[id] = entry;
+    return id;
+}
+
+void TreeStore::clear() {
+    trees.clear();
+    hash_hi.clear();
+    ids.clear();
+    same_hash.clear();
+    hash_entry.clear();
+    entry_of.clear();
+}
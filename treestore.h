@@ -0,0 +1,148 @@
+/*
+ * treestore.h
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef TREESTORE_H_
+#define TREESTORE_H_
+
+#include "tools.h"
+
+class MTree;
+
+/**
+ * Set of tree strings (e.g. the UFBoot candidate trees), each one labelled with an index.
+ * Each string is stored once, in the compact form of encodeTree(); the lookup by
+ * string goes through a 128-bit hash of that form, the lookup by index is a plain
+ * array access. The strings are turned back into Newick only when they are read.
+ * Normally the indices are 0, 1, ... in insertion order, but several trees may share
+ * an index (as with the StringIntMap this class replaces).
+ */
+class TreeStore {
+public:
+    TreeStore();
+
+    /**
+     * @param tree a tree string
+     * @return index of tree, -1 if it is not stored
+     */
+    int find(const string &tree) const;
+
+    /**
+     * @param code a tree encoded by encodeTree()
+     * @return index of the tree, -1 if it is not stored
+     */
+    int findCode(const string &code) const;
+
+    /**
+     * store tree with the next free index if it is not stored yet
+     * @param tree a tree string
+     * @return index of tree
+     */
+    int insert(const string &tree) {
+        return insert(tree, trees.size());
+    }
+
+    /**
+     * store tree with a given index if it is not stored yet
+     * @param tree a tree string
+     * @param id index of tree
+     * @return index of tree (the old one if tree was already stored)
+     */
+    int insert(const string &tree, int id);
+
+    /** insert(tree, id) for a tree encoded by encodeTree() */
+    int insertCode(const string &code, int id);
+
+    /**
+     * @param id index of a stored tree
+     * @return the tree string, the last inserted one if several trees share this index
+     */
+    string getTree(int id) const {
+        return decodeTree(trees[entry_of[id]]);
+    }
+
+    /** @return number of stored trees */
+    int size() const {
+        return trees.size();
+    }
+
+    bool empty() const {
+        return trees.empty();
+    }
+
+    /**
+     * @param i entry number, 0 <= i < size(), in insertion order
+     * @return the i-th inserted tree string
+     */
+    string getTreeAt(int i) const {
+        return decodeTree(trees[i]);
+    }
+
+    /**
+     * @param i entry number, 0 <= i < size(), in insertion order
+     * @return index of the i-th inserted tree
+     */
+    int getIdAt(int i) const {
+        return ids[i];
+    }
+
+    void clear();
+
+    /**
+     * encode a Newick string with taxon IDs as leaf names and without branch lengths
+     * (MTree::printTree(out, WT_TAXON_ID | WT_SORT_TAXA)) as a bit sequence of
+     * '(', ')' and fixed-width taxon IDs; the commas are implied.
+     * Any other string is kept as it is behind a one-byte header.
+     * @param tree a tree string
+     * @param code (OUT) the compact form of tree, see decodeTree()
+     */
+    static void encodeTree(const string &tree, string &code);
+
+    /**
+     * encodeTree() of tree->printTree(out, WT_TAXON_ID | WT_SORT_TAXA),
+     * without printing the tree when it is unrooted and its internal nodes are unnamed
+     * @param tree a tree
+     * @param code (OUT) the compact form of the tree
+     */
+    static void encodeTree(MTree *tree, string &code);
+
+    /**
+     * @param code a tree encoded by encodeTree()
+     * @return the tree string
+     */
+    static string decodeTree(const string &code);
+
+private:
+    /** 128-bit hash of an encoded tree, in two halves */
+    struct TreeHash {
+        uint64_t lo, hi;
+    };
+
+    /** 128-bit hash of code, MurmurHash3-style */
+    static TreeHash hashTree(const string &code);
+
+    /** find the entry number of code, -1 if it is not stored */
+    int findEntry(const string &code, const TreeHash &hash) const;
+
+    /** encoded trees in insertion order */
+    StrVector trees;
+
+    /** high half of the hash of each entry */
+    vector<uint64_t> hash_hi;
+
+    /** index of each entry */
+    IntVector ids;
+
+    /** entry number of the previous tree with the same hash, -1 if none */
+    IntVector same_hash;
+
+    /** low half of the hash -> entry number of the last stored tree with this half */
+    unordered_map<uint64_t, int> hash_entry;
+
+    /** index -> entry number of the last tree stored with this index, -1 if none */
+    IntVector entry_of;
+};
+
+#endif /* TREESTORE_H_ */